@@ -0,0 +1,1164 @@
+#include "benchmarks.hpp"
+#include "worldgen.hpp"
+#include "octree.hpp"
+#include "distance_field.hpp"
+#include "chunk_loader.hpp"
+#include "world_archive.hpp"
+#include "packed_world.hpp"
+#include "chunk_codec.hpp"
+#include "parallel.hpp"
+#include "streaming.hpp"
+#include "job_system.hpp"
+#include "dynamic_resolution.hpp"
+#include "reprojection.hpp"
+#include "cone_prepass.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+// Renders `frames` times and keeps the fastest run
+template <typename RenderFn>
+static RenderStats best_of(int frames, RenderFn render) {
+    RenderStats best;
+    for (int f = 0; f < std::max(1, frames); ++f) {
+        RenderStats stats;
+        render(stats);
+        if (f == 0 || stats.seconds < best.seconds) best = stats;
+    }
+    return best;
+}
+
+
+// Best wall clock of `frames` runs, in ms
+template <typename Fn>
+static double best_ms(int frames, Fn fn) {
+    double best = 0.0;
+    for (int f = 0; f < std::max(1, frames); ++f) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (f == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+
+int bench_packet(const VoxelWorld& world, const BenchSettings& settings) {
+    Image reference, image;
+    reference.resize(settings.width, settings.height);
+    image.resize(settings.width, settings.height);
+
+    RenderStats scalar = best_of(settings.frames, [&](RenderStats& stats) {
+        render_cpu(world, settings.cam, reference, 0, &stats, settings.threads);
+    });
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Packet traversal, " << settings.width << "x" << settings.height
+              << ", " << (settings.threads > 0 ? std::to_string(settings.threads) : std::string("all")) << " thread(s)"
+              << ", avg steps " << scalar.avgSteps() << std::endl;
+    std::cout << "  scalar        " << std::setw(8) << scalar.raysPerSecond() / 1e6 << " Mrays/s" << std::endl;
+
+    int failures = 0;
+    for (PacketIsa isa : {PacketIsa::Generic4, PacketIsa::Avx2x8, PacketIsa::Avx512x16}) {
+        if (!packet_isa_supported(isa)) {
+            std::cout << "  " << std::left << std::setw(14) << packet_isa_name(isa) << std::right << "(not supported on this CPU)" << std::endl;
+            continue;
+        }
+
+        RenderStats packet = best_of(settings.frames, [&](RenderStats& stats) {
+            render_cpu_packet(world, settings.cam, image, 0, &stats, settings.threads, isa);
+        });
+
+        size_t mismatched = count_mismatched_pixels(reference, image, 0);
+        if (mismatched != 0 || packet.steps != scalar.steps) failures++;
+
+        std::cout << "  " << std::left << std::setw(14) << packet_isa_name(isa) << std::right
+                  << std::setw(8) << packet.raysPerSecond() / 1e6 << " Mrays/s  x"
+                  << packet.raysPerSecond() / scalar.raysPerSecond()
+                  << (mismatched == 0 && packet.steps == scalar.steps ? "  (matches scalar)" : "  MISMATCH : ")
+                  << (mismatched == 0 && packet.steps == scalar.steps ? std::string() : std::to_string(mismatched) + " pixels")
+                  << std::endl;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
+
+
+int bench_traversal(const VoxelWorld& world, const BenchSettings& settings) {
+    OctreeWorld octree(world.dim);
+    double buildMs = best_ms(settings.frames, [&]() { build_octree(world, octree, settings.threads); });
+
+    size_t used = octree.usedNodes();
+    size_t dense = octree.nodes.size();
+
+    std::vector<uint32_t> occupancy;
+    double occupancyMs = best_ms(settings.frames, [&]() { build_occupancy(world, occupancy, settings.threads); });
+    size_t emptyChunks = std::count(occupancy.begin(), occupancy.end(), 0u);
+
+    DistanceField distance(world.dim);
+    double distanceMs = best_ms(settings.frames, [&]() { build_distance_field(world, distance, settings.threads); });
+
+    Scene scene(world);
+    scene.octree = &octree;
+    scene.occupancy = &occupancy;
+    scene.distance = &distance;
+
+    Image reference, image;
+    reference.resize(settings.width, settings.height);
+    image.resize(settings.width, settings.height);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Traversal, " << settings.width << "x" << settings.height
+              << ", " << (settings.threads > 0 ? std::to_string(settings.threads) : std::string("all")) << " thread(s)" << std::endl;
+    std::cout << "  octree build  " << std::setw(8) << buildMs << " ms, " << used << " nodes used of "
+              << dense << " dense (" << 100.0 * double(used) / double(dense) << "%)" << std::endl;
+    std::cout << "  occupancy     " << std::setw(8) << occupancyMs << " ms, " << emptyChunks << " of "
+              << occupancy.size() << " chunks empty" << std::endl;
+    std::cout << "  distance      " << std::setw(8) << distanceMs << " ms, " << distance.dist.size() / 1024
+              << " KiB" << std::endl;
+
+    RenderStats dda;
+    int failures = 0;
+    for (Traversal traversal : {Traversal::Dda, Traversal::Octree, Traversal::Chunks, Traversal::Distance}) {
+        scene.traversal = traversal;
+        Image& target = traversal == Traversal::Dda ? reference : image;
+        RenderStats stats = best_of(settings.frames, [&](RenderStats& s) {
+            render_cpu(scene, settings.cam, target, 0, &s, settings.threads);
+        });
+        if (traversal == Traversal::Dda) dda = stats;
+
+        std::cout << "  " << std::left << std::setw(10) << traversal_name(traversal) << std::right
+                  << "avg steps " << std::setw(8) << stats.avgSteps()
+                  << "  " << std::setw(8) << stats.raysPerSecond() / 1e6 << " Mrays/s  x"
+                  << stats.raysPerSecond() / dda.raysPerSecond()
+                  << "  " << std::setw(6) << 100.0 * double(stats.exhausted) / double(stats.rays) << "% out of steps";
+
+        if (traversal != Traversal::Dda) {
+            // Leaps land on the same voxels up to float rounding, a handful of
+            // grazing rays can still pick the neighbouring voxel
+            int maxDiff = 0;
+            size_t mismatched = count_mismatched_pixels(reference, image, 0, &maxDiff);
+            double ratio = double(mismatched) / double(reference.width * reference.height);
+            if (ratio > 0.001) failures++;
+            std::cout << "  " << mismatched << " pixels differ (max " << maxDiff << ")";
+        }
+        std::cout << std::endl;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
+
+
+// What build_octree.glsl used to do for each chunk : every node of every level
+// rescans its whole region of raw voxels for the most frequent material
+static void legacy_region_scan_pyramid(const Voxel* chunkVoxels, uint32_t* out) {
+    for (int level = 0; level <= OCTREE_LEVELS; ++level) {
+        int size = CHUNK_SIZE >> level;
+        for (int rz = 0; rz < CHUNK_SIZE; rz += size)
+        for (int ry = 0; ry < CHUNK_SIZE; ry += size)
+        for (int rx = 0; rx < CHUNK_SIZE; rx += size) {
+            int counts[5] = {0, 0, 0, 0, 0};
+            for (int z = rz; z < rz + size; ++z)
+            for (int y = ry; y < ry + size; ++y)
+            for (int x = rx; x < rx + size; ++x) {
+                uint32_t mat = chunkVoxels[(z * CHUNK_SIZE + y) * CHUNK_SIZE + x].material;
+                if (mat <= 4) counts[mat]++;
+            }
+            int maxMat = 0;
+            for (int i = 1; i <= 4; ++i)
+                if (counts[i] > counts[maxMat]) maxMat = i;
+            *out++ = uint32_t(maxMat);
+        }
+    }
+}
+
+
+int bench_octree(const VoxelWorld& world, const BenchSettings& settings) {
+    int chunks = (int)world.chunkCount();
+    OctreeWorld octree(world.dim);
+    std::vector<uint32_t> scratch(OCTREE_NODES_PER_CHUNK);
+
+    double legacyChunk = best_ms(settings.frames, [&]() {
+        for (int c = 0; c < chunks; ++c)
+            legacy_region_scan_pyramid(world.voxels.data() + (size_t)c * CHUNK_VOXELS, scratch.data());
+    }) / chunks;
+    double reduceChunk = best_ms(settings.frames, [&]() {
+        for (int c = 0; c < chunks; ++c)
+            build_chunk_pyramid(world.voxels.data() + (size_t)c * CHUNK_VOXELS, scratch.data());
+    }) / chunks;
+    double single = best_ms(settings.frames, [&]() { build_octree(world, octree, 1); });
+    double multi = best_ms(settings.frames, [&]() { build_octree(world, octree, settings.threads); });
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Octree build, " << world.dim.x << "x" << world.dim.y << "x" << world.dim.z << " chunks" << std::endl;
+    std::cout << "  region scan pyramid, per chunk " << std::setw(10) << legacyChunk << " ms" << std::endl;
+    std::cout << "  bottom-up pyramid, per chunk   " << std::setw(10) << reduceChunk << " ms  x"
+              << legacyChunk / reduceChunk << std::endl;
+    std::cout << "  pyramid + sparse, 1 thread     " << std::setw(10) << single << " ms" << std::endl;
+    std::cout << "  pyramid + sparse, " << std::left << std::setw(3)
+              << (settings.threads > 0 ? std::to_string(settings.threads) : std::string("all")) << std::right << " threads   "
+              << std::setw(10) << multi << " ms" << std::endl;
+    return 0;
+}
+
+
+int bench_edits(const VoxelWorld& source, const BenchSettings& settings) {
+    VoxelWorld world = source;
+    OctreeWorld octree(world.dim);
+    DistanceField distance(world.dim);
+    double full = best_ms(settings.frames, [&]() { build_octree(world, octree, settings.threads); });
+    double fullDistance = best_ms(settings.frames, [&]() { build_distance_field(world, distance, settings.threads); });
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Octree edits, " << world.dim.x << "x" << world.dim.y << "x" << world.dim.z << " chunks" << std::endl;
+    std::cout << "  full rebuild              " << std::setw(10) << full << " ms octree, "
+              << fullDistance << " ms distance field" << std::endl;
+
+    std::mt19937 rng(1234);
+    glm::ivec3 extent = world.voxelDim();
+    for (int batch : {1, 16, 256}) {
+        // Boxes of 1 to 8 voxels around the terrain, half dug out, half filled with stone
+        double total = 0.0, totalDistance = 0.0;
+        size_t touched = 0, changed = 0;
+        int rounds = std::max(1, settings.frames);
+        for (int r = 0; r < rounds; ++r) {
+            for (int e = 0; e < batch; ++e) {
+                glm::ivec3 size(1 + rng() % 8, 1 + rng() % 8, 1 + rng() % 8);
+                glm::ivec3 boxMin(rng() % extent.x, 8 + rng() % 48, rng() % extent.z);
+                changed += world.fillBox(boxMin, boxMin + size - 1, (rng() & 1) ? 0u : 1u);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            touched += update_octree(world, octree, world.dirtyVoxels, settings.threads).size();
+            total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            update_distance_field(world, distance, world.dirtyVoxels, settings.threads);
+            totalDistance += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            world.clearDirty();
+        }
+
+        std::cout << "  " << std::setw(3) << batch << " box(es) per update    " << std::setw(10) << total / rounds << " ms  x"
+                  << full / (total / rounds) << ", " << double(changed) / rounds << " voxels, "
+                  << double(touched) / rounds << " chunks re-emitted, distance field "
+                  << totalDistance / rounds << " ms" << std::endl;
+    }
+
+    OctreeWorld reference(world.dim);
+    build_octree(world, reference, settings.threads);
+    size_t mismatched = 0;
+    for (size_t c = 0; c < reference.nodeCounts.size(); ++c) {
+        size_t slot = c * OCTREE_NODES_PER_CHUNK;
+        if (reference.nodeCounts[c] != octree.nodeCounts[c] ||
+            !std::equal(&reference.nodes[slot], &reference.nodes[slot] + reference.nodeCounts[c], &octree.nodes[slot]))
+            mismatched++;
+    }
+    DistanceField referenceDistance(world.dim);
+    build_distance_field(world, referenceDistance, settings.threads);
+    bool distanceMatches = referenceDistance.dist == distance.dist;
+
+    std::cout << "  incremental vs fresh build : octree "
+              << (mismatched == 0 ? std::string("identical") : std::to_string(mismatched) + " chunks differ")
+              << ", distance field " << (distanceMatches ? "identical" : "DIFFERS") << std::endl;
+    return mismatched == 0 && distanceMatches ? 0 : 1;
+}
+
+
+int bench_worldgen(glm::ivec3 worldDim, int threads, int frames) {
+    VoxelWorld world(worldDim);
+    double voxels = double(world.voxels.size());
+
+    double single = best_ms(frames, [&]() { generate_world(world, 1); });
+    double multi = best_ms(frames, [&]() { generate_world(world, threads); });
+
+    // What voxel.glsl does : one fbm per voxel. Timed on one chunk and scaled up,
+    // running it on the whole world would take a while.
+    volatile float sink = 0.0f;
+    double perVoxelChunk = best_ms(frames, [&]() {
+        for (int z = 0; z < CHUNK_SIZE; ++z)
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+        for (int x = 0; x < CHUNK_SIZE; ++x)
+            sink = sink + terrain_height(x, z);
+    });
+    double perVoxel = perVoxelChunk * double(world.chunkCount());
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "World generation, " << worldDim.x << "x" << worldDim.y << "x" << worldDim.z << " chunks ("
+              << voxels / 1e6 << " M voxels)" << std::endl;
+    std::cout << "  per-voxel fbm, 1 thread (est.) " << std::setw(10) << perVoxel << " ms" << std::endl;
+    std::cout << "  per-column, 1 thread           " << std::setw(10) << single << " ms  "
+              << voxels / single / 1e3 << " Mvoxels/s" << std::endl;
+    std::cout << "  per-column, " << std::left << std::setw(3)
+              << (threads > 0 ? std::to_string(threads) : std::string("all")) << std::right << " threads       "
+              << std::setw(10) << multi << " ms  " << voxels / multi / 1e3 << " Mvoxels/s" << std::endl;
+    return 0;
+}
+
+
+int bench_load(const std::string& chunkDir, glm::ivec3 worldDim, int threads, int frames) {
+    std::string directory = chunkDir;
+    VoxelWorld reference(worldDim);
+    if (directory.empty()) {
+        directory = (std::filesystem::temp_directory_path() / "shaderdemo-chunks").string();
+        generate_world(reference, 0);
+        save_chunk_directory(reference, directory);
+    } else {
+        loadChunkDirectory(reference, directory);
+    }
+
+    VoxelWorld world(worldDim);
+    double mb = double(world.byteSize()) / 1e6;
+    double serial = best_ms(frames, [&]() { loadChunkDirectory(world, directory); });
+    double single = best_ms(frames, [&]() { load_chunk_directory_parallel(world, directory, 1); });
+    double multi = best_ms(frames, [&]() { load_chunk_directory_parallel(world, directory, threads); });
+    bool matches = world.voxels.size() == reference.voxels.size() &&
+                   std::memcmp(world.voxels.data(), reference.voxels.data(), world.byteSize()) == 0;
+
+    auto row = [&](const std::string& label, double ms) {
+        std::cout << "  " << std::left << std::setw(24) << label << std::right << std::setw(10) << ms << " ms  "
+                  << std::setw(8) << mb / ms * 1e3 << " MB/s  " << std::setw(9) << world.chunkCount() / ms * 1e3
+                  << " chunks/s  x" << serial / ms << std::endl;
+    };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Chunk loading, " << worldDim.x << "x" << worldDim.y << "x" << worldDim.z << " chunks ("
+              << mb << " MB) from " << directory << std::endl;
+    row("ifstream, serial", serial);
+    row("mmap, 1 thread", single);
+    row("mmap, " + (threads > 0 ? std::to_string(threads) : std::string("all")) + " threads", multi);
+    std::cout << "  loaded world " << (matches ? "identical" : "DIFFERS") << std::endl;
+    return matches ? 0 : 1;
+}
+
+
+int bench_archive(const std::string& chunkDir, glm::ivec3 worldDim, int threads, int frames) {
+    namespace fs = std::filesystem;
+    fs::path tmp = fs::temp_directory_path();
+    std::string directory = chunkDir;
+    std::string archivePath = (tmp / "shaderdemo-world.vxa").string();
+
+    VoxelWorld reference(worldDim);
+    if (directory.empty()) {
+        directory = (tmp / "shaderdemo-chunks").string();
+        generate_world(reference, 0);
+        save_chunk_directory(reference, directory);
+    } else {
+        load_chunk_directory_parallel(reference, directory, threads);
+    }
+    write_world_archive(reference, archivePath);
+
+    size_t directoryBytes = 0;
+    for (const auto& file : fs::directory_iterator(directory))
+        if (file.path().extension() == ".bin") directoryBytes += file.file_size();
+    size_t archiveBytes = fs::file_size(archivePath);
+
+    VoxelWorld world(worldDim);
+    double mb = double(world.byteSize()) / 1e6;
+    double fromDirectory = best_ms(frames, [&]() { load_chunk_directory_parallel(world, directory, threads); });
+    double fromArchive = best_ms(frames, [&]() { load_world_archive(world, archivePath, threads); });
+    bool matches = std::memcmp(world.voxels.data(), reference.voxels.data(), world.byteSize()) == 0;
+
+    // Random single chunks : one open + map per chunk file against reads from the mapped archive
+    const int picks = 256;
+    std::mt19937 rng(1234);
+    std::vector<int> order(picks);
+    for (int& c : order) c = int(rng() % world.chunkCount());
+    std::vector<Voxel> chunk(CHUNK_VOXELS);
+    double randomDirectory = best_ms(frames, [&]() {
+        for (int c : order) load_chunk_range(directory, worldDim, c, c + 1, chunk.data(), 1);
+    });
+    WorldArchive archive(archivePath);
+    double randomArchive = best_ms(frames, [&]() {
+        for (int c : order) archive.readChunk(c, chunk.data());
+    });
+    for (int c : order) {
+        archive.readChunk(c, chunk.data());
+        if (std::memcmp(chunk.data(), reference.voxels.data() + (size_t)c * CHUNK_VOXELS, CHUNK_VOXELS * sizeof(Voxel)) != 0)
+            matches = false;
+    }
+
+    size_t uniform = 0;
+    for (size_t c = 0; c < archive.chunkCount(); ++c)
+        if (archive.entries[c].flags & ARCHIVE_UNIFORM) uniform++;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "World archive, " << worldDim.x << "x" << worldDim.y << "x" << worldDim.z << " chunks ("
+              << mb << " MB of voxels)" << std::endl;
+    std::cout << "  chunk files      " << world.chunkCount() << " files, " << std::setw(8) << directoryBytes / 1e6 << " MB" << std::endl;
+    std::cout << "  archive          1 file,    " << std::setw(8) << archiveBytes / 1e6 << " MB, "
+              << uniform << " uniform chunks without payload" << std::endl;
+    std::cout << "  whole world      files " << std::setw(8) << fromDirectory << " ms " << std::setw(8) << mb / fromDirectory * 1e3
+              << " MB/s   archive " << std::setw(8) << fromArchive << " ms " << std::setw(8) << mb / fromArchive * 1e3
+              << " MB/s  x" << fromDirectory / fromArchive << std::endl;
+    std::cout << "  " << picks << " random chunks files " << std::setw(8) << randomDirectory * 1e3 / picks << " us/chunk     archive "
+              << std::setw(8) << randomArchive * 1e3 / picks << " us/chunk  x" << randomDirectory / randomArchive << std::endl;
+    std::cout << "  archive contents " << (matches ? "identical" : "DIFFER") << std::endl;
+    return matches ? 0 : 1;
+}
+
+
+int bench_packed(const VoxelWorld& source, const BenchSettings& settings) {
+    VoxelWorld world = source;
+    PackedVoxels packed(world.dim);
+    double packMs = best_ms(settings.frames, [&]() { pack_world(world, packed, settings.threads); });
+
+    VoxelWorld unpacked(world.dim);
+    unpack_world(packed, unpacked, settings.threads);
+    bool roundTrip = unpacked.voxels.size() == world.voxels.size() &&
+                     std::memcmp(unpacked.voxels.data(), world.voxels.data(), world.byteSize()) == 0;
+
+    int widths[17] = {};
+    for (size_t c = 0; c < packed.chunkCount(); ++c) widths[packed.chunkInfo[c * PACKED_INFO_STRIDE + 2]]++;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Packed voxels, " << world.dim.x << "x" << world.dim.y << "x" << world.dim.z << " chunks" << std::endl;
+    std::cout << "  raw       " << std::setw(10) << world.byteSize() / 1024 << " KiB" << std::endl;
+    std::cout << "  packed    " << std::setw(10) << packed.byteSize() / 1024 << " KiB  x"
+              << double(world.byteSize()) / packed.byteSize() << " smaller, "
+              << 8.0 * packed.words.size() * sizeof(uint32_t) / world.voxels.size() << " bits per voxel, packed in "
+              << packMs << " ms, round trip " << (roundTrip ? "identical" : "DIFFERS") << std::endl;
+    std::cout << "  chunks per width :";
+    for (int bits : {0, 1, 2, 4, 8, 16}) std::cout << "  " << bits << " bits " << widths[bits];
+    std::cout << std::endl;
+
+    // The extra decode, on the traversals that read voxels (the octree has the materials in its leaves)
+    std::vector<uint32_t> occupancy;
+    build_occupancy(world, occupancy, settings.threads);
+    DistanceField distance(world.dim);
+    build_distance_field(world, distance, settings.threads);
+    Scene scene(world);
+    scene.occupancy = &occupancy;
+    scene.distance = &distance;
+
+    Image reference, image;
+    reference.resize(settings.width, settings.height);
+    image.resize(settings.width, settings.height);
+    int failures = roundTrip ? 0 : 1;
+    for (Traversal traversal : {Traversal::Dda, Traversal::Chunks, Traversal::Distance}) {
+        scene.traversal = traversal;
+        scene.packed = nullptr;
+        RenderStats raw = best_of(settings.frames, [&](RenderStats& s) {
+            render_cpu(scene, settings.cam, reference, 0, &s, settings.threads);
+        });
+        scene.packed = &packed;
+        RenderStats pal = best_of(settings.frames, [&](RenderStats& s) {
+            render_cpu(scene, settings.cam, image, 0, &s, settings.threads);
+        });
+        size_t mismatched = count_mismatched_pixels(reference, image, 0);
+        if (mismatched) failures++;
+
+        std::cout << "  " << std::left << std::setw(10) << traversal_name(traversal) << std::right
+                  << "raw " << std::setw(8) << raw.raysPerSecond() / 1e6 << " Mrays/s   packed "
+                  << std::setw(8) << pal.raysPerSecond() / 1e6 << " Mrays/s  x"
+                  << pal.raysPerSecond() / raw.raysPerSecond() << "  "
+                  << (mismatched ? std::to_string(mismatched) + " pixels differ" : std::string("identical")) << std::endl;
+    }
+
+    // Edits with materials the chunks may not have yet, so some get promoted
+    std::mt19937 rng(1234);
+    glm::ivec3 extent = world.voxelDim();
+    size_t before = packed.byteSize();
+    int moves = 0;
+    double editMs = 0.0;
+    const int rounds = 64;
+    for (int r = 0; r < rounds; ++r) {
+        glm::ivec3 size(1 + rng() % 8, 1 + rng() % 8, 1 + rng() % 8);
+        glm::ivec3 boxMin(rng() % extent.x, 8 + rng() % 48, rng() % extent.z);
+        world.fillBox(boxMin, boxMin + size - 1, rng() % 8);
+
+        std::vector<int> chunks;
+        for (uint32_t idx : world.dirtyVoxels) chunks.push_back(int(idx / CHUNK_VOXELS));
+        std::sort(chunks.begin(), chunks.end());
+        chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+        world.clearDirty();
+
+        auto start = std::chrono::steady_clock::now();
+        if (repack_chunks(world, packed, chunks)) moves++;
+        editMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    unpack_world(packed, unpacked, settings.threads);
+    bool editsMatch = std::memcmp(unpacked.voxels.data(), world.voxels.data(), world.byteSize()) == 0;
+    if (!editsMatch) failures++;
+
+    std::cout << "  " << rounds << " random edits, materials 0 to 7 : " << editMs / rounds << " ms per repack, "
+              << moves << " moved a chunk, " << before / 1024 << " -> " << packed.byteSize() / 1024 << " KiB, "
+              << (editsMatch ? "identical" : "DIFFERS") << " to the raw world" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+
+int bench_rle(const VoxelWorld& world, int threads, int frames) {
+    // Uniform chunks never get a payload, only the mixed ones are worth timing
+    std::vector<int> mixed;
+    for (int c = 0; c < (int)world.chunkCount(); ++c)
+        if (chunk_occupancy(world.voxels.data() + (size_t)c * CHUNK_VOXELS) == CHUNK_MIXED) mixed.push_back(c);
+    double rawBytes = double(mixed.size() * CHUNK_VOXELS * sizeof(Voxel));
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Chunk codecs, " << mixed.size() << " mixed chunks of " << world.chunkCount() << " ("
+              << rawBytes / 1e6 << " MB raw), " << (threads > 0 ? std::to_string(threads) : std::string("all"))
+              << " thread(s)" << std::endl;
+
+    std::string archivePath = (std::filesystem::temp_directory_path() / "shaderdemo-codec.vxa").string();
+    std::vector<std::vector<uint8_t>> payloads(mixed.size());
+    VoxelWorld decoded(world.dim);
+    int failures = 0;
+
+    for (ChunkCompression compression : {CHUNK_RAW, CHUNK_RLE, CHUNK_RLE_ZSTD}) {
+        if (compression == CHUNK_RLE_ZSTD && !chunk_zstd_available()) {
+            std::cout << "  " << std::left << std::setw(9) << chunk_compression_name(compression) << std::right
+                      << "not in this build (no zstd found)" << std::endl;
+            continue;
+        }
+
+        double encodeMs = best_ms(frames, [&]() {
+            parallel_for((int)mixed.size(), threads, [&](int i) {
+                encode_chunk(world.voxels.data() + (size_t)mixed[i] * CHUNK_VOXELS, compression, payloads[i]);
+            });
+        });
+        double decodeMs = best_ms(frames, [&]() {
+            parallel_for((int)mixed.size(), threads, [&](int i) {
+                decode_chunk(payloads[i].data(), payloads[i].size(), compression, decoded.voxels.data() + (size_t)mixed[i] * CHUNK_VOXELS);
+            });
+        });
+
+        double encodedBytes = 0.0;
+        bool matches = true;
+        for (size_t i = 0; i < mixed.size(); ++i) {
+            encodedBytes += double(payloads[i].size());
+            size_t offset = (size_t)mixed[i] * CHUNK_VOXELS;
+            if (std::memcmp(decoded.voxels.data() + offset, world.voxels.data() + offset, CHUNK_VOXELS * sizeof(Voxel)) != 0)
+                matches = false;
+        }
+        if (!matches) failures++;
+
+        write_world_archive(world, archivePath, compression, threads);
+        double archiveLoadMs = best_ms(frames, [&]() { load_world_archive(decoded, archivePath, threads); });
+
+        std::cout << "  " << std::left << std::setw(9) << chunk_compression_name(compression) << std::right
+                  << std::setw(8) << encodedBytes / 1e6 << " MB  x" << std::setw(6) << rawBytes / encodedBytes
+                  << "  encode " << std::setw(8) << rawBytes / encodeMs / 1e3 << " MB/s  decode "
+                  << std::setw(6) << rawBytes / decodeMs / 1e6 << " GB/s  archive "
+                  << std::setw(8) << std::filesystem::file_size(archivePath) / 1e6 << " MB, loads in "
+                  << archiveLoadMs << " ms  " << (matches ? "identical" : "DIFFERS") << std::endl;
+    }
+    std::filesystem::remove(archivePath);
+    return failures == 0 ? 0 : 1;
+}
+
+
+// ===== Layout benchmark =====
+
+// One hardware counter of this process and the threads it starts while enabled,
+// valid() is false when the kernel doesn't let us read it
+struct PerfCounter {
+    int fd = -1;
+
+    PerfCounter(uint32_t type, uint64_t config) {
+#ifdef __linux__
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+    ~PerfCounter() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    bool valid() const { return fd >= 0; }
+
+    void start() {
+#ifdef __linux__
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    uint64_t stop() {
+        uint64_t value = 0;
+#ifdef __linux__
+        if (fd < 0) return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value)) value = 0;
+#endif
+        return value;
+    }
+};
+
+
+// The world's materials in another layout, same chunk order
+template <VoxelLayout Layout>
+static std::vector<uint32_t> relayout_world(const VoxelWorld& world) {
+    std::vector<uint32_t> out(world.voxels.size());
+    parallel_for((int)world.chunkCount(), 0, [&](int c) {
+        const Voxel* chunkVoxels = world.voxels.data() + (size_t)c * CHUNK_VOXELS;
+        uint32_t* chunkOut = out.data() + (size_t)c * CHUNK_VOXELS;
+        for (int z = 0; z < CHUNK_SIZE; ++z)
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+        for (int x = 0; x < CHUNK_SIZE; ++x)
+            chunkOut[layout_local_index<Layout, CHUNK_SHIFT>(x, y, z)] = chunkVoxels[chunk_local_index(glm::ivec3(x, y, z))].material;
+    });
+    return out;
+}
+
+
+// Plain DDA through air and water up to the first other voxel, like raymarch() without
+// the shading. Returns the steps taken, the voxel it stopped on goes into the checksum.
+template <VoxelLayout Layout>
+static uint32_t walk_ray(const VoxelWorld& world, const uint32_t* voxels, glm::vec3 ro, glm::vec3 rd,
+                         int maxSteps, uint64_t& checksum) {
+    DdaSetup dda;
+    if (!setupDda(world, ro, rd, dda)) return 0;
+
+    glm::ivec3 pos(dda.pos), step(dda.step);
+    glm::vec3 sideDist = dda.sideDist;
+    for (int i = 0; i < maxSteps; ++i) {
+        glm::ivec3 c(pos.x >> CHUNK_SHIFT, pos.y >> CHUNK_SHIFT, pos.z >> CHUNK_SHIFT);
+        if (!world.containsChunk(c)) return i;
+
+        int local = layout_local_index<Layout, CHUNK_SHIFT>(pos.x & (CHUNK_SIZE - 1), pos.y & (CHUNK_SIZE - 1), pos.z & (CHUNK_SIZE - 1));
+        uint32_t material = voxels[((size_t)world.chunkIndex(c) << (3 * CHUNK_SHIFT)) | local];
+        if (material != 0u && material != 4u) {
+            checksum += (uint64_t)world.worldToIndex3D(pos) * 2654435761u + material;
+            return i;
+        }
+
+        if (sideDist.x < sideDist.y && sideDist.x < sideDist.z) {
+            pos.x += step.x;
+            sideDist.x += dda.deltaDist.x;
+        } else if (sideDist.y < sideDist.z) {
+            pos.y += step.y;
+            sideDist.y += dda.deltaDist.y;
+        } else {
+            pos.z += step.z;
+            sideDist.z += dda.deltaDist.z;
+        }
+    }
+    return maxSteps;
+}
+
+
+struct LayoutRun {
+    double ms = 0.0;
+    uint64_t steps = 0, checksum = 0;
+    uint64_t l1Misses = 0, llcMisses = 0;
+};
+
+
+// Every ray of `rays` (ray i = makeRay(i)), over parallel_for blocks of rays
+template <VoxelLayout Layout, typename MakeRay>
+static LayoutRun run_layout(const VoxelWorld& world, const BenchSettings& settings, size_t rays, int maxSteps,
+                            MakeRay makeRay, PerfCounter& l1, PerfCounter& llc) {
+    const std::vector<uint32_t> voxels = relayout_world<Layout>(world);
+    const int blockRays = 4096;
+    const int blocks = int((rays + blockRays - 1) / blockRays);
+    std::vector<uint64_t> steps(blocks), checksums(blocks);
+
+    auto run = [&]() {
+        parallel_for(blocks, settings.threads, [&](int b) {
+            uint64_t blockSteps = 0, checksum = 0;
+            size_t end = std::min(rays, size_t(b + 1) * blockRays);
+            for (size_t i = size_t(b) * blockRays; i < end; ++i) {
+                glm::vec3 ro, rd;
+                makeRay(i, ro, rd);
+                blockSteps += walk_ray<Layout>(world, voxels.data(), ro, rd, maxSteps, checksum);
+            }
+            steps[b] = blockSteps;
+            checksums[b] = checksum;
+        });
+    };
+
+    LayoutRun result;
+    result.ms = best_ms(settings.frames, run);
+
+    // One more run for the counters, outside of the timing
+    l1.start();
+    llc.start();
+    run();
+    result.l1Misses = l1.stop();
+    result.llcMisses = llc.stop();
+
+    for (int b = 0; b < blocks; ++b) {
+        result.steps += steps[b];
+        result.checksum += checksums[b];
+    }
+    return result;
+}
+
+
+int bench_layout(const VoxelWorld& world, const BenchSettings& settings) {
+    PerfCounter l1(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    PerfCounter llc(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Voxel layouts, " << settings.width << "x" << settings.height << ", "
+              << (settings.threads > 0 ? std::to_string(settings.threads) : std::string("all")) << " thread(s), this build uses "
+              << voxel_layout_name(VOXEL_LAYOUT) << std::endl;
+    if (!l1.valid() || !llc.valid())
+        std::cout << "  (no cache miss counters : perf events not readable, see /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+
+    // Camera rays are coherent, neighbouring rays walk neighbouring voxels. The random
+    // ones (from anywhere in the world, any direction, like AO or bounce rays) aren't.
+    glm::vec2 resolution(settings.width, settings.height);
+    auto cameraRay = [&](size_t i, glm::vec3& ro, glm::vec3& rd) {
+        int x = int(i % settings.width), y = int(i / settings.width);
+        primaryRay(settings.cam, glm::vec2(x + 0.5f, y + 0.5f), resolution, ro, rd);
+    };
+    glm::vec3 extent(world.voxelDim());
+    auto randomRay = [&](size_t i, glm::vec3& ro, glm::vec3& rd) {
+        // PCG hash of the ray index, an mt19937 per ray would cost more than the walk
+        uint32_t state = (uint32_t)i;
+        auto unit = [&]() {
+            state = state * 747796405u + 2891336453u;
+            uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+            return float((word >> 22u) ^ word) * (1.0f / 4294967296.0f);
+        };
+        ro = glm::vec3(unit(), unit(), unit()) * extent;
+        float z = unit() * 2.0f - 1.0f, a = unit() * 6.2831853f, r = std::sqrt(1.0f - z * z);
+        rd = glm::vec3(r * std::cos(a), z, r * std::sin(a));
+    };
+    const size_t rays = (size_t)settings.width * settings.height;
+
+    int failures = 0;
+    auto report = [&](const char* workload, VoxelLayout layout, const LayoutRun& run, const LayoutRun& linear) {
+        double mrays = double(rays) / run.ms / 1e3;
+        std::cout << "  " << std::left << std::setw(8) << workload << std::setw(8) << voxel_layout_name(layout) << std::right
+                  << std::setw(8) << mrays << " Mrays/s  x" << linear.ms / run.ms
+                  << "  avg steps " << std::setw(6) << double(run.steps) / double(rays);
+        if (l1.valid() && llc.valid())
+            std::cout << "  L1D misses/ray " << std::setw(7) << double(run.l1Misses) / double(rays)
+                      << "  LLC misses/ray " << std::setw(6) << double(run.llcMisses) / double(rays);
+        bool same = run.checksum == linear.checksum && run.steps == linear.steps;
+        if (!same) failures++;
+        std::cout << (same ? "" : "  MISMATCH") << std::endl;
+    };
+
+    auto workload = [&](const char* name, int maxSteps, auto makeRay) {
+        LayoutRun linear = run_layout<LAYOUT_LINEAR>(world, settings, rays, maxSteps, makeRay, l1, llc);
+        LayoutRun morton = run_layout<LAYOUT_MORTON>(world, settings, rays, maxSteps, makeRay, l1, llc);
+        LayoutRun brick = run_layout<LAYOUT_BRICK>(world, settings, rays, maxSteps, makeRay, l1, llc);
+        report(name, LAYOUT_LINEAR, linear, linear);
+        report(name, LAYOUT_MORTON, morton, linear);
+        report(name, LAYOUT_BRICK, brick, linear);
+    };
+    workload("camera", MAX_STEPS, cameraRay);
+    workload("random", 256, randomRay);
+
+    return failures == 0 ? 0 : 1;
+}
+
+
+// One straight flight out and back with a streaming window, see bench_stream
+struct StreamFlight {
+    StreamStats stream;
+    std::vector<double> frameMs;    // main thread streaming work per frame, sorted
+    double seconds = 0.0;
+    size_t bytesBefore = 0, bytesAfter = 0;
+    int failures = 0;
+};
+
+static StreamFlight fly_streaming(glm::ivec3 worldDim, const BenchSettings& settings, double budgetMs, bool check) {
+    StreamFlight flight;
+    VoxelWorld world(worldDim);
+    OctreeWorld octree(worldDim);
+    DistanceField distance(worldDim);
+    JobSystem jobs(settings.threads);
+    FrameBudgetQueue queue(budgetMs);
+
+    glm::vec3 camPos = settings.cam.pos;
+    world.setOrigin(centred_window_origin(worldDim, camPos));
+    ChunkStreamer streamer(world, octree, jobs, terrain_column_source());
+    streamer.requestAll();
+    update_streamed_distances(world, distance, streamer.finish(), 1);
+    auto memory = [&]() {
+        return world.byteSize() + (octree.pyramid.size() + octree.nodes.size()) * sizeof(uint32_t) + distance.dist.size();
+    };
+    flight.bytesBefore = memory();
+
+    // 32 chunks out along a diagonal and back, 60 frames per second in real time. The way
+    // back is over columns that left, decoded from the streamer's cache.
+    const double frameMs = 1000.0 / 60.0;
+    const float speed = 256.0f;                 // voxels per second, 8 chunks
+    const int frames = 60 * 8;
+    const glm::vec3 direction = glm::normalize(glm::vec3(1.0f, 0.0f, 0.6f));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        auto frameStart = std::chrono::steady_clock::now();
+        camPos += direction * speed * float(frameMs / 1000.0) * (f < frames / 2 ? 1.0f : -1.0f);
+
+        reset_streamed_distances(distance, streamer.recentre(camPos));
+        if (budgetMs > 0.0) {
+            // What the window does : a few columns at a time, one queued task per column
+            if (queue.empty()) {
+                std::vector<int> arrived = streamer.poll(STREAM_CHUNKS_PER_FRAME);
+                for (const std::vector<int>& column : group_columns(world, arrived)) {
+                    queue.push(0, [&, column]() { update_streamed_distances(world, distance, column, 1); });
+                }
+            }
+            queue.run();
+        } else {
+            // Everything that arrived, right away
+            update_streamed_distances(world, distance, streamer.poll(), 1);
+        }
+        flight.frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+
+        std::this_thread::sleep_until(frameStart + std::chrono::duration<double, std::milli>(frameMs));
+    }
+    while (!queue.empty()) queue.run();
+    update_streamed_distances(world, distance, streamer.finish(), 1);
+    flight.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    flight.bytesAfter = memory();
+    flight.stream = streamer.stats();
+    std::sort(flight.frameMs.begin(), flight.frameMs.end());
+
+    if (!check) return flight;
+
+    // The window it ended on, generated from scratch
+    VoxelWorld fresh(worldDim);
+    fresh.setOrigin(world.origin);
+    generate_world(fresh);
+    OctreeWorld freshOctree(worldDim);
+    build_octree(fresh, freshOctree);
+    DistanceField freshDistance(worldDim);
+    build_distance_field(fresh, freshDistance);
+
+    size_t voxelMismatch = 0, octreeMismatch = 0, distanceOver = 0, distanceExact = 0;
+    for (int c = 0; c < (int)world.chunkCount(); ++c) {
+        int s = fresh.chunkIndex(world.slotChunk(c));
+        const Voxel* a = &world.voxels[(size_t)c * CHUNK_VOXELS];
+        const Voxel* b = &fresh.voxels[(size_t)s * CHUNK_VOXELS];
+        if (!std::equal(a, a + CHUNK_VOXELS, b, [](Voxel x, Voxel y) { return x.material == y.material; })) voxelMismatch++;
+
+        const uint32_t* na = &octree.nodes[(size_t)c * OCTREE_NODES_PER_CHUNK];
+        const uint32_t* nb = &freshOctree.nodes[(size_t)s * OCTREE_NODES_PER_CHUNK];
+        if (octree.nodeCounts[c] != freshOctree.nodeCounts[s] || !std::equal(na, na + octree.nodeCounts[c], nb)) octreeMismatch++;
+
+        // Streamed distances may only be smaller (safe) than the exact ones
+        for (size_t i = 0; i < CHUNK_VOXELS; ++i) {
+            uint8_t da = distance.dist[(size_t)c * CHUNK_VOXELS + i], db = freshDistance.dist[(size_t)s * CHUNK_VOXELS + i];
+            distanceOver += da > db;
+            distanceExact += da == db;
+        }
+    }
+    flight.failures = (voxelMismatch != 0) + (octreeMismatch != 0) + (distanceOver != 0) + (flight.bytesBefore != flight.bytesAfter);
+    std::cout << "  vs a fresh build of the window : voxels "
+              << (voxelMismatch == 0 ? std::string("identical") : std::to_string(voxelMismatch) + " chunks differ")
+              << ", octree " << (octreeMismatch == 0 ? std::string("identical") : std::to_string(octreeMismatch) + " chunks differ")
+              << ", distance field " << 100.0 * distanceExact / distance.dist.size() << "% exact, "
+              << (distanceOver == 0 ? std::string("never over") : std::to_string(distanceOver) + " voxels OVER") << std::endl;
+    return flight;
+}
+
+
+int bench_stream(glm::ivec3 worldDim, const BenchSettings& settings, double budgetMs) {
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Streaming, " << worldDim.x << "x" << worldDim.y << "x" << worldDim.z << " chunk window, "
+              << (settings.threads > 0 ? std::to_string(settings.threads) : std::string("all but one")) << " worker(s), "
+              << "8 chunks/s out and back" << std::endl;
+
+    StreamFlight inlined = fly_streaming(worldDim, settings, 0.0, false);
+    StreamFlight budgeted = fly_streaming(worldDim, settings, budgetMs, true);
+
+    auto report = [&](const char* name, const StreamFlight& f) {
+        const std::vector<double>& ms = f.frameMs;
+        double avg = 0.0;
+        for (double v : ms) avg += v / ms.size();
+        size_t over = std::count_if(ms.begin(), ms.end(), [&](double v) { return v > budgetMs; });
+        std::cout << "  " << std::left << std::setw(26) << name << std::right
+                  << " frame work " << std::setw(7) << avg << " ms avg, " << std::setw(7) << ms[std::min(ms.size() - 1, ms.size() * 99 / 100)]
+                  << " p99, " << std::setw(7) << ms.back() << " max, " << over << " frames over " << budgetMs << " ms" << std::endl;
+        std::cout << "  " << std::setw(26) << "" << " per chunk latency " << f.stream.avgLatencyMs << " ms avg, " << f.stream.p99LatencyMs
+                  << " ms p99, worker time " << f.stream.avgGenerateMs << " ms avg, " << f.stream.p99GenerateMs << " ms p99" << std::endl;
+        std::cout << "  " << std::setw(26) << "" << " " << f.stream.chunks << " chunks in " << f.seconds << " s, "
+                  << f.stream.cacheHits << " columns from the cache (" << f.stream.cacheBytes / 1e6 << " MB), "
+                  << f.stream.dropped << " dropped, memory " << f.bytesBefore / 1e6 << " -> " << f.bytesAfter / 1e6 << " MB" << std::endl;
+    };
+    report("everything on arrival", inlined);
+    report("frame budgeted queue", budgeted);
+    return budgeted.failures == 0 ? 0 : 1;
+}
+
+
+PathBenchmark bench_camera_path(const VoxelWorld& world, const CameraPath& path, const BenchSettings& settings,
+                                Traversal traversal, bool packet, bool packed, int renderDebug) {
+    SceneAccel accel;
+    Scene scene = accel.prepare(world, packet ? Traversal::Dda : traversal, settings.threads, packed && !packet);
+
+    PathBenchmark result;
+    result.renderer = packet ? "cpu-packet" : "cpu";
+    result.device = (settings.threads > 0 ? std::to_string(settings.threads) : std::to_string(std::max(1u, std::thread::hardware_concurrency())))
+                    + " CPU thread(s)";
+    result.traversal = packet ? Traversal::Dda : traversal;
+    result.packed = packed && !packet;
+    result.renderDebug = renderDebug;
+    result.width = settings.width;
+    result.height = settings.height;
+    result.scale = settings.scale;
+    result.targetMs = settings.targetMs;
+    result.worldDim = world.dim;
+    result.path = path;
+
+    Image image, output;
+    output.resize(settings.width, settings.height);
+    auto render = [&](const Camera& cam, float scale, RenderStats& stats) {
+        glm::ivec2 size = scaled_resolution(settings.width, settings.height, scale);
+        if (image.width != size.x || image.height != size.y) image.resize(size.x, size.y);
+        if (packet) render_cpu_packet(world, cam, image, renderDebug, &stats, settings.threads);
+        else render_cpu(scene, cam, image, renderDebug, &stats, settings.threads);
+
+        auto start = std::chrono::steady_clock::now();
+        upscale_image(image, output);
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    ResolutionScaler scaler(settings.targetMs, settings.scale);
+    RenderStats warmUp;
+    render(path.at(0.0), scaler.scale, warmUp);
+
+    int frames = std::max(1, settings.frames);
+    for (int f = 0; f < frames; ++f) {
+        double t = frames > 1 ? path.duration() * f / (frames - 1) : 0.0;
+        PathFrame frame{t, 0.0, 0.0, RenderStats{}, scaler.scale};
+        render(path.at(t), frame.scale, frame.stats);
+        frame.ms = frame.stats.seconds * 1000.0;
+        scaler.update(frame.ms, frame.scale);
+        result.frames.push_back(frame);
+    }
+    return result;
+}
+
+
+int bench_reprojection(const VoxelWorld& world, const CameraPath& path, double dt, const BenchSettings& settings,
+                       Traversal traversal) {
+    SceneAccel accel;
+    Scene scene = accel.prepare(world, traversal, settings.threads);
+
+    Image full, reprojected;
+    full.resize(settings.width, settings.height);
+    reprojected.resize(settings.width, settings.height);
+    HitBuffer hits;
+    std::vector<float> tStart;
+    RenderStats fullStats, reprojectedStats;
+    double reprojectMs = 0.0;
+    size_t seeded = 0, mismatched = 0, badFrames = 0;
+    int maxDiff = 0;
+
+    int frames = std::max(2, settings.frames);
+    for (int f = 0; f < frames; ++f) {
+        Camera cam = path.at(std::min(f * dt, path.duration()));
+        // The first frame has nothing to reproject, it only fills the hits
+        if (f == 0) {
+            render_cpu(scene, cam, reprojected, 0, nullptr, settings.threads, nullptr, &hits);
+            continue;
+        }
+        render_cpu(scene, cam, full, 0, &fullStats, settings.threads);
+
+        auto start = std::chrono::steady_clock::now();
+        reproject_hits(hits, cam, settings.width, settings.height, tStart);
+        reprojectMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        for (float t : tStart) seeded += t > 0.0f;
+        render_cpu(scene, cam, reprojected, 0, &reprojectedStats, settings.threads, &tStart, &hits);
+
+        int frameMaxDiff = 0;
+        size_t bad = count_mismatched_pixels(full, reprojected, 12, &frameMaxDiff);
+        mismatched += bad;
+        badFrames += bad > 0;
+        maxDiff = std::max(maxDiff, frameMaxDiff);
+    }
+
+    int compared = frames - 1;
+    double pixels = double(compared) * settings.width * settings.height;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Temporal reprojection, " << traversal_name(traversal) << ", " << settings.width << "x" << settings.height
+              << ", " << compared << " frames " << dt * 1000.0 << " ms apart on a " << path.duration() << " s path" << std::endl;
+    std::cout << "  from the world box   avg steps " << std::setw(8) << fullStats.avgSteps() << ", "
+              << std::setw(8) << fullStats.seconds * 1000.0 / compared << " ms/frame" << std::endl;
+    std::cout << "  reprojected          avg steps " << std::setw(8) << reprojectedStats.avgSteps() << ", "
+              << std::setw(8) << (reprojectedStats.seconds * 1000.0 + reprojectMs) / compared << " ms/frame ("
+              << reprojectMs / compared << " ms splat)" << std::endl;
+    std::cout << "  " << 100.0 * (1.0 - reprojectedStats.avgSteps() / std::max(fullStats.avgSteps(), 1e-9))
+              << "% fewer steps, " << 100.0 * seeded / pixels << "% of rays started from a reprojected hit" << std::endl;
+    std::cout << "  " << mismatched << " pixels off by more than 12/255 (" << 100.0 * mismatched / pixels << "%) in "
+              << badFrames << " frames, max diff " << maxDiff << std::endl;
+    return 0;
+}
+
+
+int bench_cone(const VoxelWorld& world, const CameraPath& path, const BenchSettings& settings) {
+    int frames = std::max(1, settings.frames);
+    double pixels = double(frames) * settings.width * settings.height;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Cone pre-pass, " << CONE_TILE << "x" << CONE_TILE << " tiles, " << settings.width << "x" << settings.height
+              << ", " << frames << " frames on a " << path.duration() << " s path" << std::endl;
+
+    // The cones always go through the distance field, see cone_prepass.hpp
+    SceneAccel coneAccel;
+    Scene coneScene = coneAccel.prepare(world, Traversal::Distance, settings.threads);
+
+    for (int t = 0; t < TRAVERSAL_COUNT; ++t) {
+        Traversal traversal = Traversal(t);
+        SceneAccel accel;
+        Scene scene = accel.prepare(world, traversal, settings.threads);
+
+        Image full, coned;
+        full.resize(settings.width, settings.height);
+        coned.resize(settings.width, settings.height);
+        ConeDepth depth;
+        std::vector<float> tStart;
+        RenderStats fullStats, conedStats;
+        double coneMs = 0.0, coneT = 0.0;
+        uint64_t coneSteps = 0, tiles = 0, skyTiles = 0;
+        size_t mismatched = 0;
+        int maxDiff = 0;
+
+        for (int f = 0; f < frames; ++f) {
+            Camera cam = path.at(frames > 1 ? path.duration() * f / (frames - 1) : 0.0);
+            render_cpu(scene, cam, full, 0, &fullStats, settings.threads);
+
+            auto start = std::chrono::steady_clock::now();
+            cone_prepass(coneScene, cam, settings.width, settings.height, depth, settings.threads);
+            apply_cone_depth(depth, settings.width, settings.height, tStart);
+            coneMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            coneSteps += depth.steps;
+            for (float d : depth.t) {
+                if (d >= CONE_MAX_DIST) skyTiles++;
+                else coneT += d;
+            }
+            tiles += depth.t.size();
+            render_cpu(scene, cam, coned, 0, &conedStats, settings.threads, &tStart);
+            // tStart is per pixel, start from zero again next frame
+            tStart.clear();
+
+            int frameMaxDiff = 0;
+            mismatched += count_mismatched_pixels(full, coned, 12, &frameMaxDiff);
+            maxDiff = std::max(maxDiff, frameMaxDiff);
+        }
+
+        std::cout << "  " << std::setw(8) << traversal_name(traversal)
+                  << "  avg steps " << std::setw(7) << fullStats.avgSteps() << " -> " << std::setw(7) << conedStats.avgSteps()
+                  << " (+" << coneSteps / pixels << " cone)"
+                  << ", " << std::setw(8) << fullStats.seconds * 1000.0 / frames << " -> "
+                  << std::setw(8) << (conedStats.seconds * 1000.0 + coneMs) / frames << " ms/frame ("
+                  << coneMs / frames << " ms pre-pass), cones start at " << coneT / std::max<uint64_t>(tiles - skyTiles, 1)
+                  << " (" << 100.0 * skyTiles / tiles << "% only see sky), " << mismatched << " pixels off (max diff " << maxDiff << ")" << std::endl;
+    }
+    return 0;
+}
+
+
+int report_path_benchmark(const PathBenchmark& result, const std::string& jsonPath) {
+    if (result.frames.empty()) throw std::invalid_argument("No frames to report");
+
+    std::vector<double> ms;
+    uint64_t rays = 0, steps = 0, exhausted = 0;
+    double seconds = 0.0, scales = 0.0;
+    for (const PathFrame& f : result.frames) {
+        scales += f.scale;
+        ms.push_back(f.ms);
+        rays += f.stats.rays;
+        steps += f.stats.steps;
+        exhausted += f.stats.exhausted;
+        seconds += f.ms / 1000.0;
+    }
+    std::sort(ms.begin(), ms.end());
+    auto percentile = [&](double p) { return ms[std::min(ms.size() - 1, size_t(ms.size() * p))]; };
+    double avgMs = seconds * 1000.0 / ms.size();
+    double raysPerSecond = seconds > 0.0 ? rays / seconds : 0.0;
+    double avgSteps = rays ? double(steps) / rays : 0.0;
+    double exhaustedRatio = rays ? double(exhausted) / rays : 0.0;
+    double avgScale = scales / result.frames.size();
+
+    auto escaped = [](const std::string& s) {
+        std::string r;
+        for (char c : s) {
+            if (c == '"' || c == '\\') r += '\\';
+            if ((unsigned char)c >= 0x20) r += c;
+        }
+        return r;
+    };
+
+    std::ostringstream json;
+    json << std::setprecision(6);
+    json << "{\n"
+         << "  \"schema\": 1,\n"
+         << "  \"renderer\": \"" << result.renderer << "\",\n"
+         << "  \"device\": \"" << escaped(result.device) << "\",\n"
+         << "  \"traversal\": \"" << traversal_name(result.traversal) << "\",\n"
+         << "  \"packed\": " << (result.packed ? "true" : "false") << ",\n"
+         << "  \"voxel_layout\": " << (int)VOXEL_LAYOUT << ",\n"
+         << "  \"render_debug\": " << result.renderDebug << ",\n"
+         << "  \"width\": " << result.width << ",\n"
+         << "  \"height\": " << result.height << ",\n"
+         << "  \"scale\": " << result.scale << ",\n"
+         << "  \"target_ms\": " << result.targetMs << ",\n"
+         << "  \"avg_scale\": " << avgScale << ",\n"
+         << "  \"world\": [" << result.worldDim.x << ", " << result.worldDim.y << ", " << result.worldDim.z << "],\n"
+         << "  \"path\": {\"keys\": " << result.path.keys.size() << ", \"seconds\": " << result.path.duration() << "},\n"
+         << "  \"frames\": " << result.frames.size() << ",\n"
+         << "  \"frame_ms\": {\"min\": " << ms.front() << ", \"avg\": " << avgMs << ", \"p50\": " << percentile(0.5)
+         << ", \"p95\": " << percentile(0.95) << ", \"p99\": " << percentile(0.99) << ", \"max\": " << ms.back() << "},\n"
+         << "  \"rays_per_second\": " << raysPerSecond << ",\n"
+         << "  \"avg_steps\": " << avgSteps << ",\n"
+         << "  \"exhausted_rays\": " << exhaustedRatio << ",\n"
+         << "  \"per_frame\": [";
+    for (size_t i = 0; i < result.frames.size(); ++i) {
+        const PathFrame& f = result.frames[i];
+        json << (i ? ",\n" : "\n") << "    {\"t\": " << f.time << ", \"ms\": " << f.ms;
+        if (result.renderer == "gpu") json << ", \"wall_ms\": " << f.wallMs;
+        json << ", \"scale\": " << f.scale;
+        json << ", \"avg_steps\": " << f.stats.avgSteps() << ", \"exhausted\": " << f.stats.exhausted << "}";
+    }
+    json << "\n  ]\n}\n";
+
+    if (jsonPath == "-") {
+        std::cout << json.str();
+        return 0;
+    }
+    std::ofstream out(jsonPath);
+    out << json.str();
+    if (!out) throw std::runtime_error("Can't write " + jsonPath);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Benchmark, " << result.renderer << " (" << result.device << "), " << traversal_name(result.traversal)
+              << (result.packed ? " packed" : "") << ", " << result.width << "x" << result.height << ", "
+              << result.frames.size() << " frames over a " << result.path.duration() << " s path" << std::endl;
+    std::cout << "  frame " << avgMs << " ms avg, " << percentile(0.5) << " p50, " << percentile(0.95) << " p95, "
+              << percentile(0.99) << " p99, " << ms.front() << " min, " << ms.back() << " max" << std::endl;
+    if (result.targetMs > 0.0 || result.scale != 1.0f) {
+        std::cout << "  render scale " << avgScale << " avg";
+        if (result.targetMs > 0.0) std::cout << " for a " << result.targetMs << " ms budget";
+        std::cout << std::endl;
+    }
+    std::cout << "  " << raysPerSecond / 1e6 << " Mrays/s, avg steps " << avgSteps << ", "
+              << 100.0 * exhaustedRatio << "% of rays out of steps => " << jsonPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "world.hpp"
+#include "cpu_raymarch.hpp"
+#include "camera_path.hpp"
+
+#include <string>
+#include <vector>
+
+// Headless benchmarks, run with ShaderDemo --bench <name>. They print their results
+// and return the process exit code (non zero when a correctness check fails).
+
+struct BenchSettings {
+    Camera cam;
+    int width, height;
+    int threads;    // 0 = all cores
+    int frames;     // timed repetitions, the best one is reported
+    float scale = 1.0f;     // --benchmark : render scale (dynamic_resolution.hpp), the starting one with targetMs
+    double targetMs = 0.0;  // --benchmark : frame budget the scale follows, 0 = fixed scale
+};
+
+// Scalar DDA vs the SIMD packet kernels, per core by default (--threads 1)
+int bench_packet(const VoxelWorld& world, const BenchSettings& settings);
+
+// Plain DDA vs the octree, chunk skipping and distance field traversals : build time and
+// size, avg steps, Mrays/s, rays out of MAX_STEPS, and how many pixels differ
+int bench_traversal(const VoxelWorld& world, const BenchSettings& settings);
+
+// Octree build : the old per-node region scan of build_octree.glsl against the
+// bottom-up reduction of octree.cpp, one chunk and the whole world
+int bench_octree(const VoxelWorld& world, const BenchSettings& settings);
+
+// Random dig / place boxes : incremental octree and distance field updates vs full
+// rebuilds, and a check that both end up identical to a fresh build
+int bench_edits(const VoxelWorld& world, const BenchSettings& settings);
+
+// CPU terrain generation (worldgen.cpp) : wall clock for the column/row generator,
+// single threaded and on all cores, next to the per-voxel fbm voxel.glsl does
+int bench_worldgen(glm::ivec3 worldDim, int threads, int frames);
+
+// Chunk file loading : the old serial ifstream per chunk against the mmap + parallel_for
+// loader, MB/s and chunks/s. Without --chunks, the generated world is written to a
+// temporary directory first. Warm page cache numbers, files just written or read.
+int bench_load(const std::string& chunkDir, glm::ivec3 worldDim, int threads, int frames);
+
+// World archive against the chunk-x-y-z.bin directory : size on disk, whole world
+// reads (MB/s of voxel data), and random single chunk reads from the mapped archive
+int bench_archive(const std::string& chunkDir, glm::ivec3 worldDim, int threads, int frames);
+
+// Palette packed voxels : memory against 4 bytes per voxel, chunks per width, Mrays/s
+// of the raw vs packed voxel reads for the traversals that read voxels, and random
+// edits that promote chunks, checked against the raw world
+int bench_packed(const VoxelWorld& world, const BenchSettings& settings);
+
+// Chunk codecs on the world's mixed chunks : compression ratio, encode MB/s and decode
+// GB/s per codec (per core by default), and the size of the archive each one gives
+int bench_rle(const VoxelWorld& world, int threads, int frames);
+
+// Voxel layouts (voxel_layout.hpp) side by side, whatever VOXEL_LAYOUT this build uses :
+// the world is copied into each order and walked by the same DDA, camera rays and
+// random incoherent rays. Mrays/s, and L1D / LLC misses per ray when perf events are
+// readable (perf_event_paranoid), and a check that every layout hits the same voxels.
+int bench_layout(const VoxelWorld& world, const BenchSettings& settings);
+
+// Streaming stress test : a window (streaming.hpp) following a camera flying out and
+// back in a straight line, once bringing in chunks as soon as they arrive and once
+// through the frame budgeted queue. Main thread time per frame (avg / p99 / max, frames
+// over budgetMs), per chunk latency and worker time, cache hits on the way back, memory
+// before / after, and the final window checked against a fresh build of it.
+// --threads sets the job system workers here (default all cores but one).
+int bench_stream(glm::ivec3 worldDim, const BenchSettings& settings, double budgetMs);
+
+
+// --benchmark : frames rendered at even times along a camera path, on the CPU here or on
+// the GPU by main.cpp, and the JSON both write for regression tracking
+struct PathFrame {
+    double time;            // on the path, seconds
+    double ms;              // render time (GPU : GL_TIME_ELAPSED of the draw)
+    double wallMs;          // GPU only : draw to glFinish() returning, as seen by the CPU
+    RenderStats stats;      // rays, steps and rays out of MAX_STEPS of the frame
+    float scale;            // render scale the frame was drawn at
+};
+
+struct PathBenchmark {
+    std::string renderer;   // cpu, cpu-packet or gpu
+    std::string device;     // GL_RENDERER, or the CPU thread count
+    Traversal traversal;
+    bool packed;
+    int renderDebug;
+    int width, height;      // output size, frames are raymarched at scale x that
+    float scale;            // fixed scale, or the starting one with targetMs
+    double targetMs;        // dynamic resolution budget, 0 = off
+    glm::ivec3 worldDim;
+    CameraPath path;
+    std::vector<PathFrame> frames;
+};
+
+// CPU raymarcher (packet kernels with `packet`), settings.frames frames along the path,
+// after one untimed warm-up frame. Below scale 1 (or with a targetMs) the frame time
+// includes upscale_image().
+PathBenchmark bench_camera_path(const VoxelWorld& world, const CameraPath& path, const BenchSettings& settings,
+                                Traversal traversal, bool packet, bool packed, int renderDebug);
+
+// Temporal reprojection (reprojection.hpp) along a camera path, settings.frames frames
+// dt apart : every frame rendered with all rays from the world box, and with rays
+// starting at the previous frame's reprojected hits. Avg steps and time of both, how many
+// rays got a start, and the pixels that came out different.
+int bench_reprojection(const VoxelWorld& world, const CameraPath& path, double dt, const BenchSettings& settings,
+                       Traversal traversal);
+
+// Cone pre-pass (cone_prepass.hpp, through the distance field) for every traversal over
+// settings.frames cameras spread along a path : avg steps and time from the world box and from the tile's cone,
+// the cone steps per pixel on top, and the pixels that came out different.
+int bench_cone(const VoxelWorld& world, const CameraPath& path, const BenchSettings& settings);
+
+// Prints a summary and writes the JSON to jsonPath ("-" : stdout instead of the summary).
+// Returns the exit code.
+int report_path_benchmark(const PathBenchmark& result, const std::string& jsonPath);
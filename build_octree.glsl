@@ -1,9 +1,17 @@
 #version 430 core
 
-layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+// Bottom-up build, dispatched once per pass (see build_octree_gpu() in main.cpp) :
+//   pass 0 : pyramid leaves, one invocation per voxel
+//   pass 1 : pyramid level buildLevel from level buildLevel + 1, one invocation per node
+//            (run for levels 4..0, level 0 also writes the chunk occupancy)
+//   pass 2 : sparse nodes from the pyramid, one invocation per chunk
+// Same results as octree.cpp.
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
 
 uniform ivec3 worldDim;
 uniform int chunkSize;
+uniform int buildPass;
+uniform int buildLevel;
 
 struct Voxel {
     uint material;
@@ -13,89 +21,142 @@ layout(std430, binding = 0) buffer RawVoxelData {
     Voxel voxels[];
 };
 
+// Sparse nodes, same encoding as octree.hpp, chunk c's from octreeOffsets[c]. main.cpp
+// lays the slots out from the host build of the same voxels, so the nodes fit.
 layout(std430, binding = 1) buffer OctreeData {
     uint octreeNodes[];
 };
+layout(std430, binding = 11) buffer OctreeOffsets {
+    uint octreeOffsets[];
+};
 
-// Derived constants
-const int MAX_MATERIAL = 4;
+// Dense pyramid scratch, every level of the chunk in Morton order, only there during the build
+layout(std430, binding = 3) buffer PyramidData {
+    uint pyramid[];
+};
 
-int floor_div(int a, int b) {
-    return (a >= 0 ? a / b : ((a - b + 1) / b));
-}
+// Per chunk occupancy (0 = empty, material = uniform, OCTREE_MIXED), the pyramid roots
+layout(std430, binding = 4) buffer ChunkOccupancy {
+    uint chunkOccupancy[];
+};
 
-int worldToChunkIndex(ivec3 chunkCoord) {
-    return chunkCoord.z * worldDim.y * worldDim.x + chunkCoord.y * worldDim.x + chunkCoord.x;
-}
+// Precompute octree parameters for CHUNK_SIZE=32
+const int levels = 5;
+const int octreeNodesPerChunk = 37449;     // (8^(levels+1) - 1) / 7
 
-// Compute local voxel index inside chunk
-int localVoxelIndex(ivec3 localPos) {
-    return localPos.z * chunkSize * chunkSize + localPos.y * chunkSize + localPos.x;
-}
+const uint OCTREE_MIXED = 0xFFFFFFFFu;
+const uint OCTREE_LEAF = 0x80000000u;
+
+#include "voxel_layout.glsl"
 
 // Compute per-chunk offset
 int voxelChunkOffset(int chunkIndex) {
     return chunkIndex * (chunkSize * chunkSize * chunkSize);
 }
 
-int octreeChunkOffset(int chunkIndex, int octreeNodesPerChunk) {
+int pyramidChunkOffset(int chunkIndex) {
     return chunkIndex * octreeNodesPerChunk;
 }
 
-// Find most frequent material in a block
-uint getMostFrequentMaterial(int chunkIndex, ivec3 regionMin, int regionSize) {
-    int counts[5] = int[5](0,0,0,0,0);
-    int chunkOffset = voxelChunkOffset(chunkIndex);
+uint levelOffset(int level) {
+    return ((1u << uint(3 * level)) - 1u) / 7u;
+}
 
-    for (int z = 0; z < regionSize; ++z)
-    for (int y = 0; y < regionSize; ++y)
-    for (int x = 0; x < regionSize; ++x) {
-        ivec3 localPos = regionMin + ivec3(x,y,z);
-        if (any(greaterThanEqual(localPos, ivec3(chunkSize))))
-            continue;
+uint spreadBits(uint v) {
+    v &= 0x3FFu;
+    v = (v | (v << 16)) & 0x030000FFu;
+    v = (v | (v << 8)) & 0x0300F00Fu;
+    v = (v | (v << 4)) & 0x030C30C3u;
+    v = (v | (v << 2)) & 0x09249249u;
+    return v;
+}
 
-        int localIdx = localVoxelIndex(localPos);
-        uint mat = voxels[chunkOffset + localIdx].material;
-        if (mat <= MAX_MATERIAL)
-            counts[mat]++;
-    }
+uint morton(ivec3 p) {
+    return spreadBits(uint(p.x)) | (spreadBits(uint(p.y)) << 1) | (spreadBits(uint(p.z)) << 2);
+}
+
+int pyramidLevel(uint index) {
+    int level = 0;
+    while (level < levels && index >= levelOffset(level + 1)) level++;
+    return level;
+}
 
-    int maxMat = 0;
-    for (int i = 1; i <= MAX_MATERIAL; ++i)
-        if (counts[i] > counts[maxMat])
-            maxMat = i;
 
-    return uint(maxMat);
+// ===== pass 0 : leaves, one invocation per voxel (in buffer order) =====
+void buildLeaves(int chunkIndex, uint base, uint local) {
+    ivec3 localPos = chunkLocalCoord(int(local));
+    pyramid[base + levelOffset(levels) + morton(localPos)] = voxels[voxelChunkOffset(chunkIndex) + int(local)].material;
 }
 
-// Precompute octree parameters for CHUNK_SIZE=32
-const int levels = int(log2(32));
-const int octreeNodesPerChunk = int( (pow(8, levels+1) - 1) / 7 );
 
-void buildOctreeForChunk(ivec3 chunkCoord) {
-    int chunkIndex = worldToChunkIndex(chunkCoord);
-    int writeBase = octreeChunkOffset(chunkIndex, octreeNodesPerChunk);
+// ===== pass 1 : one level from its 8 children, one invocation per node =====
+void reduceNode(uint base, int level, uint n) {
+    uint c = base + levelOffset(level + 1) + n * 8u;
+    uint value = pyramid[c];
+    for (uint i = 1u; i < 8u; ++i)
+        if (pyramid[c + i] != value) value = OCTREE_MIXED;
+    pyramid[base + levelOffset(level) + n] = value;
+}
+
 
-    int writeIndex = writeBase;
+// ===== pass 2 : sparse nodes, one invocation per chunk =====
+// Breadth first, straight in the output : a slot first holds the pyramid index
+// of its node, and gets overwritten by the encoded node once its children are queued
+void emitSparse(uint pyramidBase, uint base) {
+    octreeNodes[base] = 0u;
+    uint write = 1u;
 
-    // Build pyramid from coarse to fine
-    for (int level = 0; level <= levels; ++level) {
-        int size = chunkSize >> level;
-        int step = size;
+    for (uint read = 0u; read < write; ++read) {
+        uint p = octreeNodes[base + read];
+        uint value = pyramid[pyramidBase + p];
+        if (value != OCTREE_MIXED) {
+            octreeNodes[base + read] = OCTREE_LEAF | value;
+            continue;
+        }
 
-        for (int z = 0; z < chunkSize; z += step)
-        for (int y = 0; y < chunkSize; y += step)
-        for (int x = 0; x < chunkSize; x += step) {
-            octreeNodes[writeIndex++] = getMostFrequentMaterial(chunkIndex, ivec3(x,y,z), step);
+        int level = pyramidLevel(p);
+        uint childBase = levelOffset(level + 1) + (p - levelOffset(level)) * 8u;
+        uint childMask = 0u;
+        uint first = write;
+        for (uint c = 0u; c < 8u; ++c) {
+            if (pyramid[pyramidBase + childBase + c] != 0u) {
+                childMask |= 1u << c;
+                octreeNodes[base + write] = childBase + c;
+                write++;
+            }
         }
+        octreeNodes[base + read] = childMask | (first << 8);
     }
 }
 
+
 void main() {
-    ivec3 chunkCoord = ivec3(gl_GlobalInvocationID);
+    int chunkCount = worldDim.x * worldDim.y * worldDim.z;
 
-    if (any(greaterThanEqual(chunkCoord, worldDim)))
+    if (buildPass == 2) {
+        int chunkIndex = int(gl_GlobalInvocationID.x);
+        if (chunkIndex >= chunkCount)
+            return;
+        emitSparse(uint(pyramidChunkOffset(chunkIndex)), octreeOffsets[chunkIndex]);
         return;
+    }
 
-    buildOctreeForChunk(chunkCoord);
+    // x = voxel / node inside the chunk, y = chunk
+    int chunkIndex = int(gl_GlobalInvocationID.y);
+    uint n = gl_GlobalInvocationID.x;
+    if (chunkIndex >= chunkCount)
+        return;
+    uint base = uint(pyramidChunkOffset(chunkIndex));
+
+    if (buildPass == 0) {
+        if (n >= uint(chunkSize * chunkSize * chunkSize))
+            return;
+        buildLeaves(chunkIndex, base, n);
+    } else {
+        if (n >= (1u << uint(3 * buildLevel)))
+            return;
+        reduceNode(base, buildLevel, n);
+        if (buildLevel == 0)
+            chunkOccupancy[chunkIndex] = pyramid[base];
+    }
 }
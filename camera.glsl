@@ -0,0 +1,42 @@
+// Camera rotation and primary rays, shared by shader.glsl and upscale.glsl. Same math
+// as getRotationMatrix() / primaryRay() in cpu_raymarch.cpp.
+
+mat3 getRotationMatrix(vec3 angles) {
+    float cx = cos(angles.x), sx = sin(angles.x);
+    float cy = cos(angles.y), sy = sin(angles.y);
+    float cz = cos(angles.z), sz = sin(angles.z);
+
+    mat3 rx = mat3(1, 0, 0,
+                   0, cx, -sx,
+                   0, sx, cx);
+    mat3 ry = mat3(cy, 0, sy,
+                   0, 1, 0,
+                  -sy, 0, cy);
+    mat3 rz = mat3(cz, -sz, 0,
+                   sz,  cz, 0,
+                   0,   0, 1);
+
+    return rz * ry * rx;
+}
+
+// Direction of the ray through fragCoord (gl_FragCoord convention) for a camera rotated by rot
+vec3 cameraRayDir(vec2 fragCoord, vec2 resolution, vec3 rot, float fov) {
+    vec2 uv = (fragCoord / resolution) * 2.0 - 1.0;
+    uv.x *= resolution.x / resolution.y;
+
+    float fovScale = tan(radians(fov) * 0.5);
+    vec3 rd = normalize(vec3(uv.x * fovScale, uv.y * fovScale, -1.0));
+    return getRotationMatrix(rot) * rd;
+}
+
+// Inverse of cameraRayDir() : where a world position lands on screen, false behind the camera
+bool cameraProject(vec3 worldPos, vec3 camPos, vec3 rot, float fov, vec2 resolution, out vec2 fragCoord) {
+    vec3 local = transpose(getRotationMatrix(rot)) * (worldPos - camPos);
+    if (local.z > -1e-4) return false;
+
+    float fovScale = tan(radians(fov) * 0.5);
+    vec2 uv = local.xy / (-local.z * fovScale);
+    uv.x /= resolution.x / resolution.y;
+    fragCoord = (uv * 0.5 + 0.5) * resolution;
+    return true;
+}
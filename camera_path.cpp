@@ -0,0 +1,75 @@
+#include "camera_path.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/gtc/constants.hpp>
+
+
+Camera CameraPath::at(double time, float fov) const {
+    if (keys.empty()) throw std::runtime_error("Empty camera path");
+    time += keys.front().time;
+    if (time <= keys.front().time) return Camera{keys.front().pos, keys.front().rot, fov};
+    if (time >= keys.back().time) return Camera{keys.back().pos, keys.back().rot, fov};
+
+    size_t i = std::upper_bound(keys.begin(), keys.end(), time, [](double t, const CameraKey& k) { return t < k.time; }) - keys.begin();
+    const CameraKey& a = keys[i - 1];
+    const CameraKey& b = keys[i];
+    float f = float((time - a.time) / std::max(b.time - a.time, 1e-9));
+
+    // Yaw wraps at 2 pi (main.cpp keeps it in [0, 2 pi)), go the short way
+    float yaw = b.rot.y - a.rot.y;
+    yaw -= glm::two_pi<float>() * std::floor((yaw + glm::pi<float>()) / glm::two_pi<float>());
+
+    return Camera{glm::mix(a.pos, b.pos, f), glm::vec2(glm::mix(a.rot.x, b.rot.x, f), a.rot.y + yaw * f), fov};
+}
+
+
+CameraPath load_camera_path(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Can't open camera path " + path);
+
+    CameraPath result;
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::istringstream fields(line);
+        CameraKey key;
+        if (!(fields >> key.time >> key.pos.x >> key.pos.y >> key.pos.z >> key.rot.x >> key.rot.y))
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + " : expected time x y z pitch yaw");
+        result.keys.push_back(key);
+    }
+    if (result.keys.empty()) throw std::runtime_error("No keys in camera path " + path);
+
+    std::stable_sort(result.keys.begin(), result.keys.end(), [](const CameraKey& a, const CameraKey& b) { return a.time < b.time; });
+    return result;
+}
+
+
+void save_camera_path(const CameraPath& cameraPath, const std::string& path) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Can't write camera path " + path);
+
+    out << "# time x y z pitch yaw\n" << std::fixed << std::setprecision(4);
+    for (const CameraKey& k : cameraPath.keys)
+        out << k.time << " " << k.pos.x << " " << k.pos.y << " " << k.pos.z << " " << k.rot.x << " " << k.rot.y << "\n";
+    if (!out) throw std::runtime_error("Can't write camera path " + path);
+}
+
+
+CameraPath default_camera_path() {
+    CameraPath path;
+    path.keys = {
+        {0.0, glm::vec3(-58.6984f, 123.135f, -19.7525f), glm::vec2(0.561f, 2.151f)},
+        {2.0, glm::vec3(128.0f, 96.0f, 128.0f), glm::vec2(0.35f, 2.4f)},
+        {4.0, glm::vec3(256.0f, 44.0f, 256.0f), glm::vec2(0.02f, 2.9f)},
+        {6.0, glm::vec3(384.0f, 72.0f, 160.0f), glm::vec2(0.3f, 4.4f)},
+        {8.0, glm::vec3(420.0f, 140.0f, 400.0f), glm::vec2(1.2f, 5.6f)},
+    };
+    return path;
+}
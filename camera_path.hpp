@@ -0,0 +1,36 @@
+#pragma once
+
+#include "cpu_raymarch.hpp"
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Camera keyframes for --benchmark, interpolated linearly (yaw the short way round).
+// Text file, one key per line, '#' starts a comment :
+//   time_seconds  x y z  pitch yaw
+// --record-path writes one from the windowed mode, a key every CAMERA_PATH_RECORD_SECONDS.
+
+struct CameraKey {
+    double time;
+    glm::vec3 pos;
+    glm::vec2 rot;      // pitch, yaw like Camera::rot
+};
+
+struct CameraPath {
+    std::vector<CameraKey> keys;    // sorted by time
+
+    double duration() const { return keys.empty() ? 0.0 : keys.back().time - keys.front().time; }
+    // Camera at `time` seconds from the first key, clamped to the path
+    Camera at(double time, float fov = 60.0f) const;
+};
+
+const double CAMERA_PATH_RECORD_SECONDS = 0.25;
+
+// Throws std::runtime_error on a file that can't be read or a malformed line
+CameraPath load_camera_path(const std::string& path);
+void save_camera_path(const CameraPath& cameraPath, const std::string& path);
+
+// 8 s over the default world : the default start view, into the world, grazing along
+// the terrain (the worst case for every traversal), then looking down from above
+CameraPath default_camera_path();
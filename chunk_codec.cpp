@@ -0,0 +1,182 @@
+#include "chunk_codec.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__)
+#define CODEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef SHADERDEMO_ZSTD
+#include <zstd.h>
+#endif
+
+const int ZSTD_LEVEL = 3;
+
+static_assert(CHUNK_VOXELS <= 65536, "RLE run lengths are stored on 16 bits");
+
+
+const char* chunk_compression_name(ChunkCompression compression) {
+    switch (compression) {
+    case CHUNK_RAW: return "raw";
+    case CHUNK_RLE: return "rle";
+    case CHUNK_RLE_ZSTD: return "rle+zstd";
+    }
+    return "?";
+}
+
+
+bool parse_chunk_compression(const std::string& name, ChunkCompression& compression) {
+    for (ChunkCompression c : {CHUNK_RAW, CHUNK_RLE, CHUNK_RLE_ZSTD}) {
+        if (name == chunk_compression_name(c)) {
+            compression = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool chunk_zstd_available() {
+#ifdef SHADERDEMO_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+static size_t rle_materials_offset(uint32_t runCount) {
+    return (sizeof(uint32_t) + runCount * sizeof(uint16_t) + 3) & ~size_t(3);
+}
+
+
+static void rle_encode(const Voxel* chunkVoxels, std::vector<uint8_t>& out) {
+    std::vector<uint16_t> lengths;
+    std::vector<uint32_t> materials;
+
+    uint32_t start = 0;
+    for (uint32_t i = 1; i <= CHUNK_VOXELS; ++i) {
+        if (i == CHUNK_VOXELS || chunkVoxels[i].material != chunkVoxels[start].material) {
+            lengths.push_back(uint16_t(i - start - 1));
+            materials.push_back(chunkVoxels[start].material);
+            start = i;
+        }
+    }
+
+    uint32_t runCount = (uint32_t)lengths.size();
+    size_t materialsOffset = rle_materials_offset(runCount);
+    out.assign(materialsOffset + runCount * sizeof(uint32_t), 0);
+    std::memcpy(out.data(), &runCount, sizeof(runCount));
+    std::memcpy(out.data() + sizeof(uint32_t), lengths.data(), runCount * sizeof(uint16_t));
+    std::memcpy(out.data() + materialsOffset, materials.data(), runCount * sizeof(uint32_t));
+}
+
+
+// n copies of v, 8 per iteration with SSE2
+static inline void fill_run(uint32_t* out, uint32_t n, uint32_t v) {
+    uint32_t i = 0;
+#ifdef CODEC_SSE2
+    __m128i m = _mm_set1_epi32((int)v);
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), m);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), m);
+    }
+#endif
+    for (; i < n; ++i) out[i] = v;
+}
+
+
+static void rle_decode(const uint8_t* data, size_t size, Voxel* out) {
+    uint32_t runCount;
+    if (size < sizeof(runCount)) throw std::runtime_error("RLE chunk payload is truncated");
+    std::memcpy(&runCount, data, sizeof(runCount));
+    size_t materialsOffset = rle_materials_offset(runCount);
+    if (runCount == 0 || runCount > CHUNK_VOXELS || size != materialsOffset + runCount * sizeof(uint32_t))
+        throw std::runtime_error("RLE chunk payload has the wrong size");
+
+    // Read through memcpy : the payload is 4 byte aligned in the archive, not necessarily anywhere else
+    const uint8_t* lengths = data + sizeof(uint32_t);
+    const uint8_t* materials = data + materialsOffset;
+    auto length = [&](uint32_t r) { uint16_t v; std::memcpy(&v, lengths + r * sizeof(v), sizeof(v)); return uint32_t(v) + 1; };
+    auto material = [&](uint32_t r) { uint32_t v; std::memcpy(&v, materials + r * sizeof(v), sizeof(v)); return v; };
+
+    // Checked up front, so the fill loop can't run past the chunk
+    size_t total = 0;
+    for (uint32_t r = 0; r < runCount; ++r) total += length(r);
+    if (total != CHUNK_VOXELS) throw std::runtime_error("RLE chunk runs don't add up to a chunk");
+
+    uint32_t* dst = &out->material;
+    for (uint32_t r = 0; r < runCount; ++r) {
+        uint32_t n = length(r);
+        fill_run(dst, n, material(r));
+        dst += n;
+    }
+}
+
+static_assert(sizeof(Voxel) == sizeof(uint32_t), "voxels are decoded as plain uint32");
+
+
+void encode_chunk(const Voxel* chunkVoxels, ChunkCompression compression, std::vector<uint8_t>& out) {
+    switch (compression) {
+    case CHUNK_RAW:
+        out.resize(CHUNK_VOXELS * sizeof(Voxel));
+        std::memcpy(out.data(), chunkVoxels, out.size());
+        return;
+    case CHUNK_RLE:
+        rle_encode(chunkVoxels, out);
+        return;
+    case CHUNK_RLE_ZSTD: {
+#ifdef SHADERDEMO_ZSTD
+        std::vector<uint8_t> rle;
+        rle_encode(chunkVoxels, rle);
+        uint32_t rleSize = (uint32_t)rle.size();
+        out.resize(sizeof(rleSize) + ZSTD_compressBound(rle.size()));
+        std::memcpy(out.data(), &rleSize, sizeof(rleSize));
+        size_t written = ZSTD_compress(out.data() + sizeof(rleSize), out.size() - sizeof(rleSize), rle.data(), rle.size(), ZSTD_LEVEL);
+        if (ZSTD_isError(written)) throw std::runtime_error(std::string("zstd compression failed : ") + ZSTD_getErrorName(written));
+        out.resize(sizeof(rleSize) + written);
+        return;
+#else
+        throw std::runtime_error("This build has no zstd support");
+#endif
+    }
+    }
+    throw std::invalid_argument("Unknown chunk compression " + std::to_string(compression));
+}
+
+
+void decode_chunk(const uint8_t* data, size_t size, ChunkCompression compression, Voxel* out) {
+    switch (compression) {
+    case CHUNK_RAW:
+        if (size != CHUNK_VOXELS * sizeof(Voxel)) throw std::runtime_error("Raw chunk payload has the wrong size");
+        std::memcpy(out, data, size);
+        return;
+    case CHUNK_RLE:
+        rle_decode(data, size, out);
+        return;
+    case CHUNK_RLE_ZSTD: {
+#ifdef SHADERDEMO_ZSTD
+        uint32_t rleSize;
+        if (size < sizeof(rleSize)) throw std::runtime_error("zstd chunk payload is truncated");
+        std::memcpy(&rleSize, data, sizeof(rleSize));
+        // Worst case RLE is one run per voxel
+        if (rleSize > rle_materials_offset(CHUNK_VOXELS) + CHUNK_VOXELS * sizeof(uint32_t))
+            throw std::runtime_error("zstd chunk payload has the wrong size");
+
+        thread_local std::vector<uint8_t> rle;
+        rle.resize(rleSize);
+        size_t read = ZSTD_decompress(rle.data(), rle.size(), data + sizeof(rleSize), size - sizeof(rleSize));
+        if (ZSTD_isError(read) || read != rleSize) throw std::runtime_error("zstd chunk payload is corrupted");
+        rle_decode(rle.data(), rle.size(), out);
+        return;
+#else
+        throw std::runtime_error("Chunk is zstd compressed, but this build has no zstd support");
+#endif
+    }
+    }
+    throw std::runtime_error("Unknown chunk compression " + std::to_string(compression));
+}
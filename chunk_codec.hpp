@@ -0,0 +1,44 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Chunk payload codecs, for the world archive (and anything else that ships chunks
+// around as bytes). Terrain chunks are long runs of air, stone, water..., so a plain
+// run-length code already takes them down a lot. zstd is layered on top when the
+// build found it (SHADERDEMO_ZSTD).
+//
+// The codecs keep the voxels in the order they're given. Archives hand them x fastest
+// chunks (chunk_to_linear()), the streaming column cache its chunks as they are in the
+// world, in VOXEL_LAYOUT order : those payloads never leave the process.
+//
+// RLE payload, little endian, runs in that order :
+//     uint32 runCount
+//     uint16 lengths[runCount]     run length - 1 (a run is at most CHUNK_VOXELS)
+//     padding to 4 bytes
+//     uint32 materials[runCount]
+// Lengths and materials are split so both decode loops stay simple and the zstd
+// layer sees two homogeneous streams.
+//
+// RLE + zstd payload : uint32 RLE payload size, then a zstd frame of that payload.
+
+enum ChunkCompression : uint16_t {
+    CHUNK_RAW = 0,          // CHUNK_VOXELS uint32 materials
+    CHUNK_RLE = 1,
+    CHUNK_RLE_ZSTD = 2,
+};
+
+const char* chunk_compression_name(ChunkCompression compression);
+bool parse_chunk_compression(const std::string& name, ChunkCompression& compression);
+
+// false when the build has no zstd, CHUNK_RLE_ZSTD then throws on encode and decode
+bool chunk_zstd_available();
+
+// One chunk (CHUNK_VOXELS voxels) into out, replacing its contents
+void encode_chunk(const Voxel* chunkVoxels, ChunkCompression compression, std::vector<uint8_t>& out);
+
+// Back into CHUNK_VOXELS voxels, throws on a malformed payload
+void decode_chunk(const uint8_t* data, size_t size, ChunkCompression compression, Voxel* out);
@@ -0,0 +1,108 @@
+#include "chunk_loader.hpp"
+#include "parallel.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+MappedFile::MappedFile(const std::string& path, bool populate) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open chunk file : " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to stat chunk file : " + path);
+    }
+    size = (size_t)st.st_size;
+
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Failed to map chunk file : " + path);
+        }
+        data = static_cast<const uint8_t*>(mapped);
+    }
+    // The mapping keeps the file alive
+    close(fd);
+}
+
+
+MappedFile::~MappedFile() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+}
+
+
+std::string chunk_file_path(const std::string& directory, glm::ivec3 chunkCoord) {
+    return directory + "/chunk-" + std::to_string(chunkCoord.x) + "-" + std::to_string(chunkCoord.y) + "-" +
+           std::to_string(chunkCoord.z) + ".bin";
+}
+
+
+size_t load_chunk_range(const std::string& directory, glm::ivec3 worldDim, int begin, int end,
+                        Voxel* out, int threads) {
+    const size_t chunkBytes = CHUNK_VOXELS * sizeof(Voxel);
+
+    // parallel_for workers can't throw, the first error is rethrown once they're done
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    parallel_for(end - begin, threads, [&](int i) {
+        int chunk = begin + i;
+        glm::ivec3 chunkCoord(chunk % worldDim.x, (chunk / worldDim.x) % worldDim.y, chunk / (worldDim.x * worldDim.y));
+        try {
+            std::string path = chunk_file_path(directory, chunkCoord);
+            MappedFile file(path);
+            if (file.size != chunkBytes)
+                throw std::runtime_error("Chunk file has the wrong size (" + std::to_string(file.size) + " bytes) : " + path);
+            chunk_from_linear(reinterpret_cast<const Voxel*>(file.data), out + (size_t)i * CHUNK_VOXELS);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+    });
+
+    if (error) std::rethrow_exception(error);
+    return (size_t)(end - begin) * chunkBytes;
+}
+
+
+LoadStats load_chunk_directory_parallel(VoxelWorld& world, const std::string& directory, int threads) {
+    auto start = std::chrono::steady_clock::now();
+
+    LoadStats stats;
+    stats.chunks = world.chunkCount();
+    stats.bytes = load_chunk_range(directory, world.dim, 0, (int)world.chunkCount(), world.voxels.data(), threads);
+    stats.fileBytes = stats.bytes;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+
+void save_chunk_directory(const VoxelWorld& world, const std::string& directory) {
+    std::filesystem::create_directories(directory);
+    std::vector<Voxel> linear(CHUNK_VOXELS);
+
+    for (int z = 0; z < world.dim.z; ++z)
+    for (int y = 0; y < world.dim.y; ++y)
+    for (int x = 0; x < world.dim.x; ++x) {
+        glm::ivec3 chunkCoord(x, y, z);
+        std::string path = chunk_file_path(directory, chunkCoord);
+        std::ofstream out(path, std::ios::binary);
+        if (!out) throw std::runtime_error("Failed to create chunk file : " + path);
+
+        chunk_to_linear(world.voxels.data() + (size_t)world.chunkIndex(chunkCoord) * CHUNK_VOXELS, linear.data());
+        out.write(reinterpret_cast<const char*>(linear.data()), CHUNK_VOXELS * sizeof(Voxel));
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <string>
+
+// Loader for the raw chunk-x-y-z.bin files data/utils.py writes : CHUNK_VOXELS uint32
+// materials each, x fastest, so a file is exactly one chunk of voxelSSBO (reordered
+// by chunk_from_linear() when VOXEL_LAYOUT isn't linear).
+//
+// Files are mmapped and copied out by parallel_for workers, chunks [begin, end) land
+// one after the other in the output, same as in the world buffer. The GPU side of it
+// (decoding straight into a persistently mapped staging buffer) is in main.cpp.
+
+struct LoadStats {
+    size_t chunks = 0;
+    size_t bytes = 0;           // voxel data produced, what MB/s is measured on
+    size_t fileBytes = 0;       // read from the file(s)
+    double seconds = 0.0;
+
+    double mbPerSec() const { return seconds > 0.0 ? bytes / seconds / 1e6 : 0.0; }
+    double chunksPerSec() const { return seconds > 0.0 ? chunks / seconds : 0.0; }
+};
+
+// Read-only mapping of a whole file, throws when it can't be opened. `populate`
+// faults every page in up front, for files that are read whole right away.
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    explicit MappedFile(const std::string& path, bool populate = true);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+std::string chunk_file_path(const std::string& directory, glm::ivec3 chunkCoord);
+
+// Chunks [begin, end) of a worldDim world (chunk indices, z, y, x order) into out,
+// spread over `threads` workers (0 = all cores). Returns the bytes read, throws on a
+// missing or wrongly sized file.
+size_t load_chunk_range(const std::string& directory, glm::ivec3 worldDim, int begin, int end,
+                        Voxel* out, int threads = 0);
+
+// Every chunk of the world
+LoadStats load_chunk_directory_parallel(VoxelWorld& world, const std::string& directory, int threads = 0);
+
+// Writes the world as chunk-x-y-z.bin files, creating the directory if needed
+void save_chunk_directory(const VoxelWorld& world, const std::string& directory);
@@ -10,7 +10,18 @@ mkdir build/shaders
 cp ./shader.glsl ./build/shaders/shader.glsl
 cp ./vertex.glsl ./build/shaders/vertex.glsl
 cp ./voxel.glsl ./build/shaders/voxel.glsl
+cp ./heightmap.glsl ./build/shaders/heightmap.glsl
 cp ./build_octree.glsl ./build/shaders/build_octree.glsl
+cp ./distance_field.glsl ./build/shaders/distance_field.glsl
+cp ./voxel_layout.glsl ./build/shaders/voxel_layout.glsl
+cp ./camera.glsl ./build/shaders/camera.glsl
+cp ./upscale.glsl ./build/shaders/upscale.glsl
+cp ./reproject.glsl ./build/shaders/reproject.glsl
+cp ./cone.glsl ./build/shaders/cone.glsl
+cp ./voxel_world.glsl ./build/shaders/voxel_world.glsl
+cp ./raymarch.glsl ./build/shaders/raymarch.glsl
+cp ./raymarch_compute.glsl ./build/shaders/raymarch_compute.glsl
+cp ./noise.glsl ./build/shaders/noise.glsl
 
 # copy test voxel data
 # python test_data.py
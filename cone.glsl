@@ -0,0 +1,85 @@
+#version 430 core
+
+// Cone pre-pass (main.cpp, --cone) : one invocation per 8x8 tile of pixels, same as
+// cone_prepass.cpp. Marches a cone holding every ray of the tile through the distance
+// field cubes (main.cpp sets traversalMode = 3 here, whatever the rays use) and stores
+// how far it got in coneImage, that shader.glsl reads as its tMin.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r32f, binding = 1) uniform writeonly image2D coneImage;
+
+uniform vec2 resolution;
+uniform vec3 camPos;
+uniform vec3 camRot;
+uniform float FOV;
+
+#include "voxel_world.glsl"
+#include "camera.glsl"
+
+const int CONE_TILE = 8;
+const int CONE_MAX_STEPS = 64;
+const float CONE_MIN_STEP = 0.25;
+const float CONE_MAX_DIST = 10000.0;
+
+float coneMarch(vec3 ro, vec3 axis, float slope) {
+    const float FAR = 1e30;
+    vec3 worldMin = vec3(worldOrigin * chunkSize);
+    vec3 worldMax = vec3((worldOrigin + worldDim) * chunkSize);
+
+    float t = 0.0;
+    for (int i = 0; i < CONE_MAX_STEPS; ++i) {
+        vec3 p = ro + axis * t;
+        // Chebyshev distance out of the window, <= 0 inside
+        vec3 gap = max(worldMin - p, p - worldMax);
+        float outside = max(max(gap.x, gap.y), gap.z);
+
+        // Empty box around the window voxel closest to p (p's own when it's inside)
+        ivec3 emptyMin;
+        int emptySize;
+        ivec3 ipos = ivec3(clamp(floor(p), worldMin, worldMax - 1.0));
+        float margin;
+        if (voxelLookup(ipos, emptyMin, emptySize) == 0u) {
+            vec3 boxMin = vec3(emptyMin), boxMax = vec3(emptyMin + emptySize);
+            // Past a side of the window it's all air
+            boxMin = mix(boxMin, vec3(-FAR), lessThanEqual(boxMin, worldMin));
+            boxMax = mix(boxMax, vec3(FAR), greaterThanEqual(boxMax, worldMax));
+            vec3 m = min(p - boxMin, boxMax - p);
+            margin = min(min(m.x, m.y), m.z);
+        } else if (outside > 0.0) {
+            // Solid right behind the window side : only what's outside of it
+            margin = outside;
+        } else {
+            break;
+        }
+
+        // The cube of half size margin around p is air. Moving p by s along the axis
+        // moves that cube by at most s and widens the cone by s x slope.
+        float s = (margin - t * slope) / (1.0 + slope);
+        if (s < CONE_MIN_STEP) break;
+        t += s;
+        if (t >= CONE_MAX_DIST) return CONE_MAX_DIST;
+    }
+    return t;
+}
+
+void main() {
+    ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 tiles = (ivec2(resolution) + CONE_TILE - 1) / CONE_TILE;
+    if (any(greaterThanEqual(tile, tiles))) return;
+
+    vec2 lo = vec2(tile * CONE_TILE);
+    vec2 hi = min(lo + float(CONE_TILE), resolution);
+    vec3 axis = cameraRayDir((lo + hi) * 0.5, resolution, camRot, FOV);
+
+    // The cone holds the rays through the tile when it holds its corners, a pixel out
+    // each way for the --temporal jitter
+    float slope = 0.0;
+    for (int c = 0; c < 4; ++c) {
+        vec2 frag = vec2((c & 1) != 0 ? hi.x + 1.0 : lo.x - 1.0, (c & 2) != 0 ? hi.y + 1.0 : lo.y - 1.0);
+        vec3 corner = cameraRayDir(frag, resolution, camRot, FOV);
+        slope = max(slope, length(cross(axis, corner)) / dot(axis, corner));
+    }
+
+    imageStore(coneImage, tile, vec4(coneMarch(camPos, axis, slope)));
+}
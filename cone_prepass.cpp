@@ -0,0 +1,99 @@
+#include "cone_prepass.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+float cone_march(const Scene& scene, glm::vec3 ro, glm::vec3 axis, float slope, uint32_t* steps) {
+    const VoxelWorld& world = *scene.world;
+    const float FAR = 1e30f;
+    glm::vec3 worldMin(world.voxelOrigin());
+    glm::vec3 worldMax(world.voxelOrigin() + world.voxelDim());
+
+    float t = 0.0f;
+    uint32_t i = 0;
+    for (; i < (uint32_t)CONE_MAX_STEPS; ++i) {
+        glm::vec3 p = ro + axis * t;
+        // Chebyshev distance out of the window, <= 0 inside
+        glm::vec3 gap = glm::max(worldMin - p, p - worldMax);
+        float outside = std::max(std::max(gap.x, gap.y), gap.z);
+
+        // Empty box around the window voxel closest to p (p's own when it's inside)
+        glm::ivec3 emptyMin;
+        int emptySize;
+        glm::ivec3 ipos(glm::clamp(glm::floor(p), worldMin, worldMax - 1.0f));
+        float margin;
+        if (voxelLookup(scene, ipos, emptyMin, emptySize) == 0u) {
+            glm::vec3 boxMin(emptyMin), boxMax(emptyMin + emptySize);
+            // Past a side of the window it's all air
+            for (int a = 0; a < 3; ++a) {
+                if (boxMin[a] <= worldMin[a]) boxMin[a] = -FAR;
+                if (boxMax[a] >= worldMax[a]) boxMax[a] = FAR;
+            }
+            glm::vec3 m = glm::min(p - boxMin, boxMax - p);
+            margin = std::min(std::min(m.x, m.y), m.z);
+        } else if (outside > 0.0f) {
+            // Solid right behind the window side : only what's outside of it
+            margin = outside;
+        } else {
+            break;
+        }
+
+        // The cube of half size margin around p is air. Moving p by s along the axis
+        // moves that cube by at most s and widens the cone by s x slope.
+        float s = (margin - t * slope) / (1.0f + slope);
+        if (s < CONE_MIN_STEP) break;
+        t += s;
+        if (t >= CONE_MAX_DIST) {
+            t = CONE_MAX_DIST;
+            break;
+        }
+    }
+
+    if (steps) *steps = i;
+    return t;
+}
+
+
+void cone_prepass(const Scene& scene, const Camera& cam, int width, int height, ConeDepth& depth, int threads) {
+    depth.tilesX = (width + CONE_TILE - 1) / CONE_TILE;
+    depth.tilesY = (height + CONE_TILE - 1) / CONE_TILE;
+    depth.t.assign((size_t)depth.tilesX * depth.tilesY, 0.0f);
+    glm::vec2 resolution((float)width, (float)height);
+
+    std::vector<uint32_t> tileSteps(depth.t.size(), 0u);
+    parallel_for(depth.tilesY, threads, [&](int ty) {
+        for (int tx = 0; tx < depth.tilesX; ++tx) {
+            float x0 = float(tx * CONE_TILE), x1 = float(std::min((tx + 1) * CONE_TILE, width));
+            float y0 = float(ty * CONE_TILE), y1 = float(std::min((ty + 1) * CONE_TILE, height));
+
+            glm::vec3 ro, axis, corner;
+            primaryRay(cam, glm::vec2(x0 + x1, y0 + y1) * 0.5f, resolution, ro, axis);
+            // The rays through the tile fill a convex patch of the image plane : the cone
+            // holds them all when it holds its corners
+            float slope = 0.0f;
+            for (int c = 0; c < 4; ++c) {
+                glm::vec2 frag((c & 1) ? x1 + 1.0f : x0 - 1.0f, (c & 2) ? y1 + 1.0f : y0 - 1.0f);
+                primaryRay(cam, frag, resolution, ro, corner);
+                slope = std::max(slope, glm::length(glm::cross(axis, corner)) / glm::dot(axis, corner));
+            }
+
+            size_t tile = (size_t)ty * depth.tilesX + tx;
+            depth.t[tile] = cone_march(scene, ro, axis, slope, &tileSteps[tile]);
+        }
+    });
+
+    depth.steps = 0;
+    for (uint32_t s : tileSteps) depth.steps += s;
+}
+
+
+void apply_cone_depth(const ConeDepth& depth, int width, int height, std::vector<float>& tStart) {
+    if (tStart.size() != (size_t)width * height) tStart.assign((size_t)width * height, 0.0f);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            float& t = tStart[(size_t)y * width + x];
+            t = std::max(t, depth.at(x, y));
+        }
+}
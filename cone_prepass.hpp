@@ -0,0 +1,48 @@
+#pragma once
+
+#include "cpu_raymarch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Cone pre-pass : one cone per CONE_TILE x CONE_TILE tile of pixels, just wide enough to
+// hold every ray of the tile, marched along its axis through the empty boxes the scene's
+// traversal structure gives (voxelLookup(), so octree nodes, chunks or distance field
+// cubes) for as long as its cross-section fits in them. The whole cone up to there is
+// air, so every ray of the tile can start there instead of at the world box.
+// cone.glsl is the same on the GPU, shader.glsl reads it as its tMin.
+//
+// Outside of the world window counts as air : a box that reaches a side of the window
+// is stretched out through it, which lets a camera above the terrain get in.
+//
+// Give it the distance field (a Traversal::Distance scene) whatever the rays use : its
+// cubes are centered on the voxel, so the margin around the axis is about the distance
+// to the nearest solid voxel. Octree nodes and chunks are aligned, the axis always ends
+// up near one of their faces and the cone stops there even when the next one is empty
+// (on the flyover it skipped ~30 voxels against them, ~400 through the field).
+
+const int CONE_TILE = 8;            // pixels
+const int CONE_MAX_STEPS = 64;
+const float CONE_MIN_STEP = 0.25f;  // voxels, a cone that can't move further than that stops
+const float CONE_MAX_DIST = 10000.0f;
+
+// How far along `axis` (normalized) from `ro` everything within slope x the distance
+// of the axis is air. slope is the tangent of the cone's half angle. steps : loop count.
+float cone_march(const Scene& scene, glm::vec3 ro, glm::vec3 axis, float slope, uint32_t* steps = nullptr);
+
+// Cone start of every tile, gl_FragCoord rows like the pixels
+struct ConeDepth {
+    int tilesX = 0, tilesY = 0;
+    std::vector<float> t;
+    uint64_t steps = 0;     // cone_march() steps of the whole pass
+
+    float at(int x, int y) const { return t[(size_t)(y / CONE_TILE) * tilesX + x / CONE_TILE]; }
+};
+
+// Tiles of cam at width x height, spread over `threads` workers (0 = all cores). The
+// cones are a pixel wider each way, for the --temporal jitter.
+void cone_prepass(const Scene& scene, const Camera& cam, int width, int height, ConeDepth& depth, int threads = 0);
+
+// Raises every pixel of tStart (render_cpu() tMin, zeroed first when it isn't
+// width x height) to the start of its tile
+void apply_cone_depth(const ConeDepth& depth, int width, int height, std::vector<float>& tStart);
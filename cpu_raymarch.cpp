@@ -0,0 +1,522 @@
+#include "cpu_raymarch.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+
+// ================== Materials, mirrors shader.glsl ============
+struct Material {
+    glm::vec3 color;
+    float opacity;
+};
+
+const int NUM_MATERIALS = 4;
+
+const Material voxelMaterials[NUM_MATERIALS] = {
+    {glm::vec3(0.5f, 0.5f, 0.5f), 1.0f},        // stone
+    {glm::vec3(0.4f, 0.25f, 0.1f), 1.0f},       // dirt
+    {glm::vec3(0.055f, 0.639f, 0.231f), 1.0f},  // grass
+    {glm::vec3(0.2f, 0.4f, 1.0f), 0.15f}        // water
+};
+
+const Material AIR = {glm::vec3(1.0f, 1.0f, 1.0f), 0.0f};
+
+static Material getVoxelMaterial(uint32_t materialId) {
+    if (materialId == 0u) {
+        return AIR;
+    }
+    if (materialId > uint32_t(NUM_MATERIALS)) {
+        return {glm::vec3(0.2f, 0.2f, 0.2f), 1.0f}; // default gray
+    }
+    return voxelMaterials[materialId - 1];
+}
+
+// ================== ! Materials ============
+
+
+const char* traversal_name(Traversal traversal) {
+    switch (traversal) {
+    case Traversal::Dda: return "dda";
+    case Traversal::Octree: return "octree";
+    case Traversal::Chunks: return "chunks";
+    case Traversal::Distance: return "distance";
+    }
+    return "?";
+}
+
+
+bool parse_traversal(const std::string& name, Traversal& traversal) {
+    for (int i = 0; i < TRAVERSAL_COUNT; ++i) {
+        if (name == traversal_name(Traversal(i))) {
+            traversal = Traversal(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+Scene SceneAccel::prepare(const VoxelWorld& world, Traversal traversal, int threads, bool packVoxels) {
+    Scene scene(world);
+    scene.traversal = traversal;
+
+    auto start = std::chrono::steady_clock::now();
+    if (packVoxels) {
+        pack_world(world, packed, threads);
+        scene.packed = &packed;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Packed voxels in " << ms << " ms, " << packed.byteSize() / 1024 << " KiB instead of "
+                  << world.byteSize() / 1024 << " KiB" << std::endl;
+        start = std::chrono::steady_clock::now();
+    }
+    if (traversal == Traversal::Octree) {
+        octree = OctreeWorld(world.dim);
+        build_octree(world, octree, threads);
+        scene.octree = &octree;
+    } else if (traversal == Traversal::Chunks) {
+        build_occupancy(world, occupancy, threads);
+        scene.occupancy = &occupancy;
+    } else if (traversal == Traversal::Distance) {
+        distance = DistanceField(world.dim);
+        build_distance_field(world, distance, threads);
+        scene.distance = &distance;
+    } else {
+        return scene;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Built " << traversal_name(traversal) << " acceleration in " << ms << " ms" << std::endl;
+    return scene;
+}
+
+
+glm::mat3 getRotationMatrix(glm::vec3 angles) {
+    float cx = std::cos(angles.x), sx = std::sin(angles.x);
+    float cy = std::cos(angles.y), sy = std::sin(angles.y);
+    float cz = std::cos(angles.z), sz = std::sin(angles.z);
+
+    // Column major, exactly like the GLSL mat3 constructors
+    glm::mat3 rx(1, 0, 0,
+                 0, cx, -sx,
+                 0, sx, cx);
+    glm::mat3 ry(cy, 0, sy,
+                 0, 1, 0,
+                 -sy, 0, cy);
+    glm::mat3 rz(cz, -sz, 0,
+                 sz, cz, 0,
+                 0, 0, 1);
+
+    return rz * ry * rx;
+}
+
+
+bool intersectAABB(glm::vec3 ro, glm::vec3 rd, glm::vec3 boxMin, glm::vec3 boxMax, float& tNear, float& tFar) {
+    glm::vec3 invDir = 1.0f / rd;
+
+    glm::vec3 t0s = (boxMin - ro) * invDir;
+    glm::vec3 t1s = (boxMax - ro) * invDir;
+
+    glm::vec3 tsmaller = glm::min(t0s, t1s);
+    glm::vec3 tbigger  = glm::max(t0s, t1s);
+
+    tNear = std::max(std::max(tsmaller.x, tsmaller.y), tsmaller.z);
+    tFar  = std::min(std::min(tbigger.x, tbigger.y), tbigger.z);
+
+    bool result = tFar >= std::max(tNear, 0.0f);
+    tFar = tFar + 0.001f; // same epsilon as the shader, see the comment there
+    return result;
+}
+
+
+bool setupDda(const VoxelWorld& world, glm::vec3 ro, glm::vec3 rd, DdaSetup& dda, float tMin) {
+    float tNear, tFar;
+    glm::vec3 boxMin = glm::vec3(world.voxelOrigin());
+    glm::vec3 boxMax = glm::vec3(world.voxelOrigin() + world.voxelDim());
+
+    if (!intersectAABB(ro, rd, boxMin, boxMax, tNear, tFar)) {
+        dda.pos = glm::floor(ro);
+        return false;
+    }
+
+    dda.tStart = std::max(tNear, tMin);
+    dda.tFar = tFar;
+    glm::vec3 roStart = ro + rd * dda.tStart;
+    dda.pos = glm::floor(roStart);
+    dda.step = glm::sign(rd);
+    dda.deltaDist = glm::abs(1.0f / rd);
+
+    glm::vec3 pos = dda.pos;
+    glm::vec3 deltaDist = dda.deltaDist;
+    dda.sideDist.x = (rd.x > 0.0f)
+        ? (pos.x + 1.0f - ro.x) * deltaDist.x
+        : (ro.x - pos.x) * deltaDist.x;
+    dda.sideDist.y = (rd.y > 0.0f)
+        ? (pos.y + 1.0f - ro.y) * deltaDist.y
+        : (ro.y - pos.y) * deltaDist.y;
+    dda.sideDist.z = (rd.z > 0.0f)
+        ? (pos.z + 1.0f - ro.z) * deltaDist.z
+        : (ro.z - pos.z) * deltaDist.z;
+    return true;
+}
+
+
+bool accumulateVoxel(uint32_t material, float travel, glm::vec3& accumulatedColor, float& transparency) {
+    Material m = getVoxelMaterial(material);
+
+    // ======================= OPACITY HANDLING ==================================
+    float opacity = m.opacity;
+    glm::vec3 col = m.color;
+
+    // Fast branch when reaching opaque block
+    if (opacity >= 0.99f) {
+        accumulatedColor += transparency * col;
+        transparency = 0.0f;
+        return true;
+    }
+
+    // Opacity exponential remap, same as the shader
+    float localOpacity = 1.0f - std::pow(1.0f - opacity, travel);
+    accumulatedColor += transparency * col * localOpacity;
+    transparency *= (1.0f - localOpacity);
+
+    return transparency < 0.01f;
+    // ======================= !OPACITY HANDLING ==================================
+}
+
+
+// Moves the DDA to the first voxel past the empty box [boxMin, boxMin + size) and
+// returns the t where the ray leaves it. Same as leapBox() in raymarch.glsl.
+static float leapBox(glm::vec3 ro, glm::vec3 rd, glm::ivec3 boxMin, int size, const DdaSetup& dda,
+                     glm::vec3& pos, glm::vec3& sideDist) {
+    glm::vec3 bMin(boxMin);
+    glm::vec3 bMax(boxMin + size);
+
+    glm::vec3 exitDist(
+        rd.x > 0.0f ? (bMax.x - ro.x) * dda.deltaDist.x : (ro.x - bMin.x) * dda.deltaDist.x,
+        rd.y > 0.0f ? (bMax.y - ro.y) * dda.deltaDist.y : (ro.y - bMin.y) * dda.deltaDist.y,
+        rd.z > 0.0f ? (bMax.z - ro.z) * dda.deltaDist.z : (ro.z - bMin.z) * dda.deltaDist.z
+    );
+
+    // Same tie breaking as a DDA step
+    int axis = (exitDist.x < exitDist.y && exitDist.x < exitDist.z) ? 0 : (exitDist.y < exitDist.z ? 1 : 2);
+    float t = exitDist[axis];
+
+    // Voxel of the box the ray leaves from, then one step across the exit face
+    glm::vec3 p = glm::clamp(glm::floor(ro + rd * t), bMin, bMax - 1.0f);
+    for (int a = 0; a < 3; ++a) {
+        sideDist[a] = rd[a] > 0.0f
+            ? (p[a] + 1.0f - ro[a]) * dda.deltaDist[a]
+            : (ro[a] - p[a]) * dda.deltaDist[a];
+    }
+    p[axis] = dda.step[axis] > 0.0f ? bMax[axis] : bMin[axis] - 1.0f;
+    sideDist[axis] = exitDist[axis] + dda.deltaDist[axis];
+
+    pos = p;
+    return t;
+}
+
+
+// Raw or palette packed, same as voxelMaterial() in voxel_world.glsl
+static inline uint32_t voxelMaterial(const Scene& scene, int idx) {
+    return scene.packed ? scene.packed->material(idx) : scene.world->voxels[idx].material;
+}
+
+
+static inline uint32_t materialAt(const Scene& scene, glm::ivec3 pos) {
+    int idx = scene.world->worldToIndex3D(pos);
+    return idx >= 0 ? voxelMaterial(scene, idx) : 0u;
+}
+
+
+// Chunk skipping lookup : material at pos, and CHUNK_SIZE as the empty size when
+// the whole chunk is air. Same as chunkLookup() in voxel_world.glsl.
+static uint32_t chunkLookup(const Scene& scene, glm::ivec3 pos, int& emptySize) {
+    emptySize = 1;
+    int idx = scene.world->worldToIndex3D(pos);
+    if (idx < 0) return 0u;
+
+    uint32_t occ = (*scene.occupancy)[idx / CHUNK_VOXELS];
+    if (occ == 0u) {
+        emptySize = CHUNK_SIZE;
+        return 0u;
+    }
+    if (occ != CHUNK_MIXED) return occ;
+    return voxelMaterial(scene, idx);
+}
+
+
+// Distance field lookup : material at pos, and the empty cube around it when it's air.
+// Same as distanceLookup() in voxel_world.glsl.
+static uint32_t distanceLookup(const Scene& scene, glm::ivec3 pos, glm::ivec3& emptyMin, int& emptySize) {
+    emptyMin = pos;
+    emptySize = 1;
+    int idx = scene.world->worldToIndex3D(pos);
+    if (idx < 0) return 0u;
+
+    uint32_t material = voxelMaterial(scene, idx);
+    int d = scene.distance->at(idx);
+    if (material == 0u && d > 1) {
+        emptyMin = pos - (d - 1);
+        emptySize = 2 * d - 1;
+    }
+    return material;
+}
+
+
+uint32_t voxelLookup(const Scene& scene, glm::ivec3 pos, glm::ivec3& emptyMin, int& emptySize) {
+    emptySize = 1;
+    if (scene.traversal == Traversal::Distance) return distanceLookup(scene, pos, emptyMin, emptySize);
+
+    uint32_t material;
+    if (scene.traversal == Traversal::Octree) material = scene.octree->lookup(*scene.world, pos, emptySize);
+    else if (scene.traversal == Traversal::Chunks) material = chunkLookup(scene, pos, emptySize);
+    else material = materialAt(scene, pos);
+    // Octree nodes and chunks are aligned on their size
+    emptyMin = glm::ivec3(pos.x & ~(emptySize - 1), pos.y & ~(emptySize - 1), pos.z & ~(emptySize - 1));
+    return material;
+}
+
+
+bool raymarch(const Scene& scene, glm::vec3 ro, glm::vec3 rd,
+              glm::vec3& accumulatedColor, float& transparency, uint32_t& steps, glm::vec3& impactPosition,
+              float tMin, RayHit* firstHit) {
+    const VoxelWorld& world = *scene.world;
+
+    accumulatedColor = glm::vec3(0.0f);
+    transparency = 1.0f;
+    if (firstHit) *firstHit = RayHit{};
+
+    DdaSetup dda;
+    if (!setupDda(world, ro, rd, dda, std::max(tMin, 0.0f))) {
+        steps = 0;
+        impactPosition = dda.pos;
+        return false;
+    }
+
+    glm::vec3 pos = dda.pos;
+    glm::vec3 sideDist = dda.sideDist;
+    float last_t = dda.tStart;
+
+    for (int i = 0; i < MAX_STEPS; ++i) {
+        glm::ivec3 ipos(pos);
+
+        float t = std::min(std::min(sideDist.x, sideDist.y), sideDist.z);
+
+        int emptySize;
+        glm::ivec3 emptyMin;
+        uint32_t material = voxelLookup(scene, ipos, emptyMin, emptySize);
+
+        if (material != 0u) {
+            if (firstHit && firstHit->distance == 0.0f) *firstHit = RayHit{std::max(last_t, 1e-6f), ipos};
+            if (accumulateVoxel(material, t - last_t, accumulatedColor, transparency)) {
+                steps = i;
+                impactPosition = pos;
+                return true;
+            }
+        } else if (emptySize > 1) {
+            // The whole node / chunk / cube is air, jump straight past it
+            last_t = leapBox(ro, rd, emptyMin, emptySize, dda, pos, sideDist);
+
+            if (last_t > dda.tFar) {
+                steps = i;
+                impactPosition = pos;
+                return true;
+            }
+            continue;
+        }
+
+        if (sideDist.x < sideDist.y && sideDist.x < sideDist.z) {
+            pos.x += dda.step.x;
+            sideDist.x += dda.deltaDist.x;
+        } else if (sideDist.y < sideDist.z) {
+            pos.y += dda.step.y;
+            sideDist.y += dda.deltaDist.y;
+        } else {
+            pos.z += dda.step.z;
+            sideDist.z += dda.deltaDist.z;
+        }
+
+        last_t = t;
+
+        if (t > dda.tFar) {
+            steps = i;
+            impactPosition = pos;
+            return true;
+        }
+    }
+
+    // The shader leaves these undefined here, we report the exhausted budget instead
+    steps = MAX_STEPS;
+    impactPosition = pos;
+    return false;
+}
+
+
+// hashing function. NOTE : GPU sin() is not IEEE, so on big arguments this won't
+// match the driver bit for bit. It only drives the 7% darkening variation though.
+static float hash(float n) {
+    float v = std::sin(n) * 43758.5453123f;
+    return v - std::floor(v);
+}
+
+
+void primaryRay(const Camera& cam, glm::vec2 fragCoord, glm::vec2 resolution, glm::vec3& ro, glm::vec3& rd) {
+    glm::vec2 uv = (fragCoord / resolution) * 2.0f - 1.0f;
+    uv.x *= resolution.x / resolution.y;
+
+    float fovScale = std::tan(glm::radians(cam.fov) * 0.5f);
+    rd = glm::normalize(glm::vec3(uv.x * fovScale, uv.y * fovScale, -1.0f));
+    ro = cam.pos;
+
+    glm::mat3 rot = getRotationMatrix(glm::vec3(cam.rot.x, cam.rot.y, 0.0f));
+    rd = rot * rd;
+}
+
+
+glm::vec3 shadeRay(glm::vec3 rd, glm::vec3 color, float transparency, uint32_t steps, glm::vec3 impactPosition, int renderDebug) {
+    // This displays the number of steps/max steps
+    if (renderDebug == 1) {
+        return glm::vec3(float(steps) / MAX_STEPS);
+    }
+
+    glm::vec3 skyColor = rd.y < 0.0f ? glm::vec3(135, 121, 100) / 255.0f : glm::vec3(103, 159, 201) / 255.0f;
+
+    color -= color * hash(impactPosition.x + impactPosition.x * impactPosition.y + impactPosition.x * impactPosition.y * impactPosition.z) * 0.07f;
+    return color + transparency * skyColor;
+}
+
+
+// Same conversion as a GL_RGBA8 framebuffer
+static uint8_t to_unorm8(float v) {
+    return (uint8_t)std::lround(glm::clamp(v, 0.0f, 1.0f) * 255.0f);
+}
+
+
+void store_pixel(Image& image, int x, int y, glm::vec3 color) {
+    // gl_FragCoord.y goes up, image rows go down
+    uint8_t* px = &image.rgb[((size_t)(image.height - 1 - y) * image.width + x) * 3];
+    px[0] = to_unorm8(color.x);
+    px[1] = to_unorm8(color.y);
+    px[2] = to_unorm8(color.z);
+}
+
+
+// Splits the image in tiles handed out to `threads` workers, tileFn returns the step counts of its tile
+template <typename TileFn>
+static void run_tiles(Image& image, int threads, RenderStats* stats, TileFn tileFn) {
+    const int TILE = 16;
+    int tilesX = (image.width + TILE - 1) / TILE;
+    int tilesY = (image.height + TILE - 1) / TILE;
+
+    std::atomic<uint64_t> totalSteps(0), totalExhausted(0);
+    auto start = std::chrono::steady_clock::now();
+
+    parallel_for(tilesX * tilesY, threads, [&](int tile) {
+        int x0 = (tile % tilesX) * TILE;
+        int y0 = (tile / tilesX) * TILE;
+        int x1 = std::min(x0 + TILE, image.width);
+        int y1 = std::min(y0 + TILE, image.height);
+        TileCounts counts = tileFn(x0, y0, x1, y1);
+        totalSteps += counts.steps;
+        totalExhausted += counts.exhausted;
+    });
+
+    auto end = std::chrono::steady_clock::now();
+
+    if (stats) {
+        stats->rays += (uint64_t)image.width * image.height;
+        stats->steps += totalSteps;
+        stats->exhausted += totalExhausted;
+        stats->seconds += std::chrono::duration<double>(end - start).count();
+    }
+}
+
+
+void render_cpu(const Scene& scene, const Camera& cam, Image& image, int renderDebug,
+                RenderStats* stats, int threads, const std::vector<float>* tStart, HitBuffer* hits) {
+    if (scene.traversal == Traversal::Octree && !scene.octree)
+        throw std::invalid_argument("Octree traversal needs an octree");
+    if (scene.traversal == Traversal::Chunks && !scene.occupancy)
+        throw std::invalid_argument("Chunk traversal needs the occupancy table");
+    if (scene.traversal == Traversal::Distance && !scene.distance)
+        throw std::invalid_argument("Distance traversal needs the distance field");
+
+    glm::vec2 resolution((float)image.width, (float)image.height);
+    if (tStart && tStart->size() != (size_t)image.width * image.height)
+        throw std::invalid_argument("tStart doesn't match the image size");
+    if (hits) {
+        if (hits->width != image.width || hits->height != image.height) hits->resize(image.width, image.height);
+        hits->cam = cam;
+    }
+
+    run_tiles(image, threads, stats, [&](int x0, int y0, int x1, int y1) {
+        TileCounts counts;
+        for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x) {
+            glm::vec3 ro, rd;
+            primaryRay(cam, glm::vec2(x + 0.5f, y + 0.5f), resolution, ro, rd);
+
+            glm::vec3 color, impactPosition;
+            float transparency;
+            uint32_t steps;
+            size_t pixel = (size_t)y * image.width + x;
+            raymarch(scene, ro, rd, color, transparency, steps, impactPosition,
+                     tStart ? (*tStart)[pixel] : 0.0f, hits ? &hits->hits[pixel] : nullptr);
+            counts.add(steps);
+
+            store_pixel(image, x, y, shadeRay(rd, color, transparency, steps, impactPosition, renderDebug));
+        }
+        return counts;
+    });
+}
+
+
+void render_cpu_packet(const VoxelWorld& world, const Camera& cam, Image& image, int renderDebug,
+                       RenderStats* stats, int threads, PacketIsa isa) {
+    PacketTileFn kernel = packet_tile_kernel(isa);
+
+    run_tiles(image, threads, stats, [&](int x0, int y0, int x1, int y1) {
+        return kernel(world, cam, image, renderDebug, x0, y0, x1, y1);
+    });
+}
+
+
+void write_ppm(const std::string& path, const Image& image) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Failed to open image file : " + path);
+    out << "P6\n" << image.width << " " << image.height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(image.rgb.data()), image.rgb.size());
+}
+
+
+size_t count_mismatched_pixels(const Image& a, const Image& b, int tolerance, int* maxDiff) {
+    if (a.width != b.width || a.height != b.height)
+        throw std::invalid_argument("Image sizes don't match");
+
+    size_t mismatched = 0;
+    int worst = 0;
+    for (size_t p = 0; p < a.rgb.size(); p += 3) {
+        int diff = 0;
+        for (int c = 0; c < 3; ++c)
+            diff = std::max(diff, std::abs(int(a.rgb[p + c]) - int(b.rgb[p + c])));
+        if (diff > tolerance) mismatched++;
+        worst = std::max(worst, diff);
+    }
+    if (maxDiff) *maxDiff = worst;
+    return mismatched;
+}
+
+
+uint64_t hash_image(const Image& image) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto add = [&](uint8_t byte) { h = (h ^ byte) * 0x100000001b3ull; };
+    for (int v : {image.width, image.height})
+        for (int b = 0; b < 4; ++b) add(uint8_t(v >> (8 * b)));
+    for (uint8_t byte : image.rgb) add(byte);
+    return h;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "world.hpp"
+#include "octree.hpp"
+#include "distance_field.hpp"
+#include "packed_world.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU port of raymarch.glsl (shader.glsl). Same DDA, same materials, same shading, so a frame
+// rendered here should match the fragment shader for the same camera
+// (up to sin() precision in the darkening hash, see hash() in the .cpp).
+
+const int MAX_STEPS = 1024;
+
+// How rays walk the world, same values as the traversalMode uniform in voxel_world.glsl
+enum class Traversal {
+    Dda = 0,        // one voxel per step
+    Octree = 1,     // DDA that jumps over empty sparse octree nodes
+    Chunks = 2,     // DDA that jumps over empty chunks (occupancy table)
+    Distance = 3,   // DDA that jumps over the empty cube given by the distance field
+};
+
+const int TRAVERSAL_COUNT = 4;
+
+// What the CPU raymarcher traces against. The acceleration structures are optional,
+// a traversal mode only needs its own. With `packed` set, voxel materials are read
+// through the palettes (voxelFormat = 1 in voxel_world.glsl) instead of world->voxels.
+struct Scene {
+    const VoxelWorld* world;
+    const OctreeWorld* octree = nullptr;
+    const std::vector<uint32_t>* occupancy = nullptr;
+    const DistanceField* distance = nullptr;
+    const PackedVoxels* packed = nullptr;
+    Traversal traversal = Traversal::Dda;
+
+    Scene(const VoxelWorld& world) : world(&world) {}   // plain DDA over the raw voxels
+};
+
+// Owns whatever a traversal mode needs on top of the voxels
+struct SceneAccel {
+    OctreeWorld octree{glm::ivec3(0)};
+    std::vector<uint32_t> occupancy;
+    DistanceField distance{glm::ivec3(0)};
+    PackedVoxels packed{glm::ivec3(0)};
+
+    // Builds what `traversal` needs (and prints how long it took), returns the scene.
+    // `packVoxels` also packs the voxels and has the scene read them from there.
+    Scene prepare(const VoxelWorld& world, Traversal traversal, int threads = 0, bool packVoxels = false);
+};
+
+const char* traversal_name(Traversal traversal);
+bool parse_traversal(const std::string& name, Traversal& traversal);
+
+struct Camera {
+    glm::vec3 pos;
+    glm::vec2 rot;      // pitch (camRot.x), yaw (camRot.y)
+    float fov = 60.0f;  // degrees, vertical
+};
+
+// 8 bit RGB, top row first (PPM order, NOT gl_FragCoord order)
+struct Image {
+    int width = 0, height = 0;
+    std::vector<uint8_t> rgb;
+
+    void resize(int w, int h) { width = w; height = h; rgb.assign((size_t)w * h * 3, 0); }
+};
+
+struct RenderStats {
+    uint64_t rays = 0;
+    uint64_t steps = 0;     // sum of the RENDER_DEBUG=1 step counts
+    uint64_t exhausted = 0; // rays that ran out of MAX_STEPS
+    double seconds = 0.0;
+
+    double avgSteps() const { return rays ? double(steps) / double(rays) : 0.0; }
+    double raysPerSecond() const { return seconds > 0.0 ? double(rays) / seconds : 0.0; }
+};
+
+
+glm::mat3 getRotationMatrix(glm::vec3 angles);
+
+bool intersectAABB(glm::vec3 ro, glm::vec3 rd, glm::vec3 boxMin, glm::vec3 boxMax, float& tNear, float& tFar);
+
+// Everything raymarch() does before its loop, shared with the packet kernels
+struct DdaSetup {
+    glm::vec3 pos, step, deltaDist, sideDist;
+    float tStart, tFar;
+};
+
+// false when the ray misses the world box (only pos is set then). The walk starts at
+// tMin when that's past the box entry.
+bool setupDda(const VoxelWorld& world, glm::vec3 ro, glm::vec3 rd, DdaSetup& dda, float tMin = 0.0f);
+
+// Opacity handling for one non-air voxel, returns true when the ray is done
+bool accumulateVoxel(uint32_t material, float travel, glm::vec3& accumulatedColor, float& transparency);
+
+// Material at pos, and the empty box [emptyMin, emptyMin + emptySize) around it that the
+// scene's traversal structure knows of when it's air (size 1 : just this voxel). Same as
+// voxelLookup() in voxel_world.glsl.
+uint32_t voxelLookup(const Scene& scene, glm::ivec3 pos, glm::ivec3& emptyMin, int& emptySize);
+
+// Where a ray first entered a non-air voxel, the G-buffer of the temporal reprojection
+// (reprojection.hpp). distance 0 : it never did.
+struct RayHit {
+    float distance = 0.0f;
+    glm::ivec3 voxel{0};
+};
+
+// Per pixel RayHit of a frame and the camera it was drawn with
+struct HitBuffer {
+    int width = 0, height = 0;
+    Camera cam{};
+    std::vector<RayHit> hits;
+
+    void resize(int w, int h) { width = w; height = h; hits.assign((size_t)w * h, RayHit{}); }
+};
+
+// tMin skips the start of the ray (it must be air up to there), firstHit gets the RayHit
+bool raymarch(const Scene& scene, glm::vec3 ro, glm::vec3 rd,
+              glm::vec3& accumulatedColor, float& transparency, uint32_t& steps, glm::vec3& impactPosition,
+              float tMin = 0.0f, RayHit* firstHit = nullptr);
+
+// Ray through a pixel, fragCoord is gl_FragCoord.xy (bottom-left origin, pixel centers at .5)
+void primaryRay(const Camera& cam, glm::vec2 fragCoord, glm::vec2 resolution, glm::vec3& ro, glm::vec3& rd);
+
+// Everything shadePixel() in raymarch.glsl does after raymarch()
+glm::vec3 shadeRay(glm::vec3 rd, glm::vec3 color, float transparency, uint32_t steps, glm::vec3 impactPosition, int renderDebug);
+
+// Writes a shaded pixel, x/y in gl_FragCoord convention
+void store_pixel(Image& image, int x, int y, glm::vec3 color);
+
+// Renders the whole frame, split in tiles over `threads` workers (0 = all cores).
+// tStart : per pixel (gl_FragCoord rows) raymarch() tMin, hits : filled with every pixel's RayHit
+void render_cpu(const Scene& scene, const Camera& cam, Image& image, int renderDebug,
+                RenderStats* stats = nullptr, int threads = 0,
+                const std::vector<float>* tStart = nullptr, HitBuffer* hits = nullptr);
+
+
+// ================== SIMD packet traversal (cpu_raymarch_packet.cpp) ============
+// Plain DDA (Traversal::Dda), but stepping a small block of coherent primary rays together with
+// the per-ray state (pos, sideDist, ...) kept in SoA vectors. Images are identical
+// to render_cpu(). The widest instruction set the CPU supports is picked at runtime.
+enum class PacketIsa { Best, Generic4, Avx2x8, Avx512x16 };
+
+// What a tile of rays adds to the RenderStats
+struct TileCounts {
+    uint64_t steps = 0;
+    uint64_t exhausted = 0;
+
+    void add(uint32_t raySteps) {
+        steps += raySteps;
+        if (raySteps >= (uint32_t)MAX_STEPS) exhausted++;
+    }
+};
+
+// Tile kernel : renders pixels [x0,x1) x [y0,y1), returns its step counts
+typedef TileCounts (*PacketTileFn)(const VoxelWorld& world, const Camera& cam, Image& image,
+                                 int renderDebug, int x0, int y0, int x1, int y1);
+
+// Best resolves to the widest supported kernel, throws if `isa` isn't supported here
+PacketTileFn packet_tile_kernel(PacketIsa isa);
+
+bool packet_isa_supported(PacketIsa isa);
+const char* packet_isa_name(PacketIsa isa);
+int packet_isa_width(PacketIsa isa);
+
+void render_cpu_packet(const VoxelWorld& world, const Camera& cam, Image& image, int renderDebug,
+                       RenderStats* stats = nullptr, int threads = 0, PacketIsa isa = PacketIsa::Best);
+
+void write_ppm(const std::string& path, const Image& image);
+
+// Pixels where any channel differs by more than `tolerance` (images must be the same size)
+size_t count_mismatched_pixels(const Image& a, const Image& b, int tolerance, int* maxDiff = nullptr);
+
+// FNV-1a 64 of the size and the pixels, for spotting frames that changed
+uint64_t hash_image(const Image& image);
@@ -0,0 +1,110 @@
+
+#include "cpu_raymarch.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PACKET_X86 1
+#include <immintrin.h>
+#endif
+
+// The packet kernel is compiled once per instruction set from cpu_raymarch_packet.inl.
+// AVX2 / AVX-512 get enabled with target pragmas on just those copies, so the rest
+// of the program stays baseline x86-64 and the choice is made at runtime.
+
+const int CHUNK_MASK = CHUNK_SIZE - 1;
+
+
+// ===== 4 lanes, plain GCC vectors (SSE2 on x86-64, NEON elsewhere) =====
+#define PACKET_NS packet_generic4
+#define PACKET_WIDTH 4
+#include "cpu_raymarch_packet.inl"
+#undef PACKET_NS
+#undef PACKET_WIDTH
+
+
+#ifdef PACKET_X86
+
+// ===== 8 lanes, AVX2 =====
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define PACKET_NS packet_avx2
+#define PACKET_WIDTH 8
+#define PACKET_AVX2
+#include "cpu_raymarch_packet.inl"
+#undef PACKET_NS
+#undef PACKET_WIDTH
+#undef PACKET_AVX2
+#pragma GCC pop_options
+
+// ===== 16 lanes, AVX-512 =====
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define PACKET_NS packet_avx512
+#define PACKET_WIDTH 16
+#define PACKET_AVX512
+#include "cpu_raymarch_packet.inl"
+#undef PACKET_NS
+#undef PACKET_WIDTH
+#undef PACKET_AVX512
+#pragma GCC pop_options
+
+#endif
+
+
+bool packet_isa_supported(PacketIsa isa) {
+    switch (isa) {
+    case PacketIsa::Best:
+    case PacketIsa::Generic4:
+        return true;
+#ifdef PACKET_X86
+    case PacketIsa::Avx2x8:
+        return __builtin_cpu_supports("avx2");
+    case PacketIsa::Avx512x16:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+
+const char* packet_isa_name(PacketIsa isa) {
+    switch (isa) {
+    case PacketIsa::Best: return "best";
+    case PacketIsa::Generic4: return "generic x4";
+    case PacketIsa::Avx2x8: return "avx2 x8";
+    case PacketIsa::Avx512x16: return "avx512 x16";
+    }
+    return "?";
+}
+
+
+int packet_isa_width(PacketIsa isa) {
+    switch (isa) {
+    case PacketIsa::Generic4: return 4;
+    case PacketIsa::Avx2x8: return 8;
+    case PacketIsa::Avx512x16: return 16;
+    default: return 0;
+    }
+}
+
+
+PacketTileFn packet_tile_kernel(PacketIsa isa) {
+    if (isa == PacketIsa::Best) {
+        if (packet_isa_supported(PacketIsa::Avx512x16)) isa = PacketIsa::Avx512x16;
+        else if (packet_isa_supported(PacketIsa::Avx2x8)) isa = PacketIsa::Avx2x8;
+        else isa = PacketIsa::Generic4;
+    }
+    if (!packet_isa_supported(isa))
+        throw std::runtime_error(std::string("Packet traversal not supported on this CPU : ") + packet_isa_name(isa));
+
+    switch (isa) {
+#ifdef PACKET_X86
+    case PacketIsa::Avx2x8: return packet_avx2::tile;
+    case PacketIsa::Avx512x16: return packet_avx512::tile;
+#endif
+    default: return packet_generic4::tile;
+    }
+}
@@ -0,0 +1,171 @@
+// Packet DDA kernel. Included once per instruction set by cpu_raymarch_packet.cpp,
+// with PACKET_NS, PACKET_WIDTH and optionally PACKET_AVX2 / PACKET_AVX512 defined.
+// Keep it in sync with raymarch() in cpu_raymarch.cpp : same step order, same
+// compares, so every lane ends on the exact same voxel and step count.
+
+namespace PACKET_NS {
+
+const int W = PACKET_WIDTH;
+// Lanes cover a PW x PH block of pixels : 2x2, 4x2 or 4x4
+const int PW = W >= 8 ? 4 : 2;
+const int PH = W / PW;
+
+typedef float vfloat __attribute__((vector_size(W * sizeof(float))));
+typedef int32_t vint __attribute__((vector_size(W * sizeof(int32_t))));
+
+
+static inline bool any(vint mask) {
+#if defined(PACKET_AVX512)
+    return _mm512_test_epi32_mask((__m512i)mask, (__m512i)mask) != 0;
+#elif defined(PACKET_AVX2)
+    return !_mm256_testz_si256((__m256i)mask, (__m256i)mask);
+#else
+    for (int l = 0; l < W; ++l)
+        if (mask[l]) return true;
+    return false;
+#endif
+}
+
+// Masked load of base[idx], 0 in the lanes that are off
+static inline vint gather(const uint32_t* base, vint idx, vint mask) {
+#if defined(PACKET_AVX512)
+    __mmask16 k = _mm512_test_epi32_mask((__m512i)mask, (__m512i)mask);
+    return (vint)_mm512_mask_i32gather_epi32(_mm512_setzero_si512(), k, (__m512i)idx, base, 4);
+#elif defined(PACKET_AVX2)
+    return (vint)_mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)base, (__m256i)idx, (__m256i)mask, 4);
+#else
+    vint out = {};
+    for (int l = 0; l < W; ++l)
+        if (mask[l]) out[l] = (int32_t)base[idx[l]];
+    return out;
+#endif
+}
+
+static inline vfloat vmin(vfloat a, vfloat b) {
+    return a < b ? a : b;
+}
+
+
+static TileCounts tile(const VoxelWorld& world, const Camera& cam, Image& image,
+                     int renderDebug, int x0, int y0, int x1, int y1) {
+    glm::vec2 resolution((float)image.width, (float)image.height);
+    const uint32_t* voxels = reinterpret_cast<const uint32_t*>(world.voxels.data());
+    const int dimX = world.dim.x, dimY = world.dim.y, dimZ = world.dim.z;
+    const glm::ivec3 origin = world.origin, originSlot = world.originSlot;
+
+    TileCounts counts;
+
+    for (int by = y0; by < y1; by += PH)
+    for (int bx = x0; bx < x1; bx += PW) {
+
+        // ===== Lane setup, scalar (exactly what raymarch() does) =====
+        vint posX = {}, posY = {}, posZ = {};
+        vint stepX = {}, stepY = {}, stepZ = {};
+        vfloat sideX = {}, sideY = {}, sideZ = {};
+        vfloat deltaX = {}, deltaY = {}, deltaZ = {};
+        vfloat tFar = {}, lastT = {};
+        vint active = {};
+
+        glm::vec3 rds[W], color[W], impact[W];
+        float transparency[W];
+        uint32_t steps[W];
+
+        for (int l = 0; l < W; ++l) {
+            int x = bx + l % PW, y = by + l / PW;
+            color[l] = glm::vec3(0.0f);
+            transparency[l] = 1.0f;
+            steps[l] = 0;
+            if (x >= x1 || y >= y1) continue;
+
+            glm::vec3 ro;
+            primaryRay(cam, glm::vec2(x + 0.5f, y + 0.5f), resolution, ro, rds[l]);
+
+            DdaSetup dda;
+            if (!setupDda(world, ro, rds[l], dda)) {
+                impact[l] = dda.pos;
+                continue;
+            }
+
+            posX[l] = (int32_t)dda.pos.x; posY[l] = (int32_t)dda.pos.y; posZ[l] = (int32_t)dda.pos.z;
+            stepX[l] = (int32_t)dda.step.x; stepY[l] = (int32_t)dda.step.y; stepZ[l] = (int32_t)dda.step.z;
+            sideX[l] = dda.sideDist.x; sideY[l] = dda.sideDist.y; sideZ[l] = dda.sideDist.z;
+            deltaX[l] = dda.deltaDist.x; deltaY[l] = dda.deltaDist.y; deltaZ[l] = dda.deltaDist.z;
+            tFar[l] = dda.tFar;
+            lastT[l] = dda.tStart;
+            active[l] = -1;
+        }
+
+        // ===== Packet DDA =====
+        for (int i = 0; i < MAX_STEPS && any(active); ++i) {
+            // worldToIndex3D, with shifts since CHUNK_SIZE is a power of two : chunk relative
+            // to the window, then its slot in the ring
+            vint cx = (posX >> CHUNK_SHIFT) - origin.x, cy = (posY >> CHUNK_SHIFT) - origin.y, cz = (posZ >> CHUNK_SHIFT) - origin.z;
+            vint inside = (cx >= 0) & (cy >= 0) & (cz >= 0) & (cx < dimX) & (cy < dimY) & (cz < dimZ);
+            cx += originSlot.x; cy += originSlot.y; cz += originSlot.z;
+            cx -= (cx >= dimX) & dimX; cy -= (cy >= dimY) & dimY; cz -= (cz >= dimZ) & dimZ;
+            vint local = layout_local_index<VOXEL_LAYOUT, CHUNK_SHIFT>(posX & CHUNK_MASK, posY & CHUNK_MASK, posZ & CHUNK_MASK);
+            vint idx = (((cz * dimY + cy) * dimX + cx) << (3 * CHUNK_SHIFT)) | local;
+
+            vint lookup = active & inside;
+            vint material = gather(voxels, idx, lookup);
+            vfloat t = vmin(vmin(sideX, sideY), sideZ);
+
+            // Non-air voxels are rare (one per ray, or a few in water), handle them per lane
+            vint hit = lookup & (material != 0);
+            if (any(hit)) {
+                for (int l = 0; l < W; ++l) {
+                    if (!hit[l]) continue;
+                    if (accumulateVoxel((uint32_t)material[l], t[l] - lastT[l], color[l], transparency[l])) {
+                        steps[l] = i;
+                        impact[l] = glm::vec3((float)posX[l], (float)posY[l], (float)posZ[l]);
+                        active[l] = 0;
+                    }
+                }
+            }
+
+            vint selX = (sideX < sideY) & (sideX < sideZ);
+            vint selY = ~selX & (sideY < sideZ);
+            vint selZ = ~(selX | selY);
+            selX &= active;
+            selY &= active;
+            selZ &= active;
+
+            posX += selX & stepX;
+            posY += selY & stepY;
+            posZ += selZ & stepZ;
+            sideX = selX ? sideX + deltaX : sideX;
+            sideY = selY ? sideY + deltaY : sideY;
+            sideZ = selZ ? sideZ + deltaZ : sideZ;
+
+            lastT = active ? t : lastT;
+
+            vint exited = active & (t > tFar);
+            if (any(exited)) {
+                for (int l = 0; l < W; ++l) {
+                    if (!exited[l]) continue;
+                    steps[l] = i;
+                    impact[l] = glm::vec3((float)posX[l], (float)posY[l], (float)posZ[l]);
+                }
+                active &= ~exited;
+            }
+        }
+
+        // Whatever is left ran out of steps
+        for (int l = 0; l < W; ++l) {
+            if (!active[l]) continue;
+            steps[l] = MAX_STEPS;
+            impact[l] = glm::vec3((float)posX[l], (float)posY[l], (float)posZ[l]);
+        }
+
+        for (int l = 0; l < W; ++l) {
+            int x = bx + l % PW, y = by + l / PW;
+            if (x >= x1 || y >= y1) continue;
+            counts.add(steps[l]);
+            store_pixel(image, x, y, shadeRay(rds[l], color[l], transparency[l], steps[l], impact[l], renderDebug));
+        }
+    }
+
+    return counts;
+}
+
+} // namespace PACKET_NS
@@ -48,6 +48,87 @@ def convert_and_save_chunks(array, chunk_size, output_dir="."):
 
     print(f"Chunks saved to '{output_dir}'")
 
+ARCHIVE_MAGIC = 0x52415856  # "VXAR"
+ARCHIVE_VERSION = 1
+ARCHIVE_ALIGN = 4096
+ARCHIVE_UNIFORM = 1
+ARCHIVE_PACKED_ALIGN = 16
+CHUNK_RLE = 1
+
+
+def encode_chunk_rle(chunk):
+    """
+    Run-length payload of one chunk, same layout as chunk_codec.hpp : run count,
+    uint16 run lengths - 1, padding to 4 bytes, uint32 materials. x fastest.
+    """
+    import struct
+
+    flat = np.ascontiguousarray(chunk).ravel()
+    starts = np.flatnonzero(np.concatenate(([True], flat[1:] != flat[:-1])))
+    lengths = np.diff(np.append(starts, flat.size)) - 1
+    lengths_bytes = lengths.astype('<u2').tobytes()
+    padding = b"\0" * (-(4 + len(lengths_bytes)) % 4)
+    return struct.pack('<I', starts.size) + lengths_bytes + padding + flat[starts].astype('<u4').tobytes()
+
+def convert_and_save_archive(array, chunk_size, path="world.vxa", compress=False):
+    """
+    Same chunking as convert_and_save_chunks, but writes one world archive (see
+    world_archive.hpp) instead of a file per chunk : header, one index entry per
+    chunk, then the raw chunks on 4096 byte boundaries. Chunks that are a single
+    material only get an index entry. With compress, chunks are run-length encoded
+    (on 16 byte boundaries) when that makes them smaller.
+
+    Parameters:
+        array (np.ndarray): Input numpy array of dtype np.uint32, indexed [z, y, x].
+        chunk_size (int): The size of each chunk along each axis, must match CHUNK_SIZE.
+        path (str): Archive file to write.
+        compress (bool): Run-length encode the chunks, like --compress rle.
+    """
+    import struct
+
+    if not isinstance(array, np.ndarray) or array.dtype != np.uint32 or array.ndim != 3:
+        raise ValueError("Input must be a 3D numpy array of dtype np.uint32.")
+
+    pad = [(0, (chunk_size - n % chunk_size) % chunk_size) for n in array.shape]
+    padded = np.pad(array, pad, mode='constant', constant_values=0)
+    dim_z, dim_y, dim_x = (n // chunk_size for n in padded.shape)
+    count = dim_x * dim_y * dim_z
+
+    def align(v, alignment=ARCHIVE_ALIGN):
+        return (v + alignment - 1) // alignment * alignment
+
+    entries, payloads = [], []
+    offset = align(32 + 24 * count)
+    # Same order as the world buffer : z, then y, then x
+    for z in range(dim_z):
+        for y in range(dim_y):
+            for x in range(dim_x):
+                chunk = padded[z*chunk_size:(z+1)*chunk_size,
+                               y*chunk_size:(y+1)*chunk_size,
+                               x*chunk_size:(x+1)*chunk_size]
+                first = chunk.flat[0]
+                if np.all(chunk == first):
+                    entries.append(struct.pack('<QIHHII', 0, 0, 0, ARCHIVE_UNIFORM, int(first), 0))
+                    continue
+                data, compression = np.ascontiguousarray(chunk).tobytes(), 0
+                if compress:
+                    rle = encode_chunk_rle(chunk)
+                    if len(rle) < len(data):
+                        data, compression = rle, CHUNK_RLE
+                offset = align(offset, ARCHIVE_PACKED_ALIGN if compression else ARCHIVE_ALIGN)
+                entries.append(struct.pack('<QIHHII', offset, len(data), compression, 0, 0, 0))
+                payloads.append((offset, data))
+                offset += len(data)
+
+    with open(path, "wb") as f:
+        f.write(struct.pack('<IIIiiiII', ARCHIVE_MAGIC, ARCHIVE_VERSION, chunk_size, dim_x, dim_y, dim_z, count, 0))
+        f.write(b"".join(entries))
+        for pos, data in payloads:
+            f.seek(pos)
+            f.write(data)
+
+    print(f"Archive of {dim_x}x{dim_y}x{dim_z} chunks saved to '{path}'")
+
 # Example usage:
 if __name__ == "__main__":
     # Create a dummy array of size 70x65x80 with random uint32 values
@@ -0,0 +1,223 @@
+#include "distance_field.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <numeric>
+
+
+DistanceField::DistanceField(glm::ivec3 dim)
+    : dim(dim), dist((size_t)dim.x * dim.y * dim.z * CHUNK_VOXELS, (uint8_t)DF_MAX) {}
+
+
+// out(p) = min over |k| <= DF_MAX of max(|k|, in(p + k * axis)) on a box of `size`
+// voxels, x fastest, for the y and z axes. Reads outside of the box count as DF_MAX,
+// which never wins.
+static void window_pass(const uint8_t* in, uint8_t* out, glm::ivec3 size, int axis, int threads) {
+    parallel_for(size.z, threads, [&](int z) {
+        const int width = size.x;   // local, byte stores could alias the captured size
+        for (int y = 0; y < size.y; ++y) {
+            size_t row = ((size_t)z * size.y + y) * width;
+            uint8_t* o = out + row;
+            std::fill(o, o + width, (uint8_t)DF_MAX);
+
+            // Offsets by increasing |k| : once the whole row is <= |k| nothing further can lower it
+            for (int ak = 0; ak <= DF_MAX; ++ak) {
+                for (int k : {ak, -ak}) {
+                    if (k == 0 && ak != 0) continue;
+                    uint8_t dk = (uint8_t)ak;
+                    const uint8_t* src;
+                    if (axis == 1) {
+                        if (y + k < 0 || y + k >= size.y) continue;
+                        src = in + ((size_t)z * size.y + (y + k)) * size.x;
+                    } else {
+                        if (z + k < 0 || z + k >= size.z) continue;
+                        src = in + ((size_t)(z + k) * size.y + y) * size.x;
+                    }
+
+                    // Contiguous bytes, vectorizes
+                    for (int x = 0; x < width; ++x) {
+                        uint8_t v = src[x] > dk ? src[x] : dk;
+                        o[x] = v < o[x] ? v : o[x];
+                    }
+                }
+
+                uint8_t rowMax = 0;
+                for (int x = 0; x < width; ++x) rowMax = o[x] > rowMax ? o[x] : rowMax;
+                if (rowMax <= ak + 1) break;
+            }
+        }
+    });
+}
+
+
+// First pass, along x : the input is only 0 / DF_MAX there, so the window is just the
+// 1D distance to the closest solid voxel of the row, two sweeps instead of 33 reads
+static void x_pass(const uint8_t* in, uint8_t* out, glm::ivec3 size, int threads) {
+    parallel_for(size.z, threads, [&](int z) {
+        for (int y = 0; y < size.y; ++y) {
+            size_t row = ((size_t)z * size.y + y) * size.x;
+            const uint8_t* i = in + row;
+            uint8_t* o = out + row;
+
+            int d = DF_MAX;
+            for (int x = 0; x < size.x; ++x) {
+                d = i[x] == 0 ? 0 : std::min(d + 1, DF_MAX);
+                o[x] = (uint8_t)d;
+            }
+            d = DF_MAX;
+            for (int x = size.x - 1; x >= 0; --x) {
+                d = o[x] == 0 ? 0 : std::min(d + 1, (int)o[x]);
+                o[x] = (uint8_t)d;
+            }
+        }
+    });
+}
+
+
+// Calls fn(x, voxelIndex) for x in [x0, x1] of the world row (y, z)
+template <typename Fn>
+static void for_row(const VoxelWorld& world, int x0, int x1, int y, int z, Fn fn) {
+    int chunkBase = 0;
+    glm::ivec3 local(0, y & (CHUNK_SIZE - 1), z & (CHUNK_SIZE - 1));
+    for (int x = x0; x <= x1; ++x) {
+        local.x = x & (CHUNK_SIZE - 1);
+        if (x == x0 || local.x == 0)
+            chunkBase = world.chunkIndex(glm::ivec3(floor_div(x, CHUNK_SIZE), floor_div(y, CHUNK_SIZE), floor_div(z, CHUNK_SIZE))) * (int)CHUNK_VOXELS;
+        fn(x, chunkBase + chunk_local_index(local));
+    }
+}
+
+
+// Distances of the voxels in [lo, hi], computed over that box grown by DF_MAX so the
+// passes see every solid voxel that can matter. Everything clamped to the world window.
+static void compute_box(const VoxelWorld& world, DistanceField& field, glm::ivec3 lo, glm::ivec3 hi, int threads) {
+    glm::ivec3 worldMin = world.voxelOrigin();
+    glm::ivec3 worldMax = worldMin + world.voxelDim() - 1;
+    lo = glm::max(lo, worldMin);
+    hi = glm::min(hi, worldMax);
+    if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z) return;
+
+    glm::ivec3 eLo = glm::max(lo - DF_MAX, worldMin);
+    glm::ivec3 eHi = glm::min(hi + DF_MAX, worldMax);
+    glm::ivec3 size = eHi - eLo + 1;
+
+    std::vector<uint8_t> a((size_t)size.x * size.y * size.z), b(a.size());
+
+    // Seed : 0 on anything that isn't air
+    parallel_for(size.z, threads, [&](int z) {
+        for (int y = 0; y < size.y; ++y) {
+            uint8_t* row = &a[((size_t)z * size.y + y) * size.x];
+            for_row(world, eLo.x, eHi.x, eLo.y + y, eLo.z + z, [&](int x, int idx) {
+                row[x - eLo.x] = world.voxels[idx].material != 0u ? 0 : (uint8_t)DF_MAX;
+            });
+        }
+    });
+
+    x_pass(a.data(), b.data(), size, threads);
+    window_pass(b.data(), a.data(), size, 1, threads);
+    window_pass(a.data(), b.data(), size, 2, threads);
+
+    parallel_for(hi.z - lo.z + 1, threads, [&](int z) {
+        for (int y = lo.y; y <= hi.y; ++y) {
+            const uint8_t* row = &b[((size_t)(lo.z + z - eLo.z) * size.y + (y - eLo.y)) * size.x];
+            for_row(world, lo.x, hi.x, y, lo.z + z, [&](int x, int idx) {
+                field.dist[idx] = row[x - eLo.x];
+            });
+        }
+    });
+}
+
+
+void build_distance_field(const VoxelWorld& world, DistanceField& field, int threads) {
+    compute_box(world, field, world.voxelOrigin(), world.voxelOrigin() + world.voxelDim() - 1, threads);
+}
+
+
+// Recomputes each box grown by DF_MAX, or the whole world when that adds up to more
+// than half of it. Returns the chunk indices written to, sorted.
+static std::vector<int> update_boxes(const VoxelWorld& world, DistanceField& field,
+                                     const std::vector<std::pair<glm::ivec3, glm::ivec3>>& boxes, int threads) {
+    // Boxes overlap, past a point redoing the whole world is cheaper
+    std::vector<std::pair<glm::ivec3, glm::ivec3>> grown;
+    size_t volume = 0;
+    for (const auto& box : boxes) {
+        glm::ivec3 lo = glm::max(box.first - DF_MAX, world.voxelOrigin());
+        glm::ivec3 hi = glm::min(box.second + DF_MAX, world.voxelOrigin() + world.voxelDim() - 1);
+        grown.emplace_back(lo, hi);
+        volume += (size_t)(hi.x - lo.x + 1) * (hi.y - lo.y + 1) * (hi.z - lo.z + 1);
+    }
+
+    std::vector<int> chunks;
+    if (volume >= field.dist.size() / 2) {
+        build_distance_field(world, field, threads);
+        chunks.resize(world.chunkCount());
+        std::iota(chunks.begin(), chunks.end(), 0);
+        return chunks;
+    }
+
+    for (const auto& box : grown) {
+        glm::ivec3 lo = box.first, hi = box.second;
+        compute_box(world, field, lo, hi, threads);
+
+        glm::ivec3 cLo(floor_div(lo.x, CHUNK_SIZE), floor_div(lo.y, CHUNK_SIZE), floor_div(lo.z, CHUNK_SIZE));
+        glm::ivec3 cHi(floor_div(hi.x, CHUNK_SIZE), floor_div(hi.y, CHUNK_SIZE), floor_div(hi.z, CHUNK_SIZE));
+        for (int z = cLo.z; z <= cHi.z; ++z)
+        for (int y = cLo.y; y <= cHi.y; ++y)
+        for (int x = cLo.x; x <= cHi.x; ++x)
+            chunks.push_back(world.chunkIndex(glm::ivec3(x, y, z)));
+    }
+
+    std::sort(chunks.begin(), chunks.end());
+    chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+    return chunks;
+}
+
+
+std::vector<int> update_distance_field(const VoxelWorld& world, DistanceField& field,
+                                       const std::vector<uint32_t>& dirtyVoxels, int threads) {
+    // One box per chunk with edits, so scattered edits don't turn into one huge box
+    std::map<int, std::pair<glm::ivec3, glm::ivec3>> boxes;
+    for (uint32_t idx : dirtyVoxels) {
+        glm::ivec3 p = world.indexToWorld((int)idx);
+        auto it = boxes.find(int(idx / CHUNK_VOXELS));
+        if (it == boxes.end()) boxes.emplace(int(idx / CHUNK_VOXELS), std::make_pair(p, p));
+        else it->second = std::make_pair(glm::min(it->second.first, p), glm::max(it->second.second, p));
+    }
+
+    std::vector<std::pair<glm::ivec3, glm::ivec3>> list;
+    for (const auto& box : boxes) list.push_back(box.second);
+    return update_boxes(world, field, list, threads);
+}
+
+
+std::vector<int> update_distance_field_chunks(const VoxelWorld& world, DistanceField& field,
+                                              const std::vector<int>& chunks, int threads) {
+    // Streamed chunks come as whole columns, in rows of columns : one box per column,
+    // then columns next to each other along z merged, so the DF_MAX margins aren't
+    // recomputed once per chunk
+    std::map<std::pair<int, int>, std::pair<int, int>> columns;    // (x, z) -> y range
+    for (int c : chunks) {
+        glm::ivec3 coord = world.slotChunk(c);
+        auto it = columns.find({coord.x, coord.z});
+        if (it == columns.end()) columns.emplace(std::make_pair(coord.x, coord.z), std::make_pair(coord.y, coord.y));
+        else it->second = std::make_pair(std::min(it->second.first, coord.y), std::max(it->second.second, coord.y));
+    }
+
+    std::vector<std::pair<glm::ivec3, glm::ivec3>> boxes;
+    glm::ivec3 lo(0), hi(-1);
+    for (const auto& column : columns) {
+        glm::ivec3 cLo(column.first.first, column.second.first, column.first.second);
+        glm::ivec3 cHi(column.first.first, column.second.second, column.first.second);
+        if (hi.x >= lo.x && cLo.x == lo.x && cLo.z == hi.z + 1 && cLo.y == lo.y && cHi.y == hi.y) {
+            hi.z = cHi.z;
+            continue;
+        }
+        if (hi.x >= lo.x) boxes.emplace_back(lo * CHUNK_SIZE, hi * CHUNK_SIZE + CHUNK_SIZE - 1);
+        lo = cLo;
+        hi = cHi;
+    }
+    if (hi.x >= lo.x) boxes.emplace_back(lo * CHUNK_SIZE, hi * CHUNK_SIZE + CHUNK_SIZE - 1);
+    return update_boxes(world, field, boxes, threads);
+}
@@ -0,0 +1,92 @@
+#version 430 core
+
+// Chebyshev distance field, same as distance_field.cpp : one byte per voxel, packed
+// 4 per uint in the voxel layout, 0 = solid, d = the cube of half size d - 1 around
+// the voxel is air, capped at DF_MAX. Three dispatches, one invocation per packed
+// uint (4 consecutive voxels of the buffer, wherever the layout puts them) :
+//   pass 0 : voxels      -> distField   window along x
+//   pass 1 : distField   -> dfScratch   window along y
+//   pass 2 : dfScratch   -> distField   window along z
+// each one being out(p) = min over |k| <= DF_MAX of max(|k|, in(p + k * axis)).
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+uniform ivec3 worldDim;
+uniform int chunkSize;
+uniform int dfPass;
+
+struct Voxel {
+    uint material;
+};
+
+layout(std430, binding = 0) buffer RawVoxelData {
+    Voxel voxels[];
+};
+
+layout(std430, binding = 5) buffer DistanceField {
+    uint distField[];
+};
+
+layout(std430, binding = 6) buffer DistanceScratch {
+    uint dfScratch[];
+};
+
+const int DF_MAX = 16;
+
+int floor_div(int a, int b) {
+    return (a >= 0 ? a / b : ((a - b + 1) / b));
+}
+
+#include "voxel_layout.glsl"
+
+// Same as shader.glsl, -1 outside of the world
+int worldToIndex3D(ivec3 pos) {
+    ivec3 chunkCoord = ivec3(
+        floor_div(pos.x, chunkSize),
+        floor_div(pos.y, chunkSize),
+        floor_div(pos.z, chunkSize)
+    );
+
+    if (any(lessThan(chunkCoord, ivec3(0))) || any(greaterThanEqual(chunkCoord, worldDim))) {
+        return -1;
+    }
+
+    ivec3 local = pos - chunkCoord * chunkSize;
+    int chunkIndex = chunkCoord.z * worldDim.y * worldDim.x + chunkCoord.y * worldDim.x + chunkCoord.x;
+    return chunkIndex * chunkSize * chunkSize * chunkSize + chunkLocalIndex(local);
+}
+
+// Input of the current pass at pos, DF_MAX outside of the world
+uint passInput(ivec3 pos) {
+    int idx = worldToIndex3D(pos);
+    if (idx < 0) return uint(DF_MAX);
+
+    if (dfPass == 0) return voxels[idx].material != 0u ? 0u : uint(DF_MAX);
+    uint packed = dfPass == 1 ? distField[idx >> 2] : dfScratch[idx >> 2];
+    return (packed >> (8 * (idx & 3))) & 0xFFu;
+}
+
+void main() {
+    // x = packed uint inside the chunk, y = chunk
+    int chunkVoxels = chunkSize * chunkSize * chunkSize;
+    int chunkIndex = int(gl_GlobalInvocationID.y);
+    int first = int(gl_GlobalInvocationID.x) * 4;
+    if (chunkIndex >= worldDim.x * worldDim.y * worldDim.z || first >= chunkVoxels)
+        return;
+
+    ivec3 chunkCoord = ivec3(chunkIndex % worldDim.x, (chunkIndex / worldDim.x) % worldDim.y, chunkIndex / (worldDim.x * worldDim.y));
+    ivec3 axis = dfPass == 0 ? ivec3(1, 0, 0) : (dfPass == 1 ? ivec3(0, 1, 0) : ivec3(0, 0, 1));
+
+    uint packed = 0u;
+    for (int i = 0; i < 4; ++i) {
+        ivec3 pos = chunkCoord * chunkSize + chunkLocalCoord(first + i);
+        uint d = uint(DF_MAX);
+        for (int k = -DF_MAX; k <= DF_MAX; ++k) {
+            d = min(d, max(uint(abs(k)), passInput(pos + k * axis)));
+        }
+        packed |= d << (8 * i);
+    }
+
+    int idx = chunkIndex * chunkVoxels + first;
+    if (dfPass == 1) dfScratch[idx >> 2] = packed;
+    else distField[idx >> 2] = packed;
+}
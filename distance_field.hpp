@@ -0,0 +1,41 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Chebyshev distance field for empty space skipping, CPU twin of distance_field.glsl.
+//
+// One byte per voxel, same chunked layout as the voxels (so the same worldToIndex3D
+// index), packed 4 per uint on the GPU. A value d means every voxel of the cube of
+// half size d - 1 around this one is air : 0 = solid, 1 = air next to something,
+// capped at DF_MAX. Outside of the world counts as air.
+//
+// Built with 3 separable passes (x, then y, then z), each one a windowed
+//     out(p) = min over |k| <= DF_MAX of max(|k|, in(p + k * axis))
+// starting from 0 on non-air voxels and DF_MAX on air. Exact for the L-inf norm.
+
+const int DF_MAX = 16;
+
+struct DistanceField {
+    glm::ivec3 dim;                 // in chunks, same as the VoxelWorld
+    std::vector<uint8_t> dist;      // one per voxel, chunked layout
+
+    explicit DistanceField(glm::ivec3 dim = WORLD_DIM);
+
+    uint8_t at(int voxelIndex) const { return dist[voxelIndex]; }
+};
+
+// Whole world, slices spread over `threads` workers (0 = all cores)
+void build_distance_field(const VoxelWorld& world, DistanceField& field, int threads = 0);
+
+// Recomputes what the dirty voxels (VoxelWorld::dirtyVoxels) can reach : for each
+// chunk with edits, the box around them grown by DF_MAX, or the whole world when
+// those boxes add up to more than half of it. Returns the chunk indices it wrote to, sorted.
+std::vector<int> update_distance_field(const VoxelWorld& world, DistanceField& field,
+                                       const std::vector<uint32_t>& dirtyVoxels, int threads = 0);
+
+// Same for whole chunks (by index) that were replaced, streamed in for instance
+std::vector<int> update_distance_field_chunks(const VoxelWorld& world, DistanceField& field,
+                                              const std::vector<int>& chunks, int threads = 0);
@@ -0,0 +1,58 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+float ResolutionScaler::update(double ms, float frameScale) {
+    if (targetMs <= 0.0 || ms <= 0.0) return scale;
+
+    float predicted = frameScale * (float)std::sqrt(targetMs / ms);
+    if (predicted < scale) scale = predicted;
+    else scale += (predicted - scale) * 0.25f;
+    scale = std::clamp(scale, minScale, maxScale);
+    return scale;
+}
+
+
+glm::ivec2 scaled_resolution(int width, int height, float scale) {
+    return glm::ivec2(std::max(1, (int)std::lround(width * scale)), std::max(1, (int)std::lround(height * scale)));
+}
+
+
+void upscale_image(const Image& src, Image& dst) {
+    if (src.width == dst.width && src.height == dst.height) {
+        dst.rgb = src.rgb;
+        return;
+    }
+
+    // Source coordinate and weight of every destination column / row
+    auto axis = [](int srcSize, int dstSize, std::vector<int>& i0, std::vector<float>& w) {
+        i0.resize(dstSize);
+        w.resize(dstSize);
+        for (int d = 0; d < dstSize; ++d) {
+            float s = std::clamp((d + 0.5f) * srcSize / dstSize - 0.5f, 0.0f, float(srcSize - 1));
+            i0[d] = std::min((int)s, std::max(srcSize - 2, 0));
+            w[d] = s - i0[d];
+        }
+    };
+    std::vector<int> x0, y0;
+    std::vector<float> wx, wy;
+    axis(src.width, dst.width, x0, wx);
+    axis(src.height, dst.height, y0, wy);
+
+    int xStep = src.width > 1 ? 3 : 0;
+    size_t yStep = src.height > 1 ? (size_t)src.width * 3 : 0;
+    for (int y = 0; y < dst.height; ++y) {
+        const uint8_t* row = &src.rgb[(size_t)y0[y] * src.width * 3];
+        uint8_t* out = &dst.rgb[(size_t)y * dst.width * 3];
+        for (int x = 0; x < dst.width; ++x) {
+            const uint8_t* p = row + x0[x] * 3;
+            for (int c = 0; c < 3; ++c) {
+                float top = p[c] + (p[c + xStep] - p[c]) * wx[x];
+                float bottom = p[c + yStep] + (p[c + yStep + xStep] - p[c + yStep]) * wx[x];
+                out[x * 3 + c] = (uint8_t)std::lround(top + (bottom - top) * wy[y]);
+            }
+        }
+    }
+}
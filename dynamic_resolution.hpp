@@ -0,0 +1,31 @@
+#pragma once
+
+#include "cpu_raymarch.hpp"
+
+#include <glm/glm.hpp>
+
+// Dynamic resolution : frames are raymarched at scale x the output size, the scale
+// following the measured frame time against a budget, then upscaled (upscale.glsl on
+// the GPU, upscale_image() here). The cost of a frame is about its pixel count, so
+// scale^2 x cost.
+struct ResolutionScaler {
+    double targetMs;            // budget for the raymarch pass
+    float minScale = 0.25f;
+    float maxScale = 1.0f;
+    float scale = 1.0f;         // for the next frame
+
+    explicit ResolutionScaler(double targetMs = 0.0, float scale = 1.0f) : targetMs(targetMs), scale(scale) {}
+
+    // Takes the time of a frame drawn at frameScale (GPU timings come back a few frames
+    // late, not necessarily at the current scale), returns the scale for the next ones.
+    // Over budget it drops straight to the predicted scale, under it climbs back slowly
+    // so it doesn't oscillate around the budget.
+    float update(double ms, float frameScale);
+};
+
+// Size of the raymarched frame, at least 1x1
+glm::ivec2 scaled_resolution(int width, int height, float scale);
+
+// Bilinear, pixel centers aligned and edges clamped, same filtering as upscale.glsl
+// without the temporal part. `dst` keeps its size.
+void upscale_image(const Image& src, Image& dst);
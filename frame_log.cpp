@@ -0,0 +1,166 @@
+#include "frame_log.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+
+void FrameLog::add(const Camera& cam, int renderDebug, Traversal traversal) {
+    FrameLogRecord r{};
+    r.pos[0] = cam.pos.x;
+    r.pos[1] = cam.pos.y;
+    r.pos[2] = cam.pos.z;
+    r.rot[0] = cam.rot.x;
+    r.rot[1] = cam.rot.y;
+    r.renderDebug = (uint8_t)renderDebug;
+    r.traversal = (uint8_t)traversal;
+    frames.push_back(r);
+}
+
+
+void FrameLog::addEdit(glm::ivec3 boxMin, glm::ivec3 boxMax, uint32_t material) {
+    if (frames.empty()) throw std::logic_error("Frame log edit before the first frame");
+    FrameLogEdit e{};
+    e.frame = uint32_t(frames.size() - 1);
+    for (int a = 0; a < 3; ++a) {
+        e.boxMin[a] = boxMin[a];
+        e.boxMax[a] = boxMax[a];
+    }
+    e.material = material;
+    edits.push_back(e);
+}
+
+
+size_t FrameLog::applyEdits(size_t frame, size_t& next, VoxelWorld& world) const {
+    size_t applied = 0;
+    for (; next < edits.size() && edits[next].frame <= frame; ++next) {
+        const FrameLogEdit& e = edits[next];
+        if (e.frame < frame) continue;
+        world.fillBox(glm::ivec3(e.boxMin[0], e.boxMin[1], e.boxMin[2]), glm::ivec3(e.boxMax[0], e.boxMax[1], e.boxMax[2]), e.material);
+        applied++;
+    }
+    return applied;
+}
+
+
+Camera FrameLog::camera(size_t frame, float fov) const {
+    const FrameLogRecord& r = frames.at(frame);
+    return Camera{glm::vec3(r.pos[0], r.pos[1], r.pos[2]), glm::vec2(r.rot[0], r.rot[1]), fov};
+}
+
+
+FrameLog load_frame_log(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Can't open frame log " + path);
+
+    FrameLogHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != FRAME_LOG_MAGIC)
+        throw std::runtime_error("Not a frame log : " + path);
+    if (header.version != 1 && header.version != FRAME_LOG_VERSION)
+        throw std::runtime_error("Frame log version " + std::to_string(header.version) + " not supported : " + path);
+
+    FrameLog log;
+    log.dt = header.dt;
+    log.worldDim = glm::ivec3(header.worldDim[0], header.worldDim[1], header.worldDim[2]);
+    log.frames.resize(header.frameCount);
+    if (!in.read(reinterpret_cast<char*>(log.frames.data()), log.frames.size() * sizeof(FrameLogRecord)))
+        throw std::runtime_error("Truncated frame log : " + path);
+    for (const FrameLogRecord& r : log.frames)
+        if (r.traversal >= TRAVERSAL_COUNT) throw std::runtime_error("Bad traversal in frame log : " + path);
+
+    log.edits.resize(header.version == 1 ? 0 : header.editCount);
+    if (!in.read(reinterpret_cast<char*>(log.edits.data()), log.edits.size() * sizeof(FrameLogEdit)))
+        throw std::runtime_error("Truncated frame log : " + path);
+    for (size_t i = 0; i < log.edits.size(); ++i)
+        if (log.edits[i].frame >= header.frameCount || (i > 0 && log.edits[i].frame < log.edits[i - 1].frame))
+            throw std::runtime_error("Bad edit frame in frame log : " + path);
+    return log;
+}
+
+
+void save_frame_log(const FrameLog& log, const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Can't write frame log " + path);
+
+    FrameLogHeader header{};
+    header.magic = FRAME_LOG_MAGIC;
+    header.version = FRAME_LOG_VERSION;
+    header.frameCount = (uint32_t)log.frames.size();
+    header.dt = log.dt;
+    header.worldDim[0] = log.worldDim.x;
+    header.worldDim[1] = log.worldDim.y;
+    header.worldDim[2] = log.worldDim.z;
+    header.editCount = (uint32_t)log.edits.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(log.frames.data()), log.frames.size() * sizeof(FrameLogRecord));
+    out.write(reinterpret_cast<const char*>(log.edits.data()), log.edits.size() * sizeof(FrameLogEdit));
+    if (!out) throw std::runtime_error("Can't write frame log " + path);
+}
+
+
+bool is_frame_log(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    uint32_t magic = 0;
+    return in.read(reinterpret_cast<char*>(&magic), sizeof(magic)) && magic == FRAME_LOG_MAGIC;
+}
+
+
+CameraPath frame_log_camera_path(const FrameLog& log) {
+    if (log.frames.empty()) throw std::runtime_error("Empty frame log");
+    CameraPath path;
+    for (size_t f = 0; f < log.frames.size(); ++f) {
+        Camera cam = log.camera(f);
+        path.keys.push_back(CameraKey{f * double(log.dt), cam.pos, cam.rot});
+    }
+    return path;
+}
+
+
+std::vector<uint64_t> load_frame_hashes(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Can't open frame hashes " + path);
+
+    std::vector<uint64_t> hashes;
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        size_t frame;
+        uint64_t hash;
+        if (!(fields >> frame >> std::hex >> hash) || frame != hashes.size())
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + " : expected \"frame hash\", frames in order");
+        hashes.push_back(hash);
+    }
+    return hashes;
+}
+
+
+void save_frame_hashes(const std::vector<uint64_t>& hashes, const std::string& path) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Can't write frame hashes " + path);
+    out << "# frame hash_image()\n";
+    for (size_t f = 0; f < hashes.size(); ++f)
+        out << f << " " << std::hex << std::setw(16) << std::setfill('0') << hashes[f] << std::dec << std::setfill(' ') << "\n";
+    if (!out) throw std::runtime_error("Can't write frame hashes " + path);
+}
+
+
+size_t check_frame_hashes(const std::vector<uint64_t>& hashes, const std::vector<uint64_t>& expected) {
+    size_t bad = 0;
+    for (size_t f = 0; f < std::max(hashes.size(), expected.size()); ++f) {
+        if (f < hashes.size() && f < expected.size() && hashes[f] == expected[f]) continue;
+        if (bad++ < 10) {
+            std::cout << "  frame " << f << " : ";
+            if (f >= hashes.size()) std::cout << "not rendered";
+            else if (f >= expected.size()) std::cout << "not in the reference";
+            else std::cout << std::hex << std::setfill('0') << std::setw(16) << hashes[f] << " instead of "
+                           << std::setw(16) << expected[f] << std::dec << std::setfill(' ');
+            std::cout << std::endl;
+        }
+    }
+    if (bad > 10) std::cout << "  ... " << bad - 10 << " more" << std::endl;
+    return bad;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "cpu_raymarch.hpp"
+#include "camera_path.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per frame log of what the windowed mode drew (.sdl), written by --record and played
+// back by --replay with a fixed timestep and no keyboard / mouse, so two runs draw the
+// exact same frames. Little endian :
+//
+//   FrameLogHeader                  32 bytes
+//   FrameLogRecord[frameCount]      24 bytes each
+//   FrameLogEdit[editCount]         32 bytes each, by frame (version 2, none in version 1)
+//
+// An edit (dig / place) is replayed as the box it filled rather than the click, right
+// after drawing its frame like in the recording, so the frames after it match too.
+//
+// Next to it, --hash-frames writes one hash_image() per replayed frame (text, "frame
+// hash" per line) and --check-hashes compares a replay against such a file.
+
+const uint32_t FRAME_LOG_MAGIC = 0x4c524453u;     // "SDRL"
+const uint32_t FRAME_LOG_VERSION = 2;
+
+struct FrameLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t frameCount;
+    float dt;               // replay timestep, the recording's average frame time
+    int32_t worldDim[3];    // of the recording, in chunks
+    uint32_t editCount;     // reserved (0) in version 1
+};
+
+struct FrameLogRecord {
+    float pos[3];
+    float rot[2];           // pitch, yaw
+    uint8_t renderDebug;
+    uint8_t traversal;      // Traversal
+    uint8_t reserved[2];
+};
+
+// VoxelWorld::fillBox(boxMin, boxMax, material) after drawing `frame`
+struct FrameLogEdit {
+    uint32_t frame;
+    int32_t boxMin[3];
+    int32_t boxMax[3];
+    uint32_t material;
+};
+
+static_assert(sizeof(FrameLogHeader) == 32, "frame log header layout");
+static_assert(sizeof(FrameLogRecord) == 24, "frame log record layout");
+static_assert(sizeof(FrameLogEdit) == 32, "frame log edit layout");
+
+
+struct FrameLog {
+    float dt = 1.0f / 60.0f;
+    glm::ivec3 worldDim{0};
+    std::vector<FrameLogRecord> frames;
+    std::vector<FrameLogEdit> edits;
+
+    void add(const Camera& cam, int renderDebug, Traversal traversal);
+    // Edit made after drawing the last added frame
+    void addEdit(glm::ivec3 boxMin, glm::ivec3 boxMax, uint32_t material);
+    Camera camera(size_t frame, float fov = 60.0f) const;
+
+    // Applies the edits of `frame` to the world (its dirty voxels tell what changed),
+    // `next` walks the edit list along the frames. Returns how many it applied.
+    size_t applyEdits(size_t frame, size_t& next, VoxelWorld& world) const;
+};
+
+// Throws std::runtime_error on a file that isn't a frame log
+FrameLog load_frame_log(const std::string& path);
+void save_frame_log(const FrameLog& log, const std::string& path);
+bool is_frame_log(const std::string& path);
+
+// One key per frame, dt apart, for --benchmark --path
+CameraPath frame_log_camera_path(const FrameLog& log);
+
+std::vector<uint64_t> load_frame_hashes(const std::string& path);
+void save_frame_hashes(const std::vector<uint64_t>& hashes, const std::string& path);
+
+// Prints the frames whose hash differs (or that are missing) from `expected`, returns how many
+size_t check_frame_hashes(const std::vector<uint64_t>& hashes, const std::vector<uint64_t>& expected);
@@ -0,0 +1,28 @@
+#version 430 core
+
+// First pass of the two-pass terrain generation : one invocation per (x,z) column
+// writes the fbm height, voxel.glsl then only compares against it.
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+uniform ivec3 worldDim;  // in chunks
+uniform int chunkSize;
+
+layout(std430, binding = 2) buffer HeightData {
+    float heights[];     // (worldDim.x * chunkSize) x (worldDim.z * chunkSize), x fastest
+};
+
+#include "noise.glsl"
+
+void main() {
+    ivec2 column = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = worldDim.xz * chunkSize;
+    if (any(greaterThanEqual(column, size)))
+        return;
+
+    float nx = float(column.x) / scale;
+    float nz = float(column.y) / scale;
+
+    float elevation = fbm(vec2(nx, nz));
+    heights[column.y * size.x + column.x] = elevation * terrainHeightScale + terrainBaseHeight;
+}
@@ -0,0 +1,164 @@
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+// Index of the worker the current thread is, -1 for any other thread
+static thread_local int currentWorker = -1;
+static thread_local const JobSystem* currentSystem = nullptr;
+
+
+JobSystem::JobSystem(int threads) {
+    if (threads <= 0) threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    for (int i = 0; i < threads; ++i) workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < threads; ++i) workers[i]->thread = std::thread([this, i]() { workerLoop(i); });
+}
+
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers) w->thread.join();
+}
+
+
+void JobSystem::submit(JobPriority priority, Job job) {
+    if (currentSystem == this && currentWorker >= 0) {
+        Worker& w = *workers[currentWorker];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.queues[priority].push_back(std::move(job));
+    } else {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        inject[priority].push_back(std::move(job));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+
+bool JobSystem::takeJob(int self, Job& job) {
+    for (int p = 0; p < JOB_PRIORITIES; ++p) {
+        {
+            Worker& w = *workers[self];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (!w.queues[p].empty()) {
+                job = std::move(w.queues[p].back());
+                w.queues[p].pop_back();
+                return true;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(injectMutex);
+            if (!inject[p].empty()) {
+                job = std::move(inject[p].front());
+                inject[p].pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < workers.size(); ++k) {
+            Worker& victim = *workers[(self + k) % workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.queues[p].empty()) {
+                job = std::move(victim.queues[p].front());
+                victim.queues[p].pop_front();
+                stolen++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+void JobSystem::workerLoop(int self) {
+    currentWorker = self;
+    currentSystem = this;
+    PROFILE_THREAD_NAME("worker " + std::to_string(self));
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [&]() { return quit || queued > 0; });
+            if (quit) return;
+            // Claimed before looking, so two workers don't both go after the last job
+            queued--;
+            running++;
+        }
+
+        // The claimed job is somewhere, a submit() may just not have pushed it where we looked yet
+        Job job;
+        while (!takeJob(self, job)) std::this_thread::yield();
+
+        std::exception_ptr failure;
+        try {
+            job();
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        job = nullptr;
+        executed++;
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running--;
+            if (failure && !error) error = failure;
+            if (queued == 0 && running == 0) idle.notify_all();
+        }
+    }
+}
+
+
+void JobSystem::waitIdle() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    idle.wait(lock, [&]() { return queued == 0 && running == 0; });
+    if (error) {
+        std::exception_ptr failure = error;
+        error = nullptr;
+        std::rethrow_exception(failure);
+    }
+}
+
+
+void FrameBudgetQueue::push(int kind, std::function<void()> task) {
+    tasks.push_back(Task{kind, std::move(task)});
+}
+
+
+double FrameBudgetQueue::expectedMs(int kind) const {
+    return kind < (int)costs.size() && costs[kind] >= 0.0 ? costs[kind] : 0.0;
+}
+
+
+double FrameBudgetQueue::run() {
+    auto start = std::chrono::steady_clock::now();
+    double spent = 0.0;
+    bool first = true;
+
+    while (!tasks.empty()) {
+        Task& task = tasks.front();
+        if (!first && spent + expectedMs(task.kind) > budgetMs) break;
+        first = false;
+
+        auto taskStart = std::chrono::steady_clock::now();
+        std::function<void()> fn = std::move(task.fn);
+        int kind = task.kind;
+        tasks.pop_front();
+        fn();
+        auto now = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(now - taskStart).count();
+        if (kind >= (int)costs.size()) costs.resize(kind + 1, -1.0);
+        costs[kind] = costs[kind] < 0.0 ? ms : costs[kind] * 0.8 + ms * 0.2;
+        spent = std::chrono::duration<double, std::milli>(now - start).count();
+    }
+    return spent;
+}
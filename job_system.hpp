@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Background jobs (chunk generation, decompression, octree builds, compression...) on
+// a fixed set of worker threads, for work that mustn't block a frame. parallel_for
+// stays the tool for one big loop that the caller waits on.
+//
+// Work stealing : every worker has its own deques, one per priority. Jobs submitted
+// from a worker (follow-up work, like the octree build after a chunk is generated) go
+// to that worker's deque and are popped LIFO, while it's hot in cache. Jobs from
+// other threads go to a shared injection queue, FIFO, so the submission order is kept.
+// An idle worker takes, for each priority from the highest : its own deque, then the
+// injection queue, then the oldest job of another worker.
+
+enum JobPriority {
+    JOB_HIGH = 0,       // finishes work already started (octree of a loaded chunk)
+    JOB_NORMAL = 1,     // new work the frame is waiting on (generate, decompress)
+    JOB_LOW = 2,        // nobody waits on it (compressing chunks that left)
+};
+const int JOB_PRIORITIES = 3;
+
+using Job = std::function<void()>;
+
+struct JobStats {
+    size_t executed = 0;
+    size_t stolen = 0;      // taken from another worker's deque
+};
+
+
+class JobSystem {
+public:
+    // `threads` workers, 0 = all cores but one (the main thread has frames to draw), at least one
+    explicit JobSystem(int threads = 0);
+    // Queued jobs that haven't started are dropped, running ones are waited for
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(JobPriority priority, Job job);
+
+    // Blocks until nothing is queued or running. Rethrows the first exception a job
+    // let out since the last call (jobs should handle their own, this is a last resort).
+    void waitIdle();
+
+    int threadCount() const { return (int)workers.size(); }
+    JobStats stats() const { return JobStats{executed.load(), stolen.load()}; }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Job> queues[JOB_PRIORITIES];
+        std::thread thread;
+    };
+
+    bool takeJob(int self, Job& job);
+    void workerLoop(int self);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex injectMutex;
+    std::deque<Job> inject[JOB_PRIORITIES];
+
+    std::mutex sleepMutex;
+    std::condition_variable wake, idle;
+    int queued = 0;         // submitted, not taken yet (sleepMutex)
+    int running = 0;        // (sleepMutex)
+    bool quit = false;
+    std::exception_ptr error;
+
+    std::atomic<size_t> executed{0}, stolen{0};
+};
+
+
+// Main thread work spread over frames (uploads, the distance field around streamed
+// chunks...) so a burst of it never pushes a frame past the budget. run() executes
+// tasks in order while the time already spent plus the expected cost of the next task
+// fits in budgetMs. Expected costs are a running average per task kind. The first task
+// of a frame always runs, so one task bigger than the budget can't block the queue.
+class FrameBudgetQueue {
+public:
+    explicit FrameBudgetQueue(double budgetMs) : budgetMs(budgetMs) {}
+
+    double budgetMs;
+
+    void push(int kind, std::function<void()> task);
+
+    // Returns the ms spent
+    double run();
+
+    size_t size() const { return tasks.size(); }
+    bool empty() const { return tasks.empty(); }
+    double expectedMs(int kind) const;
+
+private:
+    struct Task {
+        int kind;
+        std::function<void()> fn;
+    };
+    std::deque<Task> tasks;
+    std::vector<double> costs;      // per kind, < 0 until the first run
+};
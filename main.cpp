@@ -7,18 +7,33 @@
 #include <sstream>
 #include <vector>
 #include <random>
+#include <chrono>
+#include <memory>
+
+#include "world.hpp"
+#include "cpu_raymarch.hpp"
+#include "benchmarks.hpp"
+#include "worldgen.hpp"
+#include "octree.hpp"
+#include "distance_field.hpp"
+#include "chunk_loader.hpp"
+#include "world_archive.hpp"
+#include "packed_world.hpp"
+#include "streaming.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include "camera_path.hpp"
+#include "frame_log.hpp"
+#include "program_cache.hpp"
+#include "shader_watch.hpp"
+#include "dynamic_resolution.hpp"
+#include "reprojection.hpp"
+#include "cone_prepass.hpp"
 
 // Screen size
 const int WIDTH = 1280, HEIGHT = 720;
 // const int WIDTH = 1024, HEIGHT = 1080; // Cool dimension to use to display the world
 
-const int CHUNK_SIZE = 32;
-const glm::ivec3 WORLD_DIM = glm::ivec3(16, 2, 16);  // Wx, Wy, Wz
-
-const size_t CHUNK_VOXELS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
-const size_t TOTAL_CHUNKS = WORLD_DIM.x * WORLD_DIM.y * WORLD_DIM.z;
-const size_t TOTAL_VOXELS = TOTAL_CHUNKS * CHUNK_VOXELS;
-
 
 
 // Setup random number generator
@@ -37,79 +52,399 @@ std::string load_file(const char* path) {
     return ss.str();
 }
 
-GLuint compile_shader(const char* src, GLenum type) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &src, NULL);
-    glCompileShader(shader);
-    char log[512];
-    glGetShaderInfoLog(shader, 512, NULL, log);
-    std::cerr << log << std::endl;
-    return shader;
+// Shader file with `#include "name.glsl"` lines replaced by that file (same directory),
+// and the voxel layout defines voxel_layout.glsl expects right after #version
+std::string load_shader_source(const std::string& path, bool defines = true) {
+    std::ifstream in(path);
+    if (!in.is_open()) throw std::runtime_error("Failed to open shader file: " + path);
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+
+    std::stringstream out;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.rfind("#include \"", 0) == 0) {
+            size_t end = line.find('"', 10);
+            if (end == std::string::npos) throw std::runtime_error("Bad #include in " + path + " : " + line);
+            out << load_shader_source(directory + line.substr(10, end - 10), false) << "\n";
+            continue;
+        }
+        out << line << "\n";
+        if (defines && line.rfind("#version", 0) == 0) {
+            out << "#define VOXEL_LAYOUT " << (int)VOXEL_LAYOUT << "\n"
+                << "#define VOXEL_CHUNK_SHIFT " << CHUNK_SHIFT << "\n"
+                << "#define VOXEL_BRICK_SHIFT " << VOXEL_BRICK_SHIFT << "\n";
+        }
+    }
+    return out.str();
+}
+
+// Every program goes through it, --shader-cache / --no-shader-cache set the directory
+ProgramCache programCache("shader_cache");
+
+// Where the .glsl files are read from (and watched), --shader-dir
+std::string shaderDir = "shaders/";
+
+std::string shader_path(const std::string& name) {
+    return shaderDir + name;
+}
+
+GLuint compileComputeShader(const std::string& name) {
+    return programCache.get(name, {{GL_COMPUTE_SHADER, load_shader_source(shader_path(name))}});
+}
+
+ShaderStages display_shader_stages() {
+    return {{GL_VERTEX_SHADER, load_file(shader_path("vertex.glsl").c_str())},
+            {GL_FRAGMENT_SHADER, load_shader_source(shader_path("shader.glsl"))}};
+}
+
+ShaderStages upscale_shader_stages() {
+    return {{GL_VERTEX_SHADER, load_file(shader_path("vertex.glsl").c_str())},
+            {GL_FRAGMENT_SHADER, load_shader_source(shader_path("upscale.glsl"))}};
+}
+
+// GPU time of whatever fn submits, in ms. Waits for the result, so keep it out of the frame loop
+template <typename Fn>
+double gpu_time_ms(Fn fn) {
+    GLuint query;
+    glGenQueries(1, &query);
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    fn();
+    glEndQuery(GL_TIME_ELAPSED);
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    glDeleteQueries(1, &query);
+    return double(ns) / 1e6;
+}
+
+// GPU time of a span of commands without waiting for it, for the frame loop : a pair of
+// GL_TIMESTAMP queries per frame in a ring, read back RING frames later. Timestamps, not
+// GL_TIME_ELAPSED, so it works inside a PROFILE_GPU_SCOPE.
+struct GpuFrameTimer {
+    static const int RING = 4;
+    GLuint queries[RING][2] = {};
+    float tags[RING] = {};      // what the caller wants back with the time (the render scale)
+    int frame = 0;
+    bool ready = false;
+    double lastMs = 0.0;
+    float lastTag = 0.0f;
+
+    void begin(float tag) {
+        if (!queries[0][0]) glGenQueries(2 * RING, &queries[0][0]);
+        int slot = frame % RING;
+        if (frame >= RING) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 start = 0, end = 0;
+                glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &start);
+                glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+                lastMs = double(end - start) / 1e6;
+                lastTag = tags[slot];
+                ready = true;
+            }
+        }
+        tags[slot] = tag;
+        glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+    }
+    void end() {
+        glQueryCounter(queries[frame % RING][1], GL_TIMESTAMP);
+        frame++;
+    }
+    // A span finished since the last call : its time and tag
+    bool result(double& ms, float& tag) {
+        if (!ready) return false;
+        ready = false;
+        ms = lastMs;
+        tag = lastTag;
+        return true;
+    }
+};
+
+
+// --scale / --target-ms / --reproject in the window : shader.glsl draws into the
+// bottom-left corner of full size targets (color and the G-buffer : hit distance, and the
+// hit voxel with --reproject), upscale.glsl stretches that over the screen. With
+// --temporal it draws into one of two history targets instead, blending in the other one
+// (last frame), then that is blitted to the screen.
+struct SceneTargets {
+    int width = 0, height = 0;
+    GLuint sceneFbo = 0, colorTex = 0, depthTex = 0;
+    GLuint historyFbo[2] = {}, historyTex[2] = {};
+    int history = 0;            // written this frame
+    bool historyValid = false;
+    GLuint voxelTex = 0, tStartTex = 0;     // --reproject
+    bool hitsValid = false;     // the G-buffer holds last frame's hits of the current world
+};
+
+SceneTargets create_scene_targets(int width, int height, bool temporal, bool reproject) {
+    auto texture = [&](GLenum format) {
+        // Integer textures are incomplete with linear filtering
+        bool integer = format == GL_RGBA32I || format == GL_R32UI;
+        GLuint tex;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, integer ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, integer ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return tex;
+    };
+    auto framebuffer = [&](std::vector<GLuint> textures) {
+        GLuint fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        std::vector<GLenum> attachments;
+        for (GLuint tex : textures) {
+            attachments.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)attachments.size());
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachments.back(), GL_TEXTURE_2D, tex, 0);
+        }
+        glDrawBuffers((GLsizei)attachments.size(), attachments.data());
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            throw std::runtime_error("Incomplete dynamic resolution framebuffer");
+        return fbo;
+    };
+
+    SceneTargets targets;
+    targets.width = width;
+    targets.height = height;
+    targets.colorTex = texture(GL_RGBA8);
+    targets.depthTex = texture(GL_R32F);
+    if (reproject) {
+        targets.voxelTex = texture(GL_RGBA32I);
+        targets.tStartTex = texture(GL_R32UI);
+        targets.sceneFbo = framebuffer({targets.colorTex, targets.depthTex, targets.voxelTex});
+    } else {
+        targets.sceneFbo = framebuffer({targets.colorTex, targets.depthTex});
+    }
+    if (temporal) {
+        for (int i = 0; i < 2; ++i) {
+            targets.historyTex[i] = texture(GL_RGBA8);
+            targets.historyFbo[i] = framebuffer({targets.historyTex[i]});
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return targets;
+}
+
+// Sub-pixel offset of a frame for the temporal upscale, Halton (2, 3) over 8 frames, in [-0.5, 0.5)
+glm::vec2 temporal_jitter(int frame) {
+    auto halton = [](int i, int base) {
+        float f = 1.0f, r = 0.0f;
+        for (i += 1; i > 0; i /= base) {
+            f /= base;
+            r += f * (i % base);
+        }
+        return r;
+    };
+    return glm::vec2(halton(frame % 8, 2), halton(frame % 8, 3)) - 0.5f;
 }
 
+// --reproject, before the frame is drawn : clears targets.tStartTex and splats last
+// frame's hits (prevSize pixels of the G-buffer) into it with reproject.glsl, for
+// shader.glsl drawing renderSize pixels from cam
+void reproject_gpu(GLuint program, const SceneTargets& targets, glm::ivec2 prevSize, glm::ivec2 renderSize, const Camera& cam) {
+    GLuint nothing = 0xffffffffu;
+    glClearTexImage(targets.tStartTex, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &nothing);
+    if (!targets.hitsValid) return;
+
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, targets.depthTex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, targets.voxelTex);
+    glActiveTexture(GL_TEXTURE0);
+    glBindImageTexture(0, targets.tStartTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    glUniform2i(glGetUniformLocation(program, "prevSize"), prevSize.x, prevSize.y);
+    glUniform2f(glGetUniformLocation(program, "resolution"), (float)renderSize.x, (float)renderSize.y);
+    glUniform3f(glGetUniformLocation(program, "camPos"), cam.pos.x, cam.pos.y, cam.pos.z);
+    glUniform3f(glGetUniformLocation(program, "camRot"), cam.rot.x, cam.rot.y, 0.0f);
+    glUniform1f(glGetUniformLocation(program, "FOV"), cam.fov);
+    glUniform1i(glGetUniformLocation(program, "maxRadius"), REPROJECT_MAX_RADIUS);
+    glDispatchCompute((prevSize.x + 7) / 8, (prevSize.y + 7) / 8, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
 
-GLuint compileComputeShader(const std::string& filename) {
-    // === Read shader source from file ===
-    std::ifstream in(filename);
-    if (!in.is_open()) {
-        throw std::runtime_error("Failed to open compute shader file: " + filename);
-    }
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    std::string sourceStr = buffer.str();
-    const char* source = sourceStr.c_str();
-
-    // === Create and compile shader ===
-    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
-
-    // === Check compile errors ===
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        GLint logLength;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-        std::vector<char> infoLog(logLength);
-        glGetShaderInfoLog(shader, logLength, nullptr, infoLog.data());
-        std::cerr << "Compute Shader compilation failed:\n" << infoLog.data() << std::endl;
-        throw std::runtime_error("Compute Shader compilation failed.");
-    }
-
-    // === Create program and link ===
-    GLuint program = glCreateProgram();
-    glAttachShader(program, shader);
-    glLinkProgram(program);
-
-    // === Check linking errors ===
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        GLint logLength;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-        std::vector<char> infoLog(logLength);
-        glGetProgramInfoLog(program, logLength, nullptr, infoLog.data());
-        std::cerr << "Compute Shader linking failed:\n" << infoLog.data() << std::endl;
-        throw std::runtime_error("Compute Shader linking failed.");
-    }
-
-    // === Clean up ===
-    glDeleteShader(shader);
-
-    return program;
+// --cone : the tiles of a renderSize frame from cam with cone.glsl into coneTex (one
+// texel per CONE_TILE x CONE_TILE pixels), through the distance field whatever the rays use
+void cone_prepass_gpu(GLuint program, GLuint coneTex, glm::ivec2 renderSize, const Camera& cam,
+                      const VoxelWorld& world, bool packed) {
+    glm::ivec2 tiles = (renderSize + (CONE_TILE - 1)) / CONE_TILE;
+    glUseProgram(program);
+    glBindImageTexture(1, coneTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glUniform2f(glGetUniformLocation(program, "resolution"), (float)renderSize.x, (float)renderSize.y);
+    glUniform3f(glGetUniformLocation(program, "camPos"), cam.pos.x, cam.pos.y, cam.pos.z);
+    glUniform3f(glGetUniformLocation(program, "camRot"), cam.rot.x, cam.rot.y, 0.0f);
+    glUniform1f(glGetUniformLocation(program, "FOV"), cam.fov);
+    glUniform1i(glGetUniformLocation(program, "chunkSize"), CHUNK_SIZE);
+    glUniform3i(glGetUniformLocation(program, "worldDim"), world.dim.x, world.dim.y, world.dim.z);
+    glUniform3i(glGetUniformLocation(program, "worldOrigin"), world.origin.x, world.origin.y, world.origin.z);
+    glUniform3i(glGetUniformLocation(program, "worldOriginSlot"), world.originSlot.x, world.originSlot.y, world.originSlot.z);
+    glUniform1i(glGetUniformLocation(program, "traversalMode"), (int)Traversal::Distance);
+    glUniform1i(glGetUniformLocation(program, "voxelFormat"), packed ? 1 : 0);
+    glDispatchCompute((tiles.x + 7) / 8, (tiles.y + 7) / 8, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
 }
 
+// --compute : raymarch_compute.glsl (bound, its uniforms set) into the color and G-buffer
+// textures of targets. `groups` persistent 8x8 groups share the tiles through tileQueue.
+void raymarch_compute_gpu(GLuint program, const SceneTargets& targets, GLuint tileQueue, int groups) {
+    GLuint zero = 0;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, tileQueue);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindImageTexture(2, targets.colorTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    glBindImageTexture(3, targets.depthTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    if (targets.voxelTex) glBindImageTexture(4, targets.voxelTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32I);
+    glUniform1i(glGetUniformLocation(program, "writeVoxels"), targets.voxelTex ? 1 : 0);
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
 
+// upscale.glsl from targets.colorTex onto the bound framebuffer (or the next history
+// target with --temporal, then blitted), the previous camera for the reprojection
+void upscale_frame(GLuint program, SceneTargets& targets, glm::ivec2 renderSize, glm::vec2 jitter,
+                   const Camera& cam, const Camera& prevCam) {
+    bool temporal = targets.historyFbo[0] != 0;
+    int next = 1 - targets.history;
+    glBindFramebuffer(GL_FRAMEBUFFER, temporal ? targets.historyFbo[next] : 0);
+    glViewport(0, 0, targets.width, targets.height);
+
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, targets.colorTex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, targets.depthTex);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, temporal ? targets.historyTex[targets.history] : 0);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "colorTex"), 0);
+    glUniform1i(glGetUniformLocation(program, "depthTex"), 1);
+    glUniform1i(glGetUniformLocation(program, "historyTex"), 2);
+    glUniform2f(glGetUniformLocation(program, "renderSize"), (float)renderSize.x, (float)renderSize.y);
+    glUniform2f(glGetUniformLocation(program, "outputSize"), (float)targets.width, (float)targets.height);
+    glUniform2f(glGetUniformLocation(program, "jitter"), jitter.x, jitter.y);
+    glUniform1i(glGetUniformLocation(program, "temporal"), temporal ? 1 : 0);
+    glUniform1f(glGetUniformLocation(program, "historyWeight"), targets.historyValid ? 0.9f : 0.0f);
+    glUniform3f(glGetUniformLocation(program, "camPos"), cam.pos.x, cam.pos.y, cam.pos.z);
+    glUniform3f(glGetUniformLocation(program, "camRot"), cam.rot.x, cam.rot.y, 0.0f);
+    glUniform3f(glGetUniformLocation(program, "prevCamPos"), prevCam.pos.x, prevCam.pos.y, prevCam.pos.z);
+    glUniform3f(glGetUniformLocation(program, "prevCamRot"), prevCam.rot.x, prevCam.rot.y, 0.0f);
+    glUniform1f(glGetUniformLocation(program, "FOV"), cam.fov);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    if (temporal) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, targets.historyFbo[next]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, targets.width, targets.height, 0, 0, targets.width, targets.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        targets.history = next;
+        targets.historyValid = true;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-GLuint create_program(const char* vsrc, const char* fsrc) {
-    GLuint vert = compile_shader(vsrc, GL_VERTEX_SHADER);
-    GLuint frag = compile_shader(fsrc, GL_FRAGMENT_SHADER);
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, vert);
-    glAttachShader(prog, frag);
-    glLinkProgram(prog);
-    glDeleteShader(vert);
-    glDeleteShader(frag);
-    return prog;
+// Whole world octree with build_octree.glsl : leaves, levels 4..0 bottom-up, then the
+// sparse emission. Voxels at binding 0, octree at 1 and its slot offsets at 11 (the
+// slots must already fit the nodes). The dense pyramid scratch (binding 3) is as big as
+// the old dense octree, so it only exists for the build.
+void build_octree_gpu(GLuint program, glm::ivec3 worldDim) {
+    PROFILE_SCOPE("octree dispatches");
+    GLuint chunks = (GLuint)worldDim.x * worldDim.y * worldDim.z;
+    GLuint pyramid;
+    glGenBuffers(1, &pyramid);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pyramid);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, chunks * OCTREE_NODES_PER_CHUNK * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, pyramid);
+
+    glUseProgram(program);
+    glUniform3i(glGetUniformLocation(program, "worldDim"), worldDim.x, worldDim.y, worldDim.z);
+    glUniform1i(glGetUniformLocation(program, "chunkSize"), CHUNK_SIZE);
+    GLint passLoc = glGetUniformLocation(program, "buildPass");
+    GLint levelLoc = glGetUniformLocation(program, "buildLevel");
+
+    glUniform1i(passLoc, 0);
+    glDispatchCompute((CHUNK_VOXELS + 63) / 64, chunks, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUniform1i(passLoc, 1);
+    for (int level = OCTREE_LEVELS - 1; level >= 0; --level) {
+        glUniform1i(levelLoc, level);
+        glDispatchCompute(((1u << (3 * level)) + 63) / 64, chunks, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    glUniform1i(passLoc, 2);
+    glDispatchCompute((chunks + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Freed once the dispatches above are done with it
+    glDeleteBuffers(1, &pyramid);
+}
+
+// Distance field with distance_field.glsl : windowed passes along x, y then z, one
+// invocation per 4 voxels. Voxels at binding 0, field at 5, scratch at 6.
+void build_distance_field_gpu(GLuint program, glm::ivec3 worldDim) {
+    PROFILE_SCOPE("distance dispatches");
+    GLuint chunks = (GLuint)worldDim.x * worldDim.y * worldDim.z;
+    glUseProgram(program);
+    glUniform3i(glGetUniformLocation(program, "worldDim"), worldDim.x, worldDim.y, worldDim.z);
+    glUniform1i(glGetUniformLocation(program, "chunkSize"), CHUNK_SIZE);
+    GLint passLoc = glGetUniformLocation(program, "dfPass");
+
+    for (int pass = 0; pass < 3; ++pass) {
+        glUniform1i(passLoc, pass);
+        glDispatchCompute((CHUNK_VOXELS / 4 + 63) / 64, chunks, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+// Streams chunks into voxelSSBO. loadRange(begin, end, out) decodes chunks [begin, end)
+// straight into a persistently mapped staging buffer, one half of it per batch, and
+// returns the file bytes it read. Each batch is a single glCopyBufferSubData (chunks
+// are contiguous in the SSBO), a fence per half keeps the CPU from overwriting what
+// the GPU hasn't copied yet.
+template <typename LoadRangeFn>
+LoadStats upload_chunks_gpu(GLuint voxelSSBO, glm::ivec3 worldDim, LoadRangeFn loadRange) {
+    const int batchChunks = 32;     // 4 MiB per half
+    const size_t batchBytes = batchChunks * CHUNK_VOXELS * sizeof(Voxel);
+    const int chunkCount = worldDim.x * worldDim.y * worldDim.z;
+    auto start = std::chrono::steady_clock::now();
+
+    GLuint staging;
+    glGenBuffers(1, &staging);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_COPY_READ_BUFFER, 2 * batchBytes, nullptr, flags);
+    Voxel* mapped = static_cast<Voxel*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, 2 * batchBytes, flags));
+    if (!mapped) throw std::runtime_error("Failed to map the chunk staging buffer");
+    glBindBuffer(GL_COPY_WRITE_BUFFER, voxelSSBO);
+
+    GLsync fences[2] = {nullptr, nullptr};
+    auto wait = [&](int half) {
+        if (!fences[half]) return;
+        while (glClientWaitSync(fences[half], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fences[half]);
+        fences[half] = nullptr;
+    };
+
+    LoadStats stats;
+    for (int first = 0, half = 0; first < chunkCount; first += batchChunks, half ^= 1) {
+        int last = std::min(first + batchChunks, chunkCount);
+        wait(half);
+        stats.fileBytes += loadRange(first, last, mapped + (size_t)half * batchChunks * CHUNK_VOXELS);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, half * batchBytes,
+                            (size_t)first * CHUNK_VOXELS * sizeof(Voxel), (size_t)(last - first) * CHUNK_VOXELS * sizeof(Voxel));
+        fences[half] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    wait(0);
+    wait(1);
+
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glDeleteBuffers(1, &staging);
+
+    stats.chunks = chunkCount;
+    stats.bytes = (size_t)chunkCount * CHUNK_VOXELS * sizeof(Voxel);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
 }
 
 float quad[] = {
@@ -121,45 +456,791 @@ float cam_speed = 8.0f;
 float mouse_sensitivity = 0.003f;
 
 // ================== Voxel struct and values ============
-struct Voxel {
-    uint32_t material;
+// Voxel, VoxelWorld and the world constants live in world.hpp
+
+
+// Chunk files and archives : chunk_loader.hpp / world_archive.hpp, upload_chunks_gpu() above
+
+// ================== ! Voxel struct and values ============
+
+
+
+
+// Frame time line, printed this often (profiler.hpp has the per stage numbers)
+const double FRAME_REPORT_SECONDS = 1.0;
+
+
+// ================== CPU reference rendering ============
+// Host world for the headless modes : a world archive or chunk files when given,
+// otherwise the voxel.glsl terrain generated on the CPU
+VoxelWorld make_host_world(const std::string& archivePath, const std::string& chunkDir, glm::ivec3 worldDim, int threads) {
+    VoxelWorld world(worldDim);
+    if (!archivePath.empty() || !chunkDir.empty()) {
+        LoadStats stats = !archivePath.empty() ? load_world_archive(world, archivePath, threads)
+                                               : load_chunk_directory_parallel(world, chunkDir, threads);
+        std::cout << "Loaded " << world.dim.x << "x" << world.dim.y << "x" << world.dim.z << " chunks in "
+                  << stats.seconds * 1000.0 << " ms, " << stats.mbPerSec() << " MB/s, "
+                  << stats.chunksPerSec() << " chunks/s" << std::endl;
+        return world;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    generate_world(world, threads);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Generated " << worldDim.x << "x" << worldDim.y << "x" << worldDim.z
+              << " chunks in " << ms << " ms" << std::endl;
+    return world;
+}
+
+
+// Renders one frame with the CPU raymarcher, no window nor GL context needed
+int run_headless(const std::string& outputPath, const VoxelWorld& world, const Camera& cam, int width, int height,
+                 float scale, int renderDebug, int threads, bool packet, Traversal traversal, bool packedVoxels) {
+
+    SceneAccel accel;
+    Scene scene = accel.prepare(world, traversal, threads, packedVoxels);
+
+    // --scale : raymarched smaller, then upscaled to the asked size like the window does
+    glm::ivec2 size = scaled_resolution(width, height, scale);
+    Image image, output;
+    image.resize(size.x, size.y);
+    output.resize(width, height);
+    RenderStats stats;
+    if (packet) render_cpu_packet(world, cam, image, renderDebug, &stats, threads);
+    else render_cpu(scene, cam, image, renderDebug, &stats, threads);
+    upscale_image(image, output);
+    write_ppm(outputPath, output);
+
+    std::cout << "CPU frame " << size.x << "x" << size.y;
+    if (size != glm::ivec2(width, height)) std::cout << " upscaled to " << width << "x" << height;
+    std::cout << " in " << stats.seconds * 1000.0 << " ms, "
+              << stats.raysPerSecond() / 1e6 << " Mrays/s, avg steps " << stats.avgSteps()
+              << " => " << outputPath << std::endl;
+    return 0;
+}
+
+
+// --hash-frames / --check-hashes after a replay, returns the exit code
+int finish_frame_hashes(const std::vector<uint64_t>& hashes, const std::string& outPath, const std::string& checkPath) {
+    if (!outPath.empty()) {
+        save_frame_hashes(hashes, outPath);
+        std::cout << "Frame hashes => " << outPath << std::endl;
+    }
+    if (checkPath.empty()) return 0;
+
+    size_t bad = check_frame_hashes(hashes, load_frame_hashes(checkPath));
+    std::cout << (bad == 0 ? "All " + std::to_string(hashes.size()) + " frames match " : std::to_string(bad) + " frame(s) differ from ")
+              << checkPath << std::endl;
+    return bad == 0 ? 0 : 1;
+}
+
+
+// --replay with --cpu : every frame of the log on the CPU raymarcher, hashed. The
+// structures of every traversal are built up front, the log can switch between them,
+// and brought up to date after the frames that had edits.
+int run_replay_cpu(const FrameLog& log, VoxelWorld& world, int width, int height, int threads, bool packet,
+                   bool packedVoxels, const std::string& hashesOut, const std::string& hashesCheck) {
+    OctreeWorld octree(world.dim);
+    build_octree(world, octree, threads);
+    std::vector<uint32_t> occupancy;
+    build_occupancy(world, occupancy, threads);
+    DistanceField distance(world.dim);
+    build_distance_field(world, distance, threads);
+    PackedVoxels packed(world.dim);
+    if (packedVoxels) pack_world(world, packed);
+
+    Scene scene(world);
+    scene.octree = &octree;
+    scene.occupancy = &occupancy;
+    scene.distance = &distance;
+    if (packedVoxels) scene.packed = &packed;
+
+    Image image;
+    image.resize(width, height);
+    std::vector<uint64_t> hashes;
+    std::vector<double> ms;
+    size_t nextEdit = 0;
+    for (size_t f = 0; f < log.frames.size(); ++f) {
+        const FrameLogRecord& r = log.frames[f];
+        RenderStats stats;
+        if (packet) {
+            render_cpu_packet(world, log.camera(f), image, r.renderDebug, &stats, threads);
+        } else {
+            scene.traversal = Traversal(r.traversal);
+            render_cpu(scene, log.camera(f), image, r.renderDebug, &stats, threads);
+        }
+        hashes.push_back(hash_image(image));
+        ms.push_back(stats.seconds * 1000.0);
+
+        if (log.applyEdits(f, nextEdit, world) == 0) continue;
+        std::vector<int> chunks = update_octree(world, octree, world.dirtyVoxels, threads);
+        update_distance_field(world, distance, world.dirtyVoxels, threads);
+        // The pyramid root is the chunk occupancy
+        for (int c : chunks) occupancy[c] = octree.pyramid[(size_t)c * OCTREE_NODES_PER_CHUNK];
+        if (packedVoxels) repack_chunks(world, packed, chunks);
+        world.clearDirty();
+    }
+
+    std::sort(ms.begin(), ms.end());
+    double avg = 0.0;
+    for (double v : ms) avg += v / ms.size();
+    std::cout << "Replayed " << log.frames.size() << " frames on the CPU at " << width << "x" << height << " : "
+              << avg << " ms avg, " << (ms.empty() ? 0.0 : ms[std::min(ms.size() - 1, ms.size() * 99 / 100)]) << " ms p99" << std::endl;
+    return finish_frame_hashes(hashes, hashesOut, hashesCheck);
+}
+
+
+// GPU side of the world the CPU code reads back / uploads to
+struct WorldBuffers {
+    GLuint voxels;      // binding 0
+    GLuint octree;      // binding 1, sparse nodes, packed (OctreeSlots)
+    GLuint octreeOffsets;   // binding 11, first node of each chunk
+    GLuint occupancy;   // binding 4
+    GLuint distance;    // binding 5, packed bytes
+    GLuint packedChunks = 0, packedPalettes = 0, packedWords = 0;  // bindings 7 to 9, --packed only
 };
 
 
-// For loading files, need to redo tha part with OCREE support
-// void loadChunkToMasterSSBO(GLuint ssbo, std::string filepath, int chunkIndex) {
-//     std::ifstream in(filepath, std::ios::binary);
-//     if (!in) throw std::runtime_error("Failed to open chunk file : " + filepath);
+// (Re)allocates and fills the three palette packed voxel buffers
+void upload_packed_voxels(const WorldBuffers& buffers, const PackedVoxels& packed) {
+    auto upload = [](GLuint buffer, GLuint binding, const std::vector<uint32_t>& data) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        // Never 0 bytes, a world of uniform chunks has no words at all
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(data.size(), 1) * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(uint32_t), data.data());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+    };
+    upload(buffers.packedChunks, 7, packed.chunkInfo);
+    upload(buffers.packedPalettes, 8, packed.palettes);
+    upload(buffers.packedWords, 9, packed.words);
+}
 
-//     std::vector<uint32_t> data(CHUNK_VOXELS);
-//     in.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(uint32_t));
-//     in.close();
+// (Re)allocates and fills the sparse nodes in the slots' layout, and the slot offsets
+void upload_octree(const WorldBuffers& buffers, const OctreeWorld& octree, const OctreeSlots& slots) {
+    std::vector<uint32_t> nodes = slotted_nodes(octree, slots);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.octree);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, slots.byteSize(), nodes.data(), GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers.octree);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.octreeOffsets);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, slots.offsets.size() * sizeof(uint32_t), slots.offsets.data(), GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, buffers.octreeOffsets);
+}
 
-//     size_t offset = chunkIndex * CHUNK_VOXELS * sizeof(uint32_t);
-//     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
-//     glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, data.size() * sizeof(uint32_t), data.data());
-// }
 
-// ================== ! Voxel struct and values ============
+// The bound framebuffer into image, flipped to the Image row order
+void read_framebuffer(Image& image, int width, int height) {
+    image.resize(width, height);
+    std::vector<uint8_t> rows(image.rgb.size());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+    size_t rowSize = (size_t)width * 3;
+    for (int y = 0; y < height; ++y)
+        std::copy_n(&rows[(size_t)y * rowSize], rowSize, &image.rgb[(size_t)(height - 1 - y) * rowSize]);
+}
+
 
+// Reads back the frame that was just drawn and the voxel buffer, renders the same
+// camera on the CPU and writes both images so they can be diffed. The CPU builds its
+// own acceleration structure from the voxels and checks it against the GPU one.
+// With `packed` (the host copy, for the buffer sizes), the voxels are read back from
+// the packed buffers and decoded instead.
+void capture_reference_frames(const WorldBuffers& buffers, glm::ivec3 worldDim, glm::ivec3 worldOrigin, const PackedVoxels* packed,
+                              const Camera& cam, int renderDebug, Traversal traversal) {
+    Image gpu;
+    read_framebuffer(gpu, WIDTH, HEIGHT);
+
+    VoxelWorld world(worldDim);
+    world.setOrigin(worldOrigin);
+    if (packed) {
+        PackedVoxels gpuPacked = *packed;
+        auto readBack = [](GLuint buffer, std::vector<uint32_t>& data) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(uint32_t), data.data());
+        };
+        readBack(buffers.packedChunks, gpuPacked.chunkInfo);
+        readBack(buffers.packedPalettes, gpuPacked.palettes);
+        readBack(buffers.packedWords, gpuPacked.words);
+        unpack_world(gpuPacked, world);
+    } else {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.voxels);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, world.byteSize(), world.voxels.data());
+    }
+
+    SceneAccel accel;
+    Scene scene = accel.prepare(world, traversal);
+    if (traversal == Traversal::Octree) {
+        const OctreeWorld& octree = accel.octree;
+        std::vector<uint32_t> gpuOffsets(octree.nodeCounts.size());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.octreeOffsets);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuOffsets.size() * sizeof(uint32_t), gpuOffsets.data());
+        GLint64 gpuBytes = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.octree);
+        glGetBufferParameteri64v(GL_SHADER_STORAGE_BUFFER, GL_BUFFER_SIZE, &gpuBytes);
+        std::vector<uint32_t> gpuNodes(gpuBytes / sizeof(uint32_t));
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuNodes.size() * sizeof(uint32_t), gpuNodes.data());
+
+        size_t badChunks = 0;
+        for (size_t c = 0; c < octree.nodeCounts.size(); ++c) {
+            size_t slot = c * OCTREE_NODES_PER_CHUNK;
+            if (gpuOffsets[c] + octree.nodeCounts[c] > gpuNodes.size() ||
+                !std::equal(&octree.nodes[slot], &octree.nodes[slot] + octree.nodeCounts[c], &gpuNodes[gpuOffsets[c]]))
+                badChunks++;
+        }
+        std::cout << "\nGPU octree : " << badChunks << " chunks differ from the CPU build" << std::endl;
+    } else if (traversal == Traversal::Chunks) {
+        std::vector<uint32_t> gpuOccupancy(accel.occupancy.size());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.occupancy);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuOccupancy.size() * sizeof(uint32_t), gpuOccupancy.data());
+        std::cout << "\nGPU occupancy : " << (gpuOccupancy == accel.occupancy ? "matches" : "differs from") << " the CPU table" << std::endl;
+    } else if (traversal == Traversal::Distance) {
+        std::vector<uint8_t> gpuDistance(accel.distance.dist.size());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.distance);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuDistance.size(), gpuDistance.data());
+        size_t bad = 0;
+        for (size_t i = 0; i < gpuDistance.size(); ++i)
+            if (gpuDistance[i] != accel.distance.dist[i]) bad++;
+        std::cout << "\nGPU distance field : " << bad << " voxels differ from the CPU build" << std::endl;
+    }
 
+    Image cpu;
+    cpu.resize(WIDTH, HEIGHT);
+    RenderStats stats;
+    render_cpu(scene, cam, cpu, renderDebug, &stats);
 
+    write_ppm("gpu_frame.ppm", gpu);
+    write_ppm("cpu_frame.ppm", cpu);
 
-// FPS counter : 
-const int FPS_SAMPLES = 100;
-float frameTimes[FPS_SAMPLES] = {0.0f}; // initialize with zeros
-int frameIndex = 0;
-bool filled = false;
+    int maxDiff = 0;
+    size_t mismatched = count_mismatched_pixels(gpu, cpu, 12, &maxDiff);
+    std::cout << "\nCaptured gpu_frame.ppm / cpu_frame.ppm (CPU " << stats.seconds * 1000.0 << " ms) : "
+              << mismatched << " pixels off by more than 12/255, max diff " << maxDiff << std::endl;
+}
 
+// --benchmark on the GPU : the path drawn into an offscreen width x height target, one
+// frame at a time. Each draw is timed with a GL_TIME_ELAPSED query (and glFinish() for
+// the wall time), then drawn again untimed with RENDER_DEBUG=1 into a float target that
+// is read back for the step counts. With a scale below 1 or a targetMs the frames are
+// raymarched in the corner of the target, the timings leave out the upscale (a single
+// fullscreen pass of texture reads).
+PathBenchmark benchmark_path_gpu(GLuint shader, const CameraPath& path, int frames, int width, int height,
+                                 float scale, double targetMs, int renderDebug, Traversal traversal, bool packed,
+                                 glm::ivec3 worldDim) {
+    auto makeTarget = [&](GLenum format) {
+        GLuint texture, fbo;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            throw std::runtime_error("Incomplete benchmark framebuffer");
+        return std::make_pair(fbo, texture);
+    };
+    auto color = makeTarget(GL_RGBA8);
+    auto steps = makeTarget(GL_R32F);
+
+    glUseProgram(shader);
+    GLint locRes = glGetUniformLocation(shader, "resolution");
+    glUniform1f(glGetUniformLocation(shader, "FOV"), 60.0f);
+    glUniform1i(glGetUniformLocation(shader, "traversalMode"), (int)traversal);
+    glUniform1i(glGetUniformLocation(shader, "voxelFormat"), packed ? 1 : 0);
+    glUniform3i(glGetUniformLocation(shader, "worldOrigin"), 0, 0, 0);
+    glUniform3i(glGetUniformLocation(shader, "worldOriginSlot"), 0, 0, 0);
+    GLint locCamPos = glGetUniformLocation(shader, "camPos");
+    GLint locCamRot = glGetUniformLocation(shader, "camRot");
+    GLint locDebug = glGetUniformLocation(shader, "RENDER_DEBUG");
+
+    auto draw = [&](const Camera& cam, glm::ivec2 size, GLuint fbo, int debug) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, size.x, size.y);
+        glUniform2f(locRes, (float)size.x, (float)size.y);
+        glUniform3f(locCamPos, cam.pos.x, cam.pos.y, cam.pos.z);
+        glUniform3f(locCamRot, cam.rot.x, cam.rot.y, 0.0f);
+        glUniform1i(locDebug, debug);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    };
+
+    PathBenchmark result;
+    result.renderer = "gpu";
+    result.device = (const char*)glGetString(GL_RENDERER);
+    result.traversal = traversal;
+    result.packed = packed;
+    result.renderDebug = renderDebug;
+    result.width = width;
+    result.height = height;
+    result.scale = scale;
+    result.targetMs = targetMs;
+    result.worldDim = worldDim;
+    result.path = path;
+
+    // Warm-up, drivers finish compiling on the first draw
+    ResolutionScaler scaler(targetMs, scale);
+    draw(path.at(0.0), scaled_resolution(width, height, scale), color.first, renderDebug);
+    glFinish();
+
+    std::vector<float> stepValues((size_t)width * height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    frames = std::max(1, frames);
+    for (int f = 0; f < frames; ++f) {
+        double t = frames > 1 ? path.duration() * f / (frames - 1) : 0.0;
+        Camera cam = path.at(t);
+        PathFrame frame{t, 0.0, 0.0, RenderStats{}, scaler.scale};
+        glm::ivec2 size = scaled_resolution(width, height, frame.scale);
+
+        auto start = std::chrono::steady_clock::now();
+        frame.ms = gpu_time_ms([&]() { draw(cam, size, color.first, renderDebug); });
+        glFinish();
+        frame.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        scaler.update(frame.ms, frame.scale);
+
+        draw(cam, size, steps.first, 1);
+        size_t rays = (size_t)size.x * size.y;
+        glReadPixels(0, 0, size.x, size.y, GL_RED, GL_FLOAT, stepValues.data());
+        for (size_t i = 0; i < rays; ++i) {
+            uint32_t n = (uint32_t)std::lround(stepValues[i] * MAX_STEPS);
+            frame.stats.steps += n;
+            frame.stats.exhausted += n >= (uint32_t)MAX_STEPS;
+        }
+        frame.stats.rays = rays;
+        frame.stats.seconds = frame.ms / 1000.0;
+        result.frames.push_back(frame);
+    }
 
-int main() {
-    glfwInit();
-    GLFWwindow* win = glfwCreateWindow(WIDTH, HEIGHT, "ShaderDemo", NULL, NULL);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    for (auto target : {color, steps}) {
+        glDeleteFramebuffers(1, &target.first);
+        glDeleteTextures(1, &target.second);
+    }
+    return result;
+}
+
+// ================== ! CPU reference rendering ============
+
+
+
+// ================== Edits ============
+
+// Voxel under the screen center and the one just in front of it. false when the
+// ray doesn't stop on anything
+bool pick_voxel(const Scene& scene, const Camera& cam, glm::ivec3& hit, glm::ivec3& front) {
+    glm::vec3 ro, rd;
+    glm::vec2 resolution(WIDTH, HEIGHT);
+    primaryRay(cam, resolution * 0.5f, resolution, ro, rd);
+
+    glm::vec3 color, impactPosition;
+    float transparency;
+    uint32_t steps;
+    if (!raymarch(scene, ro, rd, color, transparency, steps, impactPosition) || transparency >= 0.01f)
+        return false;
+
+    hit = glm::ivec3(impactPosition);
+    front = glm::ivec3(glm::floor(impactPosition + 0.5f - rd));
+    return true;
+}
+
+
+// Uploads what changed on the host for these chunks : voxels (or their packed slots,
+// after repacking them), sparse nodes (moving the slots that got too small) and
+// occupancy of `chunks`, distances of `distanceChunks`
+void upload_chunks(const VoxelWorld& world, const OctreeWorld& octree, OctreeSlots& slots, const DistanceField& distance,
+                   PackedVoxels* packed, const WorldBuffers& buffers, const std::vector<int>& chunks,
+                   const std::vector<int>& distanceChunks) {
+    PROFILE_SCOPE("upload chunks");
+    for (int c : distanceChunks) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.distance);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, (size_t)c * CHUNK_VOXELS, CHUNK_VOXELS, &distance.dist[(size_t)c * CHUNK_VOXELS]);
+    }
+
+    // Only the slots of the repacked chunks, unless one of them had to move
+    bool packedMoved = packed && repack_chunks(world, *packed, chunks);
+    if (packedMoved) upload_packed_voxels(buffers, *packed);
+    bool octreeMoved = fit_octree_slots(octree, slots, chunks);
+    if (octreeMoved) upload_octree(buffers, octree, slots);
+
+    for (int c : chunks) {
+        if (!packed) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.voxels);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, (size_t)c * CHUNK_VOXELS * sizeof(Voxel), CHUNK_VOXELS * sizeof(Voxel),
+                            &world.voxels[(size_t)c * CHUNK_VOXELS]);
+        } else if (!packedMoved) {
+            const uint32_t* info = &packed->chunkInfo[(size_t)c * PACKED_INFO_STRIDE];
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.packedChunks);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, (size_t)c * PACKED_INFO_STRIDE * sizeof(uint32_t),
+                            PACKED_INFO_STRIDE * sizeof(uint32_t), info);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.packedPalettes);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, info[1] * sizeof(uint32_t), info[3] * sizeof(uint32_t), &packed->palettes[info[1]]);
+            if (info[2] != 0u) {
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.packedWords);
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, info[0] * sizeof(uint32_t), CHUNK_VOXELS * info[2] / 8, &packed->words[info[0]]);
+            }
+        }
+        if (!octreeMoved) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.octree);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, (size_t)slots.offsets[c] * sizeof(uint32_t),
+                            octree.nodeCounts[c] * sizeof(uint32_t), &octree.nodes[(size_t)c * OCTREE_NODES_PER_CHUNK]);
+        }
+        // The pyramid root is the chunk occupancy
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.occupancy);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, (size_t)c * sizeof(uint32_t), sizeof(uint32_t),
+                        &octree.pyramid[(size_t)c * OCTREE_NODES_PER_CHUNK]);
+    }
+}
+
+
+// Brings the host octree and distance field (and packed voxels, when the GPU uses them)
+// up to date with the world's dirty voxels and uploads the touched chunks (voxels,
+// sparse nodes, occupancy, distances) to the GPU
+void apply_edits(VoxelWorld& world, OctreeWorld& octree, OctreeSlots& slots, DistanceField& distance, PackedVoxels* packed,
+                 const WorldBuffers& buffers) {
+    if (world.dirtyVoxels.empty()) return;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> chunks = update_octree(world, octree, world.dirtyVoxels);
+    double octreeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    std::vector<int> distanceChunks = update_distance_field(world, distance, world.dirtyVoxels);
+    double distanceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t voxelCount = world.dirtyVoxels.size();
+    world.clearDirty();
+
+    upload_chunks(world, octree, slots, distance, packed, buffers, chunks, distanceChunks);
+
+    std::cout << "\nEdit : " << voxelCount << " voxels, octree update " << octreeMs << " ms ("
+              << chunks.size() << " chunks), distance field update " << distanceMs << " ms ("
+              << distanceChunks.size() << " chunks)" << std::endl;
+}
+
+
+// --stream : moves the window over the camera and brings in what the workers finished.
+// Cleared slots go up right away (the GPU mustn't keep drawing the chunks that left),
+// arrivals are grouped by column (group_columns()) and queued one column per task through
+// the frame budget, so a column always lands in a single frame and a burst
+// of them is spread over a few frames instead of stalling one.
+const int TASK_STREAMED_COLUMN = 0;
+
+void stream_world(ChunkStreamer& streamer, FrameBudgetQueue& uploads, glm::vec3 camPos, VoxelWorld& world,
+                  OctreeWorld& octree, OctreeSlots& slots, DistanceField& distance, PackedVoxels* packed,
+                  const WorldBuffers& buffers) {
+    PROFILE_SCOPE("stream");
+    std::vector<int> cleared = streamer.recentre(camPos);
+    if (!cleared.empty()) {
+        reset_streamed_distances(distance, cleared);
+        upload_chunks(world, octree, slots, distance, packed, buffers, cleared, cleared);
+    }
+
+    // Only poll when the last batch is through, the rest waits in the streamer
+    if (uploads.empty()) {
+        std::vector<int> arrived = streamer.poll(STREAM_CHUNKS_PER_FRAME);
+        for (const std::vector<int>& column : group_columns(world, arrived)) {
+            uploads.push(TASK_STREAMED_COLUMN, [&world, &octree, &slots, &distance, packed, &buffers, column]() {
+                std::vector<int> distanceChunks = update_streamed_distances(world, distance, column, 1);
+                upload_chunks(world, octree, slots, distance, packed, buffers, column, distanceChunks);
+            });
+        }
+    }
+    uploads.run();
+}
+
+// ================== ! Edits ============
+
+
+
+
+int main(int argc, char** argv) {
+    glm::vec3 camPos(-58.6984, 123.135, -19.7525);
+    glm::vec2 camRot(0.561, 2.151);
+
+    // Visual debug cycler
+    int RENDER_DEBUG = 0;
+
+    // ===== Command line =====
+    // --headless out.ppm       render one frame with the CPU raymarcher and exit, no GPU needed
+    // --chunks dir             load chunk-x-y-z.bin files (data/utils.py) instead of generating the terrain
+    // --archive file.vxa       load a world archive instead (world size comes from the archive)
+    // --pack-archive out.vxa   write the --chunks files (or the generated terrain) as one archive and exit
+    // --compress name          --pack-archive chunk payloads : raw (default), rle or rle+zstd
+    // --world x y z            world size in chunks (default WORLD_DIM)
+    // --cpu-gen                windowed mode generates the terrain on the CPU instead of voxel.glsl
+    // --single-pass-gen        voxel.glsl evaluates fbm per voxel instead of using the heightmap pass
+    // --gen-compare            run and time both GPU generation modes
+    // --size w h               --headless resolution (default WIDTH x HEIGHT)
+    // --cam x y z pitch yaw    starting camera
+    // --debug n                starting RENDER_DEBUG value
+    // --traversal name         dda (default), octree, chunks or distance, also keys 1 to 4 in the window
+    // --packed                 palette packed voxels : on the GPU in the window, CPU decode for --headless
+    // --threads n              CPU render threads (default all cores, 1 for --bench)
+    // --packet                 --headless uses the SIMD packet traversal
+    // --stream                 infinite world : the --world window follows the camera, chunks generated (or read
+    //                          from --archive, air outside of it) by worker threads as it moves
+    // --profile-trace file     windowed mode writes a Chrome trace (chrome://tracing) of the profiler scopes on exit
+    // --frame-budget ms        --stream main thread time per frame for the chunks that arrived (default 4)
+    // --bench name             run a headless benchmark and exit : packet, traversal, octree, edits, worldgen, load, archive, packed, rle, layout, stream,
+    //                          reproject (--path, --frames frames at 60 Hz, default 60), cone (--path, --frames cameras, default 8)
+    // --frames n               timed repetitions per benchmark case (default 3), frames along the path for --benchmark (default 120)
+    // --benchmark out.json     render --frames frames along a camera path at --size, offscreen on the GPU (on the CPU
+    //                          with --cpu or without a GL context), write frame times, rays/s and avg steps as JSON
+    //                          ("-" : stdout). --traversal, --packed, --packet (CPU), --debug and --threads apply
+    // --path file              camera path for --benchmark (camera_path.hpp) or a --record log, default the built-in flyover
+    // --cpu                    --benchmark and --replay on the CPU raymarcher
+    // --record-path file       windowed mode writes the camera path it flew on exit, for --path
+    // --record log.sdl         windowed mode logs every frame's camera, RENDER_DEBUG and traversal, and the edits (frame_log.hpp)
+    // --replay log.sdl         draws a --record log frame by frame, fixed timestep, no keyboard / mouse, then exits.
+    //                          With --cpu, on the CPU raymarcher at --size instead
+    // --hash-frames file       --replay writes a hash of every frame
+    // --check-hashes file      --replay compares its frame hashes against a --hash-frames file, exit code 1 if any differs
+    // --shader-cache dir       where linked shader programs are kept between runs (default shader_cache)
+    // --no-shader-cache        compile every shader, read and write no cache (cold start timings)
+    // --shader-dir dir         read the .glsl files from there (default shaders), e.g. the sources with .. from build/.
+    //                          The window rebuilds its programs whenever one of them is saved
+    // --scale s                raymarch at s x the size (0 < s <= 1) then upscale : the window, --headless, --benchmark
+    // --target-ms ms           dynamic resolution : the scale follows the measured raymarch time against this budget
+    // --temporal               the window's upscale also reprojects and blends the previous frames (with --scale / --target-ms)
+    // --reproject              the window starts each ray a little before last frame's hit around its pixel (reprojection.hpp)
+    // --cone                   the window starts each ray where an 8x8 tile's cone pre-pass stopped (cone_prepass.hpp)
+    // --compute                the window starts on the compute path for the primary rays (raymarch_compute.glsl), C switches
+    // --compute-groups n       persistent 8x8 groups the compute path dispatches (default 256)
+    std::string headlessOutput;
+    std::string benchName;
+    std::string chunkDir;
+    std::string archivePath, packArchivePath;
+    ChunkCompression compression = CHUNK_RAW;
+    glm::ivec3 worldDim = WORLD_DIM;
+    bool cpuGen = false;
+    bool singlePassGen = false;
+    bool compareGen = false;
+    int outWidth = WIDTH, outHeight = HEIGHT;
+    int threads = -1;
+    int frames = 3;
+    bool packet = false;
+    bool packedVoxels = false;
+    bool stream = false;
+    double frameBudgetMs = 4.0;
+    std::string profileTracePath;
+    std::string benchmarkOutput, cameraPathFile, recordPathFile;
+    bool cpuBenchmark = false;
+    bool framesGiven = false;
+    float renderScale = 1.0f;
+    double targetMs = 0.0;
+    bool temporal = false;
+    bool reproject = false;
+    bool cone = false;
+    bool computeRender = false;
+    int computeGroups = 256;
+    std::string recordLogFile, replayLogFile, hashFramesFile, checkHashesFile;
+    Traversal traversal = Traversal::Dda;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](int n) -> const char* {
+            if (i + n >= argc) throw std::invalid_argument("Missing value for " + arg);
+            return argv[i + n];
+        };
+
+        if (arg == "--headless") { headlessOutput = value(1); i += 1; }
+        else if (arg == "--chunks") { chunkDir = value(1); i += 1; }
+        else if (arg == "--archive") { archivePath = value(1); i += 1; }
+        else if (arg == "--pack-archive") { packArchivePath = value(1); i += 1; }
+        else if (arg == "--compress") {
+            std::string name = value(1);
+            if (!parse_chunk_compression(name, compression)) throw std::invalid_argument("Unknown compression : " + name);
+            i += 1;
+        }
+        else if (arg == "--world") {
+            worldDim = glm::ivec3(std::stoi(value(1)), std::stoi(value(2)), std::stoi(value(3)));
+            i += 3;
+        }
+        else if (arg == "--cpu-gen") { cpuGen = true; }
+        else if (arg == "--single-pass-gen") { singlePassGen = true; }
+        else if (arg == "--gen-compare") { compareGen = true; }
+        else if (arg == "--size") { outWidth = std::stoi(value(1)); outHeight = std::stoi(value(2)); i += 2; }
+        else if (arg == "--cam") {
+            camPos = glm::vec3(std::stof(value(1)), std::stof(value(2)), std::stof(value(3)));
+            camRot = glm::vec2(std::stof(value(4)), std::stof(value(5)));
+            i += 5;
+        }
+        else if (arg == "--debug") { RENDER_DEBUG = std::stoi(value(1)); i += 1; }
+        else if (arg == "--traversal") {
+            std::string name = value(1);
+            if (!parse_traversal(name, traversal)) throw std::invalid_argument("Unknown traversal : " + name);
+            i += 1;
+        }
+        else if (arg == "--threads") { threads = std::stoi(value(1)); i += 1; }
+        else if (arg == "--packet") { packet = true; }
+        else if (arg == "--packed") { packedVoxels = true; }
+        else if (arg == "--stream") { stream = true; }
+        else if (arg == "--profile-trace") { profileTracePath = value(1); i += 1; }
+        else if (arg == "--frame-budget") { frameBudgetMs = std::stod(value(1)); i += 1; }
+        else if (arg == "--bench") { benchName = value(1); i += 1; }
+        else if (arg == "--frames") { frames = std::stoi(value(1)); framesGiven = true; i += 1; }
+        else if (arg == "--benchmark") { benchmarkOutput = value(1); i += 1; }
+        else if (arg == "--path") { cameraPathFile = value(1); i += 1; }
+        else if (arg == "--cpu") { cpuBenchmark = true; }
+        else if (arg == "--record-path") { recordPathFile = value(1); i += 1; }
+        else if (arg == "--record") { recordLogFile = value(1); i += 1; }
+        else if (arg == "--replay") { replayLogFile = value(1); i += 1; }
+        else if (arg == "--hash-frames") { hashFramesFile = value(1); i += 1; }
+        else if (arg == "--check-hashes") { checkHashesFile = value(1); i += 1; }
+        else if (arg == "--shader-cache") { programCache.setDirectory(value(1)); i += 1; }
+        else if (arg == "--no-shader-cache") { programCache.setDirectory(""); }
+        else if (arg == "--scale") {
+            renderScale = std::stof(value(1));
+            if (!(renderScale > 0.0f && renderScale <= 1.0f)) throw std::invalid_argument("--scale takes a value in (0, 1]");
+            i += 1;
+        }
+        else if (arg == "--target-ms") { targetMs = std::stod(value(1)); i += 1; }
+        else if (arg == "--temporal") { temporal = true; }
+        else if (arg == "--reproject") { reproject = true; }
+        else if (arg == "--cone") { cone = true; }
+        else if (arg == "--compute") { computeRender = true; }
+        else if (arg == "--compute-groups") { computeGroups = std::max(1, std::stoi(value(1))); i += 1; }
+        else if (arg == "--shader-dir") {
+            shaderDir = value(1);
+            if (!shaderDir.empty() && shaderDir.back() != '/') shaderDir += '/';
+            i += 1;
+        }
+        else {
+            std::cerr << "Unknown argument : " << arg << std::endl;
+            return -1;
+        }
+    }
+
+    // Streaming keeps its --world window, the archive is just where chunks come from
+    if (!archivePath.empty() && !stream) worldDim = WorldArchive(archivePath).dim();
+
+    if (!packArchivePath.empty()) {
+        VoxelWorld world = make_host_world("", chunkDir, worldDim, 0);
+        write_world_archive(world, packArchivePath, compression);
+        std::cout << "Wrote " << packArchivePath << std::endl;
+        return 0;
+    }
+
+    if (!headlessOutput.empty()) {
+        VoxelWorld world(worldDim);
+        if (stream) {
+            // The window the streaming would have around the camera, generated in one go
+            world.setOrigin(centred_window_origin(worldDim, camPos));
+            generate_world(world, std::max(threads, 0));
+        } else {
+            world = make_host_world(archivePath, chunkDir, worldDim, std::max(threads, 0));
+        }
+        return run_headless(headlessOutput, world, Camera{camPos, camRot, 60.0f}, outWidth, outHeight, renderScale,
+                            RENDER_DEBUG, std::max(threads, 0), packet, traversal, packedVoxels);
+    }
+
+    // --benchmark : same frames on the CPU, or on the GPU once everything is set up below
+    CameraPath benchmarkPath;
+    if (!benchmarkOutput.empty()) {
+        if (stream) throw std::invalid_argument("--benchmark renders a fixed world, not with --stream");
+        if (cameraPathFile.empty()) benchmarkPath = default_camera_path();
+        else if (is_frame_log(cameraPathFile)) benchmarkPath = frame_log_camera_path(load_frame_log(cameraPathFile));
+        else benchmarkPath = load_camera_path(cameraPathFile);
+        if (!framesGiven) frames = 120;
+    }
+    auto runCpuBenchmark = [&]() {
+        VoxelWorld world = make_host_world(archivePath, chunkDir, worldDim, std::max(threads, 0));
+        BenchSettings settings{benchmarkPath.at(0.0), outWidth, outHeight, std::max(threads, 0), frames, renderScale, targetMs};
+        return report_path_benchmark(bench_camera_path(world, benchmarkPath, settings, traversal, packet, packedVoxels, RENDER_DEBUG),
+                                     benchmarkOutput);
+    };
+    if (!benchmarkOutput.empty() && cpuBenchmark) return runCpuBenchmark();
+
+    FrameLog replayLog;
+    if (!replayLogFile.empty()) {
+        if (stream) throw std::invalid_argument("--replay draws a fixed world, not with --stream");
+        // The scale would follow the timings of this run, not draw the same frames twice
+        if (targetMs > 0.0) throw std::invalid_argument("--replay draws the same frames every run, not with --target-ms (--scale is fine)");
+        replayLog = load_frame_log(replayLogFile);
+        if (replayLog.worldDim != worldDim)
+            std::cerr << "Warning : " << replayLogFile << " was recorded in a " << replayLog.worldDim.x << "x" << replayLog.worldDim.y
+                      << "x" << replayLog.worldDim.z << " world" << std::endl;
+        if (cpuBenchmark) {
+            VoxelWorld world = make_host_world(archivePath, chunkDir, worldDim, std::max(threads, 0));
+            return run_replay_cpu(replayLog, world, outWidth, outHeight, std::max(threads, 0), packet, packedVoxels,
+                                  hashFramesFile, checkHashesFile);
+        }
+    }
+    bool replaying = !replayLogFile.empty();
+
+    if (!benchName.empty()) {
+        // Per core numbers unless asked otherwise
+        BenchSettings settings{Camera{camPos, camRot, 60.0f}, outWidth, outHeight, threads < 0 ? 1 : threads, frames};
+
+        if (benchName == "worldgen") return bench_worldgen(worldDim, threads < 0 ? 0 : threads, frames);
+        if (benchName == "load") return bench_load(chunkDir, worldDim, threads < 0 ? 0 : threads, frames);
+        if (benchName == "archive") return bench_archive(chunkDir, worldDim, threads < 0 ? 0 : threads, frames);
+        if (benchName == "stream") {
+            settings.threads = threads < 0 ? 0 : threads;
+            return bench_stream(worldDim, settings, frameBudgetMs);
+        }
+        if (benchName == "rle") return bench_rle(make_host_world(archivePath, chunkDir, worldDim, 0), threads < 0 ? 1 : threads, frames);
+
+        VoxelWorld world = make_host_world(archivePath, chunkDir, worldDim, 0);
+        if (benchName == "packet") return bench_packet(world, settings);
+        if (benchName == "traversal") return bench_traversal(world, settings);
+        if (benchName == "octree") return bench_octree(world, settings);
+        if (benchName == "edits") return bench_edits(world, settings);
+        if (benchName == "packed") return bench_packed(world, settings);
+        if (benchName == "layout") return bench_layout(world, settings);
+        if (benchName == "reproject") {
+            // 60 Hz along --path (default the flyover), or the recording's own rate for a --record log
+            double dt = 1.0 / 60.0;
+            CameraPath path = default_camera_path();
+            if (is_frame_log(cameraPathFile)) {
+                FrameLog log = load_frame_log(cameraPathFile);
+                dt = log.dt;
+                path = frame_log_camera_path(log);
+            } else if (!cameraPathFile.empty()) {
+                path = load_camera_path(cameraPathFile);
+            }
+            if (!framesGiven) settings.frames = 60;
+            settings.threads = threads < 0 ? 0 : threads;
+            return bench_reprojection(world, path, dt, settings, traversal);
+        }
+        if (benchName == "cone") {
+            if (!framesGiven) settings.frames = 8;
+            settings.threads = threads < 0 ? 0 : threads;
+            return bench_cone(world, cameraPathFile.empty() ? default_camera_path() : load_camera_path(cameraPathFile), settings);
+        }
+        std::cerr << "Unknown benchmark : " << benchName << std::endl;
+        return -1;
+    }
+
+
+    auto startupStart = std::chrono::steady_clock::now();
+    GLFWwindow* win = nullptr;
+    if (glfwInit()) {
+        // --benchmark draws offscreen, the window is only there for the context
+        if (!benchmarkOutput.empty()) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        win = glfwCreateWindow(WIDTH, HEIGHT, "ShaderDemo", NULL, NULL);
+    }
+    if (!win && !benchmarkOutput.empty()) {
+        std::cerr << "No GL context, benchmarking the CPU raymarcher instead" << std::endl;
+        glfwTerminate();
+        return runCpuBenchmark();
+    }
+    if (!win) {
+        std::cerr << "Failed to create the window\n";
+        return -1;
+    }
     glfwMakeContextCurrent(win);
     if (!gladLoadGL(glfwGetProcAddress)) {
         std::cerr << "Failed to initialize GLAD\n";
         return -1;
     }
+    // Everything else is 4.3 (compute, SSBOs), a few options need 4.4 calls
+    if (!GLAD_GL_VERSION_4_4 && !stream && (!archivePath.empty() || !chunkDir.empty())) {
+        std::cerr << "Loading chunk files needs OpenGL 4.4 (glBufferStorage for the persistent staging buffer), this context is "
+                  << glGetString(GL_VERSION) << std::endl;
+        return -1;
+    }
+    if (!GLAD_GL_VERSION_4_4 && reproject) {
+        std::cerr << "--reproject needs OpenGL 4.4 (glClearTexImage for the ray starts), this context is "
+                  << glGetString(GL_VERSION) << std::endl;
+        return -1;
+    }
     glfwSetInputMode(win, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     GLuint vao, vbo;
@@ -169,27 +1250,59 @@ int main() {
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
-    std::string vsrc = load_file("shaders/vertex.glsl");
-    std::string fsrc = load_file("shaders/shader.glsl");
-    GLuint shader = create_program(vsrc.c_str(), fsrc.c_str());
-
-    GLint locRes = glGetUniformLocation(shader, "resolution");
-    GLint locCamPos = glGetUniformLocation(shader, "camPos");
-    GLint locCamRot = glGetUniformLocation(shader, "camRot");
-    GLint locFOV = glGetUniformLocation(shader, "FOV");
-
-    // Chunk world stuff == Initialization
-    GLint chunkSizeLoc = glGetUniformLocation(shader, "chunkSize");
-    GLint worldDimLoc = glGetUniformLocation(shader, "worldDim");
-
-    // Visual debug cycler
-    int RENDER_DEBUG = 0;
-    GLint RENDER_DEBUGLoc = glGetUniformLocation(shader, "RENDER_DEBUG");
-    glUniform1i(RENDER_DEBUGLoc, RENDER_DEBUG);
-
-    glUseProgram(shader); // needed to start assigning values
-    glUniform1i(chunkSizeLoc, CHUNK_SIZE);
-    glUniform3i(worldDimLoc, WORLD_DIM.x, WORLD_DIM.y, WORLD_DIM.z);
+    LiveProgram display{"shader.glsl", display_shader_stages()};
+    display.program = programCache.get(display.name, display.stages);
+
+    // Locations of the raymarch uniforms, shader.glsl and raymarch_compute.glsl have the same ones
+    struct RaymarchUniforms {
+        GLint res, camPos, camRot, fov, jitter, reproject, cone;
+        GLint worldOrigin, worldOriginSlot;
+        GLint renderDebug, traversalMode, voxelFormat;
+    };
+    RaymarchUniforms displayUniforms, computeUniforms;
+    // Locations and the uniforms that never change, again after every shader reload
+    auto setup_raymarch_program = [&](GLuint shader, RaymarchUniforms& u) {
+        u.res = glGetUniformLocation(shader, "resolution");
+        u.camPos = glGetUniformLocation(shader, "camPos");
+        u.camRot = glGetUniformLocation(shader, "camRot");
+        u.fov = glGetUniformLocation(shader, "FOV");
+        u.jitter = glGetUniformLocation(shader, "jitter");
+        u.reproject = glGetUniformLocation(shader, "reproject");
+        u.cone = glGetUniformLocation(shader, "cone");
+
+        // Chunk world stuff == Initialization
+        u.worldOrigin = glGetUniformLocation(shader, "worldOrigin");
+        u.worldOriginSlot = glGetUniformLocation(shader, "worldOriginSlot");
+
+        // Visual debug cycler
+        u.renderDebug = glGetUniformLocation(shader, "RENDER_DEBUG");
+        u.traversalMode = glGetUniformLocation(shader, "traversalMode");
+        u.voxelFormat = glGetUniformLocation(shader, "voxelFormat");
+
+        glUseProgram(shader); // needed to start assigning values
+        glUniform1i(glGetUniformLocation(shader, "chunkSize"), CHUNK_SIZE);
+        glUniform3i(glGetUniformLocation(shader, "worldDim"), worldDim.x, worldDim.y, worldDim.z);
+        glUniform1i(glGetUniformLocation(shader, "tStartTex"), 3);
+        glUniform1f(glGetUniformLocation(shader, "reprojectBackoff"), REPROJECT_BACKOFF);
+        glUniform1i(glGetUniformLocation(shader, "coneTex"), 4);
+    };
+    setup_raymarch_program(display.program, displayUniforms);
+
+    // --compute / C : the primary rays from raymarch_compute.glsl into the scene targets
+    // instead of the fullscreen quad. Optional, a driver that can't build it keeps the quad.
+    LiveProgram computeProgram{"raymarch_compute.glsl", {}};
+    GLuint tileQueue = 0;
+    try {
+        computeProgram.stages = {{GL_COMPUTE_SHADER, load_shader_source(shader_path("raymarch_compute.glsl"))}};
+        computeProgram.program = programCache.get(computeProgram.name, computeProgram.stages);
+        setup_raymarch_program(computeProgram.program, computeUniforms);
+        glGenBuffers(1, &tileQueue);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileQueue);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\nNo compute path, staying on the fragment shader" << std::endl;
+        computeRender = false;
+    }
 
 
 
@@ -197,15 +1310,28 @@ int main() {
 
 
 
-    glm::vec3 camPos(-58.6984, 123.135, -19.7525);
-    glm::vec2 camRot(0.561, 2.151);
     double lastTime = glfwGetTime();
+    double lastReport = lastTime;
+    int framesSinceReport = 0;
+
+    PROFILE_THREAD_NAME("main");
+#ifdef SHADERDEMO_PROFILE
+    if (!profileTracePath.empty()) Profiler::get().setTracing(true);
+#else
+    if (!profileTracePath.empty()) std::cerr << "Built without the profiler (cmake -DPROFILER=ON), no trace" << std::endl;
+#endif
 
     // Mouse stuff
     double lastX = WIDTH / 2.0;
     double lastY = HEIGHT / 2.0;
     bool firstMouse = true;
 
+    // P key edge detection for the CPU/GPU frame capture, O for the octree rebuild
+    bool captureHeld = false;
+    bool rebuildHeld = false;
+    bool computeHeld = false;
+    bool digHeld = false, placeHeld = false;
+
 
 
 
@@ -214,76 +1340,291 @@ int main() {
 
 
     // ======= voxel SSBO =========
-    GLuint voxelSSBO, octreeSSBO;
+    GLuint voxelSSBO, octreeSSBO, octreeOffsetsSSBO, occupancySSBO, distanceSSBO, distanceScratchSSBO;
 
     // ===== Allocate voxel buffer =====
     glGenBuffers(1, &voxelSSBO);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, voxelSSBO);
     
     size_t per_chunk_raw_size = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(uint32_t);
-    size_t total_voxel_size = TOTAL_CHUNKS * per_chunk_raw_size;
+    size_t chunkCount = (size_t)worldDim.x * worldDim.y * worldDim.z;
+    size_t total_voxel_size = chunkCount * per_chunk_raw_size;
     
     glBufferData(GL_SHADER_STORAGE_BUFFER, total_voxel_size, nullptr, GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, voxelSSBO);
     
     
-    // ===== Allocate octree buffer =====
+    // ===== Octree buffers =====
+    // Allocated by upload_octree() once the host octree knows the node counts
     glGenBuffers(1, &octreeSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, octreeSSBO);
-    
-    int levels = (int)std::log2(CHUNK_SIZE);
-    size_t octree_nodes_per_chunk = (std::pow(8, levels + 1) - 1) / 7;
-    size_t per_chunk_octree_size = octree_nodes_per_chunk * sizeof(uint32_t);    
-    size_t total_octree_size = TOTAL_CHUNKS * per_chunk_octree_size;
-
-    glBufferData(GL_SHADER_STORAGE_BUFFER, total_octree_size, nullptr, GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &octreeOffsetsSSBO);
+    size_t dense_octree_size = chunkCount * OCTREE_NODES_PER_CHUNK * sizeof(uint32_t);
+
+    // Per chunk occupancy, written by build_octree.glsl from the pyramid roots
+    glGenBuffers(1, &occupancySSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, occupancySSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, chunkCount * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, occupancySSBO);
+
+    // Distance field, one byte per voxel, plus the scratch its y pass writes to
+    size_t total_distance_size = chunkCount * CHUNK_VOXELS;
+    glGenBuffers(1, &distanceSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, distanceSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, total_distance_size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, distanceSSBO);
+    glGenBuffers(1, &distanceScratchSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, distanceScratchSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, total_distance_size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, distanceScratchSSBO);
+
+    WorldBuffers buffers{voxelSSBO, octreeSSBO, octreeOffsetsSSBO, occupancySSBO, distanceSSBO};
     
-    bool LoadFromFile = false;
+    // Host copy of the world for the edits (and streaming), they're applied here then uploaded per chunk
+    VoxelWorld hostWorld(worldDim);
+    OctreeWorld hostOctree(worldDim);
+    OctreeSlots octreeSlots;
+    DistanceField hostDistance(worldDim);
+    JobSystem jobs(threads < 0 ? 0 : threads);
+    FrameBudgetQueue streamUploads(frameBudgetMs);
+    std::unique_ptr<ChunkStreamer> streamer;
+    std::unique_ptr<WorldArchive> streamArchive;
+
+    bool LoadFromFile = !archivePath.empty() || !chunkDir.empty();
     // ===== Voxel creation =====
-    if (LoadFromFile) {
-        throw std::invalid_argument("Loading from file not implemented since sw");
-        // // load all chunks to master SSBO ===== currently data.bin as debug
-        // for (int z = 0; z < WORLD_DIM.z; ++z)
-        // for (int y = 0; y < WORLD_DIM.y; ++y)
-        // for (int x = 0; x < WORLD_DIM.x; ++x) {
-        //     int chunkIndex = z * WORLD_DIM.y * WORLD_DIM.x + y * WORLD_DIM.x + x;
-        //     std::string filename = "../data/chunk-" + std::to_string(x) + "-" + std::to_string(y) + "-" + std::to_string(z) + ".bin";
-        //     loadChunkToMasterSSBO(masterSSBO, filename, chunkIndex);
-        //     // std::cout << " Loaded \t"<<x<<",\t"<<y<<",\t"<<z << "\t"<<filename<< std::endl;
+    if (stream) {
+        // The window starts centred on the camera and is filled by the streaming jobs,
+        // octrees included
+        ColumnSource source = terrain_column_source();
+        if (!archivePath.empty()) {
+            streamArchive = std::make_unique<WorldArchive>(archivePath);
+            source = [&archive = *streamArchive](glm::ivec2 chunkXZ, int chunkY, int count, Voxel* out) {
+                glm::ivec3 dim = archive.dim();
+                for (int y = 0; y < count; ++y) {
+                    glm::ivec3 c(chunkXZ.x, chunkY + y, chunkXZ.y);
+                    Voxel* chunk = out + (size_t)y * CHUNK_VOXELS;
+                    if (c.x >= 0 && c.y >= 0 && c.z >= 0 && c.x < dim.x && c.y < dim.y && c.z < dim.z)
+                        archive.readChunk((c.z * dim.y + c.y) * dim.x + c.x, chunk);
+                    else
+                        std::fill(chunk, chunk + CHUNK_VOXELS, Voxel{0u});
+                }
+            };
+        }
+        hostWorld.setOrigin(centred_window_origin(worldDim, camPos));
+        streamer = std::make_unique<ChunkStreamer>(hostWorld, hostOctree, jobs, source);
+
+        auto start = std::chrono::steady_clock::now();
+        streamer->requestAll();
+        streamer->finish();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, voxelSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, hostWorld.byteSize(), hostWorld.voxels.data());
+        std::cout << "Streamed the first " << worldDim.x << "x" << worldDim.y << "x" << worldDim.z
+                  << " chunk window in " << ms << " ms" << std::endl;
+    } else if (LoadFromFile) {
+        LoadStats stats;
+        if (!archivePath.empty()) {
+            WorldArchive archive(archivePath);
+            stats = upload_chunks_gpu(voxelSSBO, worldDim, [&](int begin, int end, Voxel* out) {
+                return archive.readRange(begin, end, out);
+            });
+        } else {
+            stats = upload_chunks_gpu(voxelSSBO, worldDim, [&](int begin, int end, Voxel* out) {
+                return load_chunk_range(chunkDir, worldDim, begin, end, out);
+            });
+        }
+        std::cout << "Streamed " << stats.chunks << " chunks to the GPU in " << stats.seconds * 1000.0 << " ms, "
+                  << stats.mbPerSec() << " MB/s, " << stats.chunksPerSec() << " chunks/s" << std::endl;
     } else {
-        GLuint voxelComputeShader = compileComputeShader("shaders/voxel.glsl");
-        glUseProgram(voxelComputeShader);
-        glUniform3i(glGetUniformLocation(voxelComputeShader, "worldDim"), WORLD_DIM.x, WORLD_DIM.y, WORLD_DIM.z);
-        glUniform1i(glGetUniformLocation(voxelComputeShader, "chunkSize"), CHUNK_SIZE);
-    
-        glDispatchCompute(WORLD_DIM.x, WORLD_DIM.y, WORLD_DIM.z);
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-    
+        if (cpuGen) {
+            // Same terrain as voxel.glsl, generated on the CPU and uploaded
+            VoxelWorld world = make_host_world("", "", worldDim, 0);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, voxelSSBO);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, world.byteSize(), world.voxels.data());
+        } else {
+            // two-pass (default) : heightmap.glsl writes one fbm height per (x,z) column,
+            //                      then voxel.glsl only compares globalPos.y against it
+            // single pass        : voxel.glsl evaluates fbm for each of the voxels of a column
+            GLuint heightmapComputeShader = compileComputeShader("heightmap.glsl");
+            GLuint voxelComputeShader = compileComputeShader("voxel.glsl");
+
+            glm::ivec2 columns = glm::ivec2(worldDim.x, worldDim.z) * CHUNK_SIZE;
+            GLuint heightSSBO;
+            glGenBuffers(1, &heightSSBO);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, heightSSBO);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)columns.x * columns.y * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, heightSSBO);
+
+            auto generate = [&](bool twoPass) {
+                double heightmapMs = 0.0;
+                if (twoPass) {
+                    heightmapMs = gpu_time_ms([&]() {
+                        glUseProgram(heightmapComputeShader);
+                        glUniform3i(glGetUniformLocation(heightmapComputeShader, "worldDim"), worldDim.x, worldDim.y, worldDim.z);
+                        glUniform1i(glGetUniformLocation(heightmapComputeShader, "chunkSize"), CHUNK_SIZE);
+
+                        glDispatchCompute((columns.x + 7) / 8, (columns.y + 7) / 8, 1);
+                        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                    });
+                }
+
+                double fillMs = gpu_time_ms([&]() {
+                    glUseProgram(voxelComputeShader);
+                    glUniform3i(glGetUniformLocation(voxelComputeShader, "worldDim"), worldDim.x, worldDim.y, worldDim.z);
+                    glUniform1i(glGetUniformLocation(voxelComputeShader, "chunkSize"), CHUNK_SIZE);
+                    glUniform1i(glGetUniformLocation(voxelComputeShader, "useHeightmap"), twoPass ? 1 : 0);
+
+                    glDispatchCompute(worldDim.x, worldDim.y, worldDim.z);
+                    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                });
+
+                std::cout << "GPU terrain generation " << worldDim.x << "x" << worldDim.y << "x" << worldDim.z
+                          << (twoPass ? " (two-pass) : " : " (single pass) : ");
+                if (twoPass) std::cout << "heightmap " << heightmapMs << " ms + ";
+                std::cout << "fill " << fillMs << " ms" << std::endl;
+                return heightmapMs + fillMs;
+            };
+
+            if (compareGen) {
+                double single = generate(false);
+                double twoPass = generate(true);
+                std::cout << "Two-pass speedup : x" << single / twoPass << std::endl;
+            } else {
+                generate(!singlePassGen);
+            }
+
+            glDeleteBuffers(1, &heightSSBO);
+            glDeleteProgram(heightmapComputeShader);
+            glDeleteProgram(voxelComputeShader);
+        }
     
-        GLuint octreeComputeShader = compileComputeShader("shaders/build_octree.glsl");
-        glUseProgram(octreeComputeShader);
-        glUniform3i(glGetUniformLocation(octreeComputeShader, "worldDim"), WORLD_DIM.x, WORLD_DIM.y, WORLD_DIM.z);
-        glUniform1i(glGetUniformLocation(octreeComputeShader, "chunkSize"), CHUNK_SIZE);
     
-        glDispatchCompute(WORLD_DIM.x, WORLD_DIM.y, WORLD_DIM.z);
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    if (!stream) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, voxelSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, hostWorld.byteSize(), hostWorld.voxels.data());
+        build_octree(hostWorld, hostOctree);
+    }
+    // The octree buffer is sized from the host build's node counts, the GPU build below
+    // writes the same nodes into those slots
+    layout_octree_slots(hostOctree, octreeSlots);
+    upload_octree(buffers, hostOctree, octreeSlots);
+
+    LiveProgram octreeProgram{"build_octree.glsl", {{GL_COMPUTE_SHADER, load_shader_source(shader_path("build_octree.glsl"))}}};
+    octreeProgram.program = programCache.get(octreeProgram.name, octreeProgram.stages);
+    std::cout << "GPU octree build : " << gpu_time_ms([&]() { build_octree_gpu(octreeProgram.program, worldDim); }) << " ms" << std::endl;
+    // distance_field.glsl assumes the window starts at chunk 0, in slot 0. A streamed one
+    // doesn't, its distance field is built on the host below and uploaded instead.
+    GLuint distanceComputeShader = compileComputeShader("distance_field.glsl");
+    if (!stream)
+        std::cout << "GPU distance field : " << gpu_time_ms([&]() { build_distance_field_gpu(distanceComputeShader, worldDim); }) << " ms" << std::endl;
+
+    build_distance_field(hostWorld, hostDistance);
+    if (stream) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, distanceSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, hostDistance.dist.size(), hostDistance.dist.data());
+    }
+    Scene hostScene(hostWorld);
+    hostScene.octree = &hostOctree;
+    hostScene.traversal = Traversal::Octree;
+
+    // --packed : the renderer reads palette packed voxels, the raw buffer was only
+    // needed for the builds above and shrinks to nothing
+    PackedVoxels hostPacked(worldDim);
+    if (packedVoxels) {
+        pack_world(hostWorld, hostPacked);
+        glGenBuffers(1, &buffers.packedChunks);
+        glGenBuffers(1, &buffers.packedPalettes);
+        glGenBuffers(1, &buffers.packedWords);
+        upload_packed_voxels(buffers, hostPacked);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, voxelSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Voxel), nullptr, GL_DYNAMIC_DRAW);
+        std::cout << "Packed voxels size:  " << hostPacked.byteSize() << " bytes, instead of " << total_voxel_size
+                  << " (x" << double(total_voxel_size) / hostPacked.byteSize() << ")" << std::endl;
     }
     
     std::cout << "Voxel buffer size:   " << total_voxel_size << " bytes" << std::endl;
-    std::cout << "Octree buffer size:  " << total_octree_size << " bytes" << std::endl;
+    std::cout << "Octree buffer size:  " << octreeSlots.byteSize() << " bytes, " << hostOctree.usedNodes() * sizeof(uint32_t)
+              << " in use (dense : " << dense_octree_size << ")" << std::endl;
+    std::cout << "Distance field size: " << total_distance_size << " bytes" << std::endl;
+
+    // Compare with --no-shader-cache (or an emptied cache directory) for the cold start
+    const ProgramCacheStats& programStats = programCache.stats();
+    std::cout << "Startup : " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count()
+              << " ms, shader programs " << programStats.ms << " ms (" << programStats.loaded << " from the cache, "
+              << programStats.compiled << " compiled";
+    if (programStats.rejected) std::cout << ", " << programStats.rejected << " cached binaries refused by the driver";
+    std::cout << ")" << std::endl;
     
 
     // =========== ! voxel SSBO ============
 
 
+    if (!benchmarkOutput.empty()) {
+        PathBenchmark result = benchmark_path_gpu(display.program, benchmarkPath, frames, outWidth, outHeight, renderScale,
+                                                  targetMs, RENDER_DEBUG, traversal, packedVoxels, worldDim);
+        glfwDestroyWindow(win);
+        glfwTerminate();
+        return report_path_benchmark(result, benchmarkOutput);
+    }
 
-
-
+    // --record-path : a key every CAMERA_PATH_RECORD_SECONDS, written on exit
+    CameraPath recordedPath;
+    double recordStart = glfwGetTime();
+    // --record : every frame, --replay : the frame to draw next and the hashes of the drawn ones
+    FrameLog recordLog;
+    recordLog.worldDim = worldDim;
+    double recordedSeconds = 0.0;
+    size_t replayFrame = 0, replayEdit = 0;
+    std::vector<uint64_t> frameHashes;
+    Image frameImage;
+    // Saving a .glsl file in --shader-dir rebuilds the programs using it, the world stays
+    ShaderWatcher shaderWatcher(shaderDir);
+
+    // --scale / --target-ms : raymarched offscreen at scaler.scale, then upscaled.
+    // --reproject draws offscreen too (at scale 1 without those), for its G-buffer
+    bool scaled = renderScale < 1.0f || targetMs > 0.0;
+    bool offscreen = scaled || reproject;
+    ResolutionScaler scaler(targetMs, renderScale);
+    GpuFrameTimer raymarchTimer;
+    SceneTargets sceneTargets;
+    LiveProgram upscale{"upscale.glsl", {}};
+    LiveProgram reprojectProgram{"reproject.glsl", {}};
+    Camera prevCam{camPos, camRot, 60.0f};
+    glm::ivec2 prevRenderSize(WIDTH, HEIGHT);
+    int frameIndex = 0;
+    if (offscreen) {
+        upscale.stages = upscale_shader_stages();
+        upscale.program = programCache.get(upscale.name, upscale.stages);
+    }
+    // The compute path writes into them even when the quad doesn't
+    if (offscreen || computeProgram.program) sceneTargets = create_scene_targets(WIDTH, HEIGHT, temporal && scaled, reproject);
+    if (reproject) {
+        reprojectProgram.stages = {{GL_COMPUTE_SHADER, load_shader_source(shader_path("reproject.glsl"))}};
+        reprojectProgram.program = programCache.get(reprojectProgram.name, reprojectProgram.stages);
+    }
+    // --cone : one texel per tile of the biggest frame
+    LiveProgram coneProgram{"cone.glsl", {}};
+    GLuint coneTex = 0;
+    if (cone) {
+        coneProgram.stages = {{GL_COMPUTE_SHADER, load_shader_source(shader_path("cone.glsl"))}};
+        coneProgram.program = programCache.get(coneProgram.name, coneProgram.stages);
+        glGenTextures(1, &coneTex);
+        glBindTexture(GL_TEXTURE_2D, coneTex);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, (WIDTH + CONE_TILE - 1) / CONE_TILE, (HEIGHT + CONE_TILE - 1) / CONE_TILE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    if (temporal && !scaled) std::cerr << "--temporal upscales, it needs --scale or --target-ms" << std::endl;
 
 
     while (!glfwWindowShouldClose(win)) {
 
-        glfwPollEvents();
+        {
+            PROFILE_SCOPE("events");
+            glfwPollEvents();
+        }
 
         // std::cout << "Position : " << camPos.x << "  " << camPos.y << "  " << camPos.z << std::endl;
 
@@ -291,92 +1632,107 @@ int main() {
         double curTime = glfwGetTime();
         float dt = curTime - lastTime;
         lastTime = curTime;
-
-
-        // FPS counter
-        frameTimes[frameIndex] = dt;
-        frameIndex = (frameIndex + 1) % FPS_SAMPLES;
-        if (frameIndex == 0) filled = true;
-        float sum = 0.0f;
-        int count = filled ? FPS_SAMPLES : frameIndex;
-        
-        for (int i = 0; i < count; ++i) {
-            sum += frameTimes[i];
+        // Replays step by the recording's frame time, whatever this frame took
+        if (replaying) dt = replayLog.dt;
+
+
+        // Frame time line, once a second : printing it every frame cost time and hid the spikes
+        framesSinceReport++;
+        if (curTime - lastReport >= FRAME_REPORT_SECONDS) {
+#ifdef SHADERDEMO_PROFILE
+            std::cout << Profiler::get().frameSummary();
+#else
+            std::cout << "Avg FPS : " << framesSinceReport / (curTime - lastReport);
+#endif
+            if (scaled) std::cout << " | scale " << scaler.scale;
+            std::cout << "    \r";
+            std::cout.flush();
+            lastReport = curTime;
+            framesSinceReport = 0;
         }
-        
-        float avgDt = sum / count;
-        float avgFps = 1.0f / avgDt;
-        
-        std::cout << "Avg FPS (last " << count << "): " << avgFps << "\r" ;
-        std::cout.flush();
-        // !FPS counter
 
         // ===================== I N P U T ===============================
-        
-        // ==== MOUSE =====
-        double xpos, ypos;
-        glfwGetCursorPos(win, &xpos, &ypos);
-
-        if (firstMouse) // First frame jump fix
-        {
-            lastX = xpos;
-            lastY = ypos;
-            firstMouse = false;
-        }
+        if (replaying) {
+            // The log drives the frame, the keyboard and mouse only get ESC
+            if (replayFrame == replayLog.frames.size() || glfwGetKey(win, GLFW_KEY_ESCAPE) == GLFW_PRESS) break;
+            const FrameLogRecord& r = replayLog.frames[replayFrame];
+            Camera cam = replayLog.camera(replayFrame++);
+            camPos = cam.pos;
+            camRot = cam.rot;
+            RENDER_DEBUG = r.renderDebug;
+            traversal = Traversal(r.traversal);
+        } else {
+            PROFILE_SCOPE("input");
+
+            // ==== MOUSE =====
+            double xpos, ypos;
+            glfwGetCursorPos(win, &xpos, &ypos);
+
+            if (firstMouse) // First frame jump fix
+            {
+                lastX = xpos;
+                lastY = ypos;
+                firstMouse = false;
+            }
     
-        // Calculate the mouse's movement since the last frame
-        float xoffset = xpos - lastX;
-        float yoffset = ypos - lastY; // Reversed since y-coordinates go from top to bottom
+            // Calculate the mouse's movement since the last frame
+            float xoffset = xpos - lastX;
+            float yoffset = ypos - lastY; // Reversed since y-coordinates go from top to bottom
     
-        // Update the last position for the next frame
-        lastX = xpos;
-        lastY = ypos;
+            // Update the last position for the next frame
+            lastX = xpos;
+            lastY = ypos;
     
-        camRot.y += xoffset * mouse_sensitivity; // Yaw
-        camRot.x += yoffset * mouse_sensitivity; // Pitch
+            camRot.y += xoffset * mouse_sensitivity; // Yaw
+            camRot.x += yoffset * mouse_sensitivity; // Pitch
 
-        camRot.y = fmod(camRot.y, glm::two_pi<float>());
-        if (camRot.y < 0.0f) {
-            camRot.y += glm::two_pi<float>();
-        }
+            camRot.y = fmod(camRot.y, glm::two_pi<float>());
+            if (camRot.y < 0.0f) {
+                camRot.y += glm::two_pi<float>();
+            }
     
-        // Your pitch clamping is still correct and necessary
-        camRot.x = glm::clamp(camRot.x, -glm::half_pi<float>() + 0.01f, glm::half_pi<float>() - 0.01f);
-        // glfwSetCursorPos(win, WIDTH / 2, HEIGHT / 2);
+            // Your pitch clamping is still correct and necessary
+            camRot.x = glm::clamp(camRot.x, -glm::half_pi<float>() + 0.01f, glm::half_pi<float>() - 0.01f);
+            // glfwSetCursorPos(win, WIDTH / 2, HEIGHT / 2);
         
-        // std::cout << "Pitch (X): " << camRot.x << ", Yaw (Y): " << camRot.y << std::endl;
-        // ============== !MOUSE
-
-        glm::vec3 right(
-            cos(camRot.y) * cos(camRot.x),
-            sin(camRot.x),
-            sin(camRot.y) * cos(camRot.x)  // ← negate if needed
-        );
-        glm::vec3 forward(
-            sin(camRot.y), 0, -cos(camRot.y) // original
-        );
-        // glm::vec3 up = glm::cross(right, forward);
-
-        glm::vec3 move(0.0f);
-        float speed_multiplier = 1.0;
-        if (glfwGetKey(win, GLFW_KEY_W) == GLFW_PRESS) move += glm::vec3 (forward[0], 0, forward[2]);
-        if (glfwGetKey(win, GLFW_KEY_S) == GLFW_PRESS) move -= glm::vec3 (forward[0], 0, forward[2]);
-        if (glfwGetKey(win, GLFW_KEY_A) == GLFW_PRESS) move -= glm::vec3 (right[0], 0, right[2]);
-        if (glfwGetKey(win, GLFW_KEY_D) == GLFW_PRESS) move += glm::vec3 (right[0], 0, right[2]);
-        if (glfwGetKey(win, GLFW_KEY_E) == GLFW_PRESS) move += glm::vec3 (0, 1, 0);
-        if (glfwGetKey(win, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) speed_multiplier = 7.0f;
-        if (glfwGetKey(win, GLFW_KEY_Q) == GLFW_PRESS) move -= glm::vec3 (0, 1, 0);
-        if (glm::length(move) > 0) camPos += glm::normalize(move) * cam_speed * dt * speed_multiplier;
-
-        if (glfwGetKey(win, GLFW_KEY_UP) == GLFW_PRESS){ 
-            RENDER_DEBUG = 0;
-        }
-        if (glfwGetKey(win, GLFW_KEY_DOWN) == GLFW_PRESS){ 
-            RENDER_DEBUG = 1;
+            // std::cout << "Pitch (X): " << camRot.x << ", Yaw (Y): " << camRot.y << std::endl;
+            // ============== !MOUSE
+
+            glm::vec3 right(
+                cos(camRot.y) * cos(camRot.x),
+                sin(camRot.x),
+                sin(camRot.y) * cos(camRot.x)  // ← negate if needed
+            );
+            glm::vec3 forward(
+                sin(camRot.y), 0, -cos(camRot.y) // original
+            );
+            // glm::vec3 up = glm::cross(right, forward);
+
+            glm::vec3 move(0.0f);
+            float speed_multiplier = 1.0;
+            if (glfwGetKey(win, GLFW_KEY_W) == GLFW_PRESS) move += glm::vec3 (forward[0], 0, forward[2]);
+            if (glfwGetKey(win, GLFW_KEY_S) == GLFW_PRESS) move -= glm::vec3 (forward[0], 0, forward[2]);
+            if (glfwGetKey(win, GLFW_KEY_A) == GLFW_PRESS) move -= glm::vec3 (right[0], 0, right[2]);
+            if (glfwGetKey(win, GLFW_KEY_D) == GLFW_PRESS) move += glm::vec3 (right[0], 0, right[2]);
+            if (glfwGetKey(win, GLFW_KEY_E) == GLFW_PRESS) move += glm::vec3 (0, 1, 0);
+            if (glfwGetKey(win, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) speed_multiplier = 7.0f;
+            if (glfwGetKey(win, GLFW_KEY_Q) == GLFW_PRESS) move -= glm::vec3 (0, 1, 0);
+            if (glm::length(move) > 0) camPos += glm::normalize(move) * cam_speed * dt * speed_multiplier;
+
+            if (glfwGetKey(win, GLFW_KEY_UP) == GLFW_PRESS){ 
+                RENDER_DEBUG = 0;
+            }
+            if (glfwGetKey(win, GLFW_KEY_DOWN) == GLFW_PRESS){ 
+                RENDER_DEBUG = 1;
+            }
+            if (glfwGetKey(win, GLFW_KEY_1) == GLFW_PRESS) traversal = Traversal::Dda;
+            if (glfwGetKey(win, GLFW_KEY_2) == GLFW_PRESS) traversal = Traversal::Octree;
+            if (glfwGetKey(win, GLFW_KEY_3) == GLFW_PRESS) traversal = Traversal::Chunks;
+            if (glfwGetKey(win, GLFW_KEY_4) == GLFW_PRESS) traversal = Traversal::Distance;
+
+            if (glfwGetKey(win, GLFW_KEY_ESCAPE) == GLFW_PRESS) break; // quit
         }
 
-        if (glfwGetKey(win, GLFW_KEY_ESCAPE) == GLFW_PRESS) return 0; // quit
-
 
         // std::cout <<  "Position : " << camPos.x << ", " << camPos.y << ", " << camPos.z << std::endl;
         // std::cout.flush();
@@ -384,23 +1740,215 @@ int main() {
         // ===================== ! I N P U T ===============================
 
 
+        if (!recordLogFile.empty()) {
+            recordLog.add(Camera{camPos, camRot, 60.0f}, RENDER_DEBUG, traversal);
+            recordedSeconds += dt;
+        }
+
+        if (streamer) {
+            stream_world(*streamer, streamUploads, camPos, hostWorld, hostOctree, octreeSlots, hostDistance,
+                         packedVoxels ? &hostPacked : nullptr, buffers);
+        }
+
+        // Between two frames, only the program objects change : the SSBOs stay bound to their
+        // binding points, whatever program reads them next. A broken shader keeps the old one.
+        if (shaderWatcher.changed()) {
+            PROFILE_SCOPE("shader reload");
+            try {
+                if (programCache.reload(display, display_shader_stages())) setup_raymarch_program(display.program, displayUniforms);
+                if (computeProgram.program &&
+                    programCache.reload(computeProgram, {{GL_COMPUTE_SHADER, load_shader_source(shader_path("raymarch_compute.glsl"))}}))
+                    setup_raymarch_program(computeProgram.program, computeUniforms);
+                programCache.reload(octreeProgram, {{GL_COMPUTE_SHADER, load_shader_source(shader_path("build_octree.glsl"))}});
+                if (offscreen) programCache.reload(upscale, upscale_shader_stages());
+                if (reproject) programCache.reload(reprojectProgram, {{GL_COMPUTE_SHADER, load_shader_source(shader_path("reproject.glsl"))}});
+                if (cone) programCache.reload(coneProgram, {{GL_COMPUTE_SHADER, load_shader_source(shader_path("cone.glsl"))}});
+            } catch (const std::exception& e) {
+                std::cerr << "\n" << e.what() << std::endl;
+            }
+        }
+
         // Rendering
-        glClear(GL_COLOR_BUFFER_BIT);
-        glUseProgram(shader);
-        glUniform2f(locRes, WIDTH, HEIGHT);
-        glUniform3f(locCamPos, camPos.x, camPos.y, camPos.z);
-        glUniform3f(locCamRot, camRot.x, camRot.y, 0.0);
-        glUniform1i(RENDER_DEBUGLoc, RENDER_DEBUG);
-        glUniform1f(locFOV, 60.0f);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        Camera cam{camPos, camRot, 60.0f};
+        glm::ivec2 renderSize(WIDTH, HEIGHT);
+        glm::vec2 jitter(0.0f);
+        if (scaled) {
+            renderSize = scaled_resolution(WIDTH, HEIGHT, scaler.scale);
+            if (temporal) jitter = temporal_jitter(frameIndex);
+        }
+        if (reproject) {
+            PROFILE_SCOPE("reproject");
+            PROFILE_GPU_SCOPE("reproject");
+            reproject_gpu(reprojectProgram.program, sceneTargets, prevRenderSize, renderSize, cam);
+        }
+        if (cone) {
+            PROFILE_SCOPE("cone");
+            PROFILE_GPU_SCOPE("cone");
+            cone_prepass_gpu(coneProgram.program, coneTex, renderSize, cam, hostWorld, packedVoxels);
+        }
+        if (offscreen) {
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneTargets.sceneFbo);
+            glViewport(0, 0, renderSize.x, renderSize.y);
+        }
+        {
+            PROFILE_SCOPE("uniforms");
+            const RaymarchUniforms& u = computeRender ? computeUniforms : displayUniforms;
+            if (!computeRender) glClear(GL_COLOR_BUFFER_BIT);
+            glUseProgram(computeRender ? computeProgram.program : display.program);
+            glUniform2f(u.res, (float)renderSize.x, (float)renderSize.y);
+            glUniform2f(u.jitter, jitter.x, jitter.y);
+            glUniform1i(u.reproject, reproject ? 1 : 0);
+            glUniform1i(u.cone, cone ? 1 : 0);
+            if (cone) {
+                glActiveTexture(GL_TEXTURE4);
+                glBindTexture(GL_TEXTURE_2D, coneTex);
+                glActiveTexture(GL_TEXTURE0);
+            }
+            if (reproject) {
+                glActiveTexture(GL_TEXTURE3);
+                glBindTexture(GL_TEXTURE_2D, sceneTargets.tStartTex);
+                glActiveTexture(GL_TEXTURE0);
+            }
+            glUniform3f(u.camPos, camPos.x, camPos.y, camPos.z);
+            glUniform3f(u.camRot, camRot.x, camRot.y, 0.0);
+            glUniform1i(u.renderDebug, RENDER_DEBUG);
+            glUniform1i(u.traversalMode, (int)traversal);
+            glUniform1i(u.voxelFormat, packedVoxels ? 1 : 0);
+            glUniform3i(u.worldOrigin, hostWorld.origin.x, hostWorld.origin.y, hostWorld.origin.z);
+            glUniform3i(u.worldOriginSlot, hostWorld.originSlot.x, hostWorld.originSlot.y, hostWorld.originSlot.z);
+            glUniform1f(u.fov, 60.0f);
+        }
+        if (computeRender) {
+            PROFILE_SCOPE("draw compute");
+            PROFILE_GPU_SCOPE("draw compute");
+            if (scaled) raymarchTimer.begin(scaler.scale);
+            raymarch_compute_gpu(computeProgram.program, sceneTargets, tileQueue, computeGroups);
+            if (scaled) raymarchTimer.end();
+            if (!offscreen) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneTargets.sceneFbo);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+                glBlitFramebuffer(0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            }
+        } else {
+            PROFILE_SCOPE("draw");
+            PROFILE_GPU_SCOPE("draw");
+            if (scaled) raymarchTimer.begin(scaler.scale);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            if (scaled) raymarchTimer.end();
+        }
+        if (offscreen) {
+            PROFILE_SCOPE("upscale");
+            PROFILE_GPU_SCOPE("upscale");
+            upscale_frame(upscale.program, sceneTargets, renderSize, jitter, cam, prevCam);
+            sceneTargets.hitsValid = reproject;
+
+            double ms;
+            float frameScale;
+            if (targetMs > 0.0 && raymarchTimer.result(ms, frameScale)) scaler.update(ms, frameScale);
+        }
+        prevCam = cam;
+        prevRenderSize = renderSize;
+        frameIndex++;
+        if (replaying && (!hashFramesFile.empty() || !checkHashesFile.empty())) {
+            PROFILE_SCOPE("hash frame");
+            read_framebuffer(frameImage, WIDTH, HEIGHT);
+            frameHashes.push_back(hash_image(frameImage));
+        }
+
+        // P : grab this frame and render the same camera on the CPU for comparison
+        bool capturePressed = !replaying && glfwGetKey(win, GLFW_KEY_P) == GLFW_PRESS;
+        if (capturePressed && !captureHeld) {
+            capture_reference_frames(buffers, worldDim, hostWorld.origin, packedVoxels ? &hostPacked : nullptr,
+                                     Camera{camPos, camRot, 60.0f}, RENDER_DEBUG, traversal);
+        }
+        captureHeld = capturePressed;
+
+        // O : rebuild the whole octree, to time it
+        bool rebuildPressed = !replaying && glfwGetKey(win, GLFW_KEY_O) == GLFW_PRESS;
+        if (rebuildPressed && !rebuildHeld && packedVoxels) {
+            std::cout << "\nThe GPU octree build reads the raw voxel buffer, not there with --packed" << std::endl;
+        } else if (rebuildPressed && !rebuildHeld) {
+            double ms = gpu_time_ms([&]() { build_octree_gpu(octreeProgram.program, worldDim); });
+            std::cout << "\nGPU octree rebuild : " << ms << " ms" << std::endl;
+        }
+        rebuildHeld = rebuildPressed;
+
+        // C switches the primary rays between the fragment shader and the compute path,
+        // the profiler shows them as "draw" and "draw compute"
+        bool computePressed = !replaying && glfwGetKey(win, GLFW_KEY_C) == GLFW_PRESS;
+        if (computePressed && !computeHeld && computeProgram.program) {
+            computeRender = !computeRender;
+            std::cout << "\nPrimary rays : " << (computeRender ? "compute" : "fragment") << std::endl;
+        }
+        computeHeld = computePressed;
+
+        // Left click digs a 3x3x3 hole where the screen center points, right click places
+        // stone. --record logs the box, --replay fills it again after the same frame.
+        bool digPressed = !replaying && glfwGetMouseButton(win, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        bool placePressed = !replaying && glfwGetMouseButton(win, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+        bool edited = false;
+        if ((digPressed && !digHeld) || (placePressed && !placeHeld)) {
+            glm::ivec3 hit, front;
+            if (pick_voxel(hostScene, Camera{camPos, camRot, 60.0f}, hit, front)) {
+                bool dig = digPressed && !digHeld;
+                glm::ivec3 boxMin = dig ? hit - 1 : front, boxMax = dig ? hit + 1 : front;
+                uint32_t material = dig ? 0u : 1u;
+                hostWorld.fillBox(boxMin, boxMax, material);
+                if (!recordLogFile.empty()) recordLog.addEdit(boxMin, boxMax, material);
+                edited = true;
+            }
+        }
+        if (replaying) edited = replayLog.applyEdits(replayFrame - 1, replayEdit, hostWorld) > 0;
+        if (edited) {
+            PROFILE_SCOPE("edits");
+            apply_edits(hostWorld, hostOctree, octreeSlots, hostDistance, packedVoxels ? &hostPacked : nullptr, buffers);
+            // Last frame's hits may be dug out now, or in front of new stone
+            sceneTargets.hitsValid = false;
+        }
+        digHeld = digPressed;
+        placeHeld = placePressed;
+
 
 
 
+        if (!recordPathFile.empty()) {
+            double t = glfwGetTime() - recordStart;
+            if (recordedPath.keys.empty() || t - recordedPath.keys.back().time >= CAMERA_PATH_RECORD_SECONDS)
+                recordedPath.keys.push_back(CameraKey{t, camPos, camRot});
+        }
+
+        {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(win);
+        }
+        PROFILE_FRAME();
+    }
 
+    if (!recordPathFile.empty() && !recordedPath.keys.empty()) {
+        save_camera_path(recordedPath, recordPathFile);
+        std::cout << "\nRecorded " << recordedPath.keys.size() << " camera keys over " << recordedPath.duration()
+                  << " s => " << recordPathFile << std::endl;
+    }
 
-        glfwSwapBuffers(win);
+    if (!recordLogFile.empty() && !recordLog.frames.empty()) {
+        recordLog.dt = float(recordedSeconds / recordLog.frames.size());
+        save_frame_log(recordLog, recordLogFile);
+        std::cout << "\nRecorded " << recordLog.frames.size() << " frames => " << recordLogFile << std::endl;
     }
+    int exitCode = 0;
+    if (replaying) {
+        std::cout << "\nReplayed " << replayFrame << " of " << replayLog.frames.size() << " frames" << std::endl;
+        exitCode = finish_frame_hashes(frameHashes, hashFramesFile, checkHashesFile);
+    }
+
+#ifdef SHADERDEMO_PROFILE
+    std::cout << "\nProfiler :" << std::endl;
+    Profiler::get().report(std::cout);
+    if (!profileTracePath.empty()) Profiler::get().writeTrace(profileTracePath);
+#endif
 
     glfwDestroyWindow(win);
     glfwTerminate();
+    return exitCode;
 }
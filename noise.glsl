@@ -0,0 +1,48 @@
+// Terrain constants and the hash-based fbm, shared by heightmap.glsl and voxel.glsl.
+// worldgen.cpp is the CPU copy, keep the two in sync.
+
+// ====== CONSTANTS ======
+const float oceanLevel = 32.0;
+const float scale = 80.0;
+const int octaves = 4;
+const float persistence = 0.5;
+const float lacunarity = 2.0;
+
+const float terrainHeightScale = 50.0;
+const float terrainBaseHeight = oceanLevel - 20.0;
+
+// ====== Hash-based noise ======
+float hash(vec2 p) {
+    return fract(sin(dot(p, vec2(127.1, 311.7))) * 43758.5453);
+}
+
+float noise(vec2 p) {
+    vec2 i = floor(p);
+    vec2 f = fract(p);
+
+    float a = hash(i);
+    float b = hash(i + vec2(1.0, 0.0));
+    float c = hash(i + vec2(0.0, 1.0));
+    float d = hash(i + vec2(1.0, 1.0));
+
+    vec2 u = f * f * (3.0 - 2.0 * f);
+    return mix(a, b, u.x) +
+           (c - a) * u.y * (1.0 - u.x) +
+           (d - b) * u.x * u.y;
+}
+
+float fbm(vec2 p) {
+    float total = 0.0;
+    float amplitude = 1.0;
+    float frequency = 1.0;
+    float maxValue = 0.0;
+
+    for (int i = 0; i < octaves; i++) {
+        total += noise(p * frequency) * amplitude;
+        maxValue += amplitude;
+        amplitude *= persistence;
+        frequency *= lacunarity;
+    }
+
+    return total / maxValue;
+}
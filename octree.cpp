@@ -0,0 +1,264 @@
+#include "octree.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+
+// Spreads the low 5 bits of v to every third bit
+static inline uint32_t spread_bits(uint32_t v) {
+    v &= 0x3FFu;
+    v = (v | (v << 16)) & 0x030000FFu;
+    v = (v | (v << 8)) & 0x0300F00Fu;
+    v = (v | (v << 4)) & 0x030C30C3u;
+    v = (v | (v << 2)) & 0x09249249u;
+    return v;
+}
+
+uint32_t octree_morton(int x, int y, int z) {
+    return spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2);
+}
+
+
+static int pyramid_level(uint32_t index) {
+    int level = 0;
+    while (level < OCTREE_LEVELS && index >= octree_level_offset(level + 1)) level++;
+    return level;
+}
+
+
+OctreeWorld::OctreeWorld(glm::ivec3 dim)
+    : dim(dim),
+      pyramid((size_t)dim.x * dim.y * dim.z * OCTREE_NODES_PER_CHUNK, 0u),
+      nodes((size_t)dim.x * dim.y * dim.z * OCTREE_NODES_PER_CHUNK, OCTREE_LEAF),
+      nodeCounts((size_t)dim.x * dim.y * dim.z, 1u) {}
+
+
+uint32_t OctreeWorld::lookup(const VoxelWorld& world, glm::ivec3 pos, int& nodeSize) const {
+    glm::ivec3 chunkCoord(
+        floor_div(pos.x, CHUNK_SIZE),
+        floor_div(pos.y, CHUNK_SIZE),
+        floor_div(pos.z, CHUNK_SIZE)
+    );
+
+    nodeSize = 1;
+    if (!world.containsChunk(chunkCoord)) return 0u;
+
+    glm::ivec3 local = pos - chunkCoord * CHUNK_SIZE;
+    const uint32_t* chunkNodes = &nodes[(size_t)world.chunkIndex(chunkCoord) * OCTREE_NODES_PER_CHUNK];
+
+    uint32_t node = chunkNodes[0];
+    nodeSize = CHUNK_SIZE;
+    while ((node & OCTREE_LEAF) == 0u) {
+        nodeSize >>= 1;
+        uint32_t octant = ((local.x & nodeSize) ? 1u : 0u) | ((local.y & nodeSize) ? 2u : 0u) | ((local.z & nodeSize) ? 4u : 0u);
+        uint32_t childMask = node & 0xFFu;
+        if ((childMask & (1u << octant)) == 0u) return 0u;
+
+        uint32_t first = (node >> 8) & 0x7FFFFFu;
+        node = chunkNodes[first + __builtin_popcount(childMask & ((1u << octant) - 1u))];
+    }
+    return node & ~OCTREE_LEAF;
+}
+
+
+size_t OctreeWorld::usedNodes() const {
+    return std::accumulate(nodeCounts.begin(), nodeCounts.end(), size_t(0));
+}
+
+
+void build_pyramid_leaves(const Voxel* chunkVoxels, uint32_t* pyramid) {
+    uint32_t* leaves = pyramid + octree_level_offset(OCTREE_LEVELS);
+    // The leaves are the Morton layout itself
+    if (VOXEL_LAYOUT == LAYOUT_MORTON) {
+        std::memcpy(leaves, chunkVoxels, CHUNK_VOXELS * sizeof(Voxel));
+        return;
+    }
+    for (int z = 0; z < CHUNK_SIZE; ++z)
+    for (int y = 0; y < CHUNK_SIZE; ++y)
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        leaves[octree_morton(x, y, z)] = chunkVoxels[chunk_local_index(glm::ivec3(x, y, z))].material;
+    }
+}
+
+
+void reduce_pyramid_level(uint32_t* pyramid, int level, uint32_t begin, uint32_t end) {
+    uint32_t* parents = pyramid + octree_level_offset(level);
+    const uint32_t* children = pyramid + octree_level_offset(level + 1);
+
+    for (uint32_t n = begin; n < end; ++n) {
+        const uint32_t* c = children + n * 8;
+        uint32_t value = c[0];
+        for (int i = 1; i < 8; ++i)
+            if (c[i] != value) value = OCTREE_MIXED;
+        parents[n] = value;
+    }
+}
+
+
+void build_chunk_pyramid(const Voxel* chunkVoxels, uint32_t* pyramid) {
+    build_pyramid_leaves(chunkVoxels, pyramid);
+    for (int level = OCTREE_LEVELS - 1; level >= 0; --level)
+        reduce_pyramid_level(pyramid, level, 0, 1u << (3 * level));
+}
+
+
+uint32_t emit_sparse_chunk(const uint32_t* pyramid, uint32_t* nodes) {
+    // Breadth first, straight in the output : a slot first holds the pyramid index
+    // of its node, and gets overwritten by the encoded node once its children are queued
+    nodes[0] = 0;
+    uint32_t write = 1;
+
+    for (uint32_t read = 0; read < write; ++read) {
+        uint32_t p = nodes[read];
+        uint32_t value = pyramid[p];
+        if (value != OCTREE_MIXED) {
+            nodes[read] = OCTREE_LEAF | value;
+            continue;
+        }
+
+        int level = pyramid_level(p);
+        uint32_t childBase = octree_level_offset(level + 1) + (p - octree_level_offset(level)) * 8;
+        uint32_t childMask = 0;
+        uint32_t first = write;
+        for (uint32_t c = 0; c < 8; ++c) {
+            if (pyramid[childBase + c] != 0u) {
+                childMask |= 1u << c;
+                nodes[write++] = childBase + c;
+            }
+        }
+        nodes[read] = childMask | (first << 8);
+    }
+
+    return write;
+}
+
+
+void build_octree_chunk(const VoxelWorld& world, OctreeWorld& octree, int chunkIndex) {
+    size_t slot = (size_t)chunkIndex * OCTREE_NODES_PER_CHUNK;
+    build_chunk_pyramid(world.voxels.data() + (size_t)chunkIndex * CHUNK_VOXELS, &octree.pyramid[slot]);
+    octree.nodeCounts[chunkIndex] = emit_sparse_chunk(&octree.pyramid[slot], &octree.nodes[slot]);
+}
+
+
+void build_octree(const VoxelWorld& world, OctreeWorld& octree, int threads) {
+    parallel_for((int)world.chunkCount(), threads, [&](int chunkIndex) {
+        build_octree_chunk(world, octree, chunkIndex);
+    });
+}
+
+
+// Returns true when anything of the chunk's pyramid changed
+static bool update_chunk_pyramid(const VoxelWorld& world, uint32_t* pyramid, int chunkIndex,
+                                 const uint32_t* dirtyBegin, const uint32_t* dirtyEnd) {
+    const Voxel* chunkVoxels = world.voxels.data() + (size_t)chunkIndex * CHUNK_VOXELS;
+    uint32_t* leaves = pyramid + octree_level_offset(OCTREE_LEVELS);
+
+    // Level-local indices of the nodes that changed, leaves first
+    std::vector<uint32_t> changed;
+    for (const uint32_t* d = dirtyBegin; d != dirtyEnd; ++d) {
+        uint32_t local = *d - (uint32_t)chunkIndex * CHUNK_VOXELS;
+        glm::ivec3 p = chunk_local_coord((int)local);
+        uint32_t leaf = octree_morton(p.x, p.y, p.z);
+        if (leaves[leaf] != chunkVoxels[local].material) {
+            leaves[leaf] = chunkVoxels[local].material;
+            changed.push_back(leaf);
+        }
+    }
+    if (changed.empty()) return false;
+
+    for (int level = OCTREE_LEVELS - 1; level >= 0 && !changed.empty(); --level) {
+        for (uint32_t& n : changed) n >>= 3;
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+        uint32_t* parents = pyramid + octree_level_offset(level);
+        size_t kept = 0;
+        for (uint32_t n : changed) {
+            uint32_t before = parents[n];
+            reduce_pyramid_level(pyramid, level, n, n + 1);
+            if (parents[n] != before) changed[kept++] = n;
+        }
+        changed.resize(kept);
+    }
+    return true;
+}
+
+
+std::vector<int> update_octree(const VoxelWorld& world, OctreeWorld& octree,
+                               const std::vector<uint32_t>& dirtyVoxels, int threads) {
+    std::vector<uint32_t> dirty(dirtyVoxels);
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    // Sorted indices => each chunk's voxels are one contiguous run
+    std::vector<size_t> runStarts;
+    for (size_t i = 0; i < dirty.size(); ++i) {
+        if (i == 0 || dirty[i] / CHUNK_VOXELS != dirty[i - 1] / CHUNK_VOXELS) runStarts.push_back(i);
+    }
+    runStarts.push_back(dirty.size());
+
+    int runs = (int)runStarts.size() - 1;
+    std::vector<char> touched(runs, 0);
+    parallel_for(runs, threads, [&](int r) {
+        const uint32_t* begin = dirty.data() + runStarts[r];
+        const uint32_t* end = dirty.data() + runStarts[r + 1];
+        int chunkIndex = int(*begin / CHUNK_VOXELS);
+        size_t slot = (size_t)chunkIndex * OCTREE_NODES_PER_CHUNK;
+
+        if (update_chunk_pyramid(world, &octree.pyramid[slot], chunkIndex, begin, end)) {
+            octree.nodeCounts[chunkIndex] = emit_sparse_chunk(&octree.pyramid[slot], &octree.nodes[slot]);
+            touched[r] = 1;
+        }
+    });
+
+    std::vector<int> chunks;
+    for (int r = 0; r < runs; ++r)
+        if (touched[r]) chunks.push_back(int(dirty[runStarts[r]] / CHUNK_VOXELS));
+    return chunks;
+}
+
+
+static uint32_t slot_capacity(uint32_t nodeCount) {
+    return (nodeCount + OCTREE_SLOT_ROUND - 1) / OCTREE_SLOT_ROUND * OCTREE_SLOT_ROUND;
+}
+
+void layout_octree_slots(const OctreeWorld& octree, OctreeSlots& slots) {
+    slots.offsets.resize(octree.nodeCounts.size());
+    slots.capacity.resize(octree.nodeCounts.size());
+    slots.size = 0;
+    for (size_t c = 0; c < octree.nodeCounts.size(); ++c) {
+        slots.offsets[c] = (uint32_t)slots.size;
+        slots.capacity[c] = slot_capacity(octree.nodeCounts[c]);
+        slots.size += slots.capacity[c];
+    }
+}
+
+
+bool fit_octree_slots(const OctreeWorld& octree, OctreeSlots& slots, const std::vector<int>& chunks) {
+    bool moved = false;
+    for (int c : chunks) {
+        if (octree.nodeCounts[c] <= slots.capacity[c]) continue;
+        // Outgrew it : new one at the end, the old one is dead space
+        slots.offsets[c] = (uint32_t)slots.size;
+        slots.capacity[c] = slot_capacity(octree.nodeCounts[c]);
+        slots.size += slots.capacity[c];
+        moved = true;
+    }
+
+    // Too many dead slots, start over
+    size_t live = std::accumulate(slots.capacity.begin(), slots.capacity.end(), size_t(0));
+    if (moved && slots.size > 2 * live + OCTREE_NODES_PER_CHUNK) layout_octree_slots(octree, slots);
+    return moved;
+}
+
+
+std::vector<uint32_t> slotted_nodes(const OctreeWorld& octree, const OctreeSlots& slots) {
+    std::vector<uint32_t> out(slots.size, OCTREE_LEAF);
+    for (size_t c = 0; c < octree.nodeCounts.size(); ++c) {
+        const uint32_t* chunkNodes = &octree.nodes[c * OCTREE_NODES_PER_CHUNK];
+        std::copy(chunkNodes, chunkNodes + octree.nodeCounts[c], &out[slots.offsets[c]]);
+    }
+    return out;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Sparse voxel octree, one per chunk. CPU twin of build_octree.glsl : the pyramid below
+// has the exact layout of its scratch buffer, the sparse nodes of a chunk are the same
+// as in octreeSSBO, which packs them (OctreeSlots at the bottom).
+//
+// Build happens in two steps :
+//  - pyramid : dense, every level of the chunk in Morton order (children of node n
+//    of a level are nodes 8n..8n+7 of the next one). A node holds the material when
+//    its whole region is that material (0 = air) or OCTREE_MIXED.
+//  - sparse nodes, emitted breadth first from the pyramid :
+//      leaf     : OCTREE_LEAF | material, the whole node region is that material
+//      interior : bits 0-7 child mask (non-air children), bits 8-30 index of the
+//                 first child in the chunk slot. Only non-air children are stored,
+//                 child c is at first + bitCount(mask & ((1 << c) - 1)).
+//    The root is always the first node of the chunk slot.
+//
+// Octant / child index : bit 0 = x, bit 1 = y, bit 2 = z (upper half).
+
+const int OCTREE_LEVELS = 5;                        // log2(CHUNK_SIZE), level 0 = whole chunk
+const size_t OCTREE_NODES_PER_CHUNK = 37449;        // (8^(levels+1) - 1) / 7, also the sparse worst case
+const uint32_t OCTREE_MIXED = CHUNK_MIXED;          // so a pyramid root is the chunk occupancy
+const uint32_t OCTREE_LEAF = 0x80000000u;
+
+static_assert((1 << OCTREE_LEVELS) == CHUNK_SIZE, "octree depth must match the chunk size");
+
+// First pyramid node of a level
+inline uint32_t octree_level_offset(int level) {
+    return ((1u << (3 * level)) - 1u) / 7u;
+}
+
+// Morton index of a node at the leaf level (5 bits per axis)
+uint32_t octree_morton(int x, int y, int z);
+
+
+struct OctreeWorld {
+    glm::ivec3 dim;                     // in chunks, same as the VoxelWorld
+    std::vector<uint32_t> pyramid;      // OCTREE_NODES_PER_CHUNK per chunk
+    std::vector<uint32_t> nodes;        // OCTREE_NODES_PER_CHUNK per chunk, sparse nodes at the start of each slot
+    std::vector<uint32_t> nodeCounts;   // sparse nodes used per chunk
+
+    explicit OctreeWorld(glm::ivec3 dim = WORLD_DIM);
+
+    // Material of the voxel at pos, and size of the biggest uniform node containing it.
+    // Outside of the world's window : air, size 1.
+    uint32_t lookup(const VoxelWorld& world, glm::ivec3 pos, int& nodeSize) const;
+
+    size_t usedNodes() const;
+};
+
+
+// Pyramid leaves of one chunk, straight from its voxels (GPU pass 0)
+void build_pyramid_leaves(const Voxel* chunkVoxels, uint32_t* pyramid);
+
+// Nodes [begin, end) of one pyramid level from their 8 children in level + 1 (GPU pass 1)
+void reduce_pyramid_level(uint32_t* pyramid, int level, uint32_t begin, uint32_t end);
+
+// Leaves, then every level bottom-up
+void build_chunk_pyramid(const Voxel* chunkVoxels, uint32_t* pyramid);
+
+// Emits the sparse nodes of one chunk from its pyramid, returns the node count (GPU pass 2)
+uint32_t emit_sparse_chunk(const uint32_t* pyramid, uint32_t* nodes);
+
+void build_octree_chunk(const VoxelWorld& world, OctreeWorld& octree, int chunkIndex);
+
+// Whole world, chunks spread over `threads` workers (0 = all cores)
+void build_octree(const VoxelWorld& world, OctreeWorld& octree, int threads = 0);
+
+// Incremental rebuild after edits (VoxelWorld::dirtyVoxels) : the leaves of the dirty
+// voxels, then only their ancestors, stopping as soon as a node keeps its value, then
+// the sparse nodes of the chunks that changed. Returns those chunk indices, sorted.
+std::vector<int> update_octree(const VoxelWorld& world, OctreeWorld& octree,
+                               const std::vector<uint32_t>& dirtyVoxels, int threads = 0);
+
+
+// What octreeSSBO actually holds : the sparse nodes of every chunk back to back instead
+// of OCTREE_NODES_PER_CHUNK each, chunk c from offsets[c] (binding 11, the lookups add it
+// to the node indices). Each chunk owns a slot of `capacity` nodes, rounded up so an edit
+// usually still fits, otherwise the chunk moves to a new slot at the end (as PackedVoxels).
+const uint32_t OCTREE_SLOT_ROUND = 64;
+
+struct OctreeSlots {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> capacity;     // host only
+    size_t size = 0;                    // nodes, slots and the dead ones left behind
+
+    size_t byteSize() const { return size * sizeof(uint32_t); }
+};
+
+// Fresh slots for the octree's current node counts, tightly packed
+void layout_octree_slots(const OctreeWorld& octree, OctreeSlots& slots);
+
+// Moves the `chunks` that outgrew their slot. Returns true when the layout changed (the
+// whole buffer needs uploading then, otherwise only the slots of `chunks`).
+bool fit_octree_slots(const OctreeWorld& octree, OctreeSlots& slots, const std::vector<int>& chunks);
+
+// The sparse nodes in that layout, the whole octreeSSBO
+std::vector<uint32_t> slotted_nodes(const OctreeWorld& octree, const OctreeSlots& slots);
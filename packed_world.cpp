@@ -0,0 +1,155 @@
+#include "packed_world.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+
+PackedVoxels::PackedVoxels(glm::ivec3 dim)
+    : dim(dim),
+      chunkInfo((size_t)dim.x * dim.y * dim.z * PACKED_INFO_STRIDE, 0u),
+      paletteCapacity((size_t)dim.x * dim.y * dim.z, 0u),
+      wordCapacity((size_t)dim.x * dim.y * dim.z, 0u) {}
+
+
+uint32_t packed_width(size_t paletteSize) {
+    if (paletteSize <= 1) return 0;
+    if (paletteSize <= 2) return 1;
+    if (paletteSize <= 4) return 2;
+    if (paletteSize <= 16) return 4;
+    if (paletteSize <= 256) return 8;
+    if (paletteSize <= 65536) return 16;
+    throw std::runtime_error("More than 65536 materials in one chunk");
+}
+
+
+static uint32_t word_count(uint32_t bits) {
+    return uint32_t(CHUNK_VOXELS * bits / 32);
+}
+
+
+// Room for every index the width can address, past 8 bits only rounded up so a
+// 16 bit chunk doesn't get a 64K entry palette
+static uint32_t palette_capacity(uint32_t bits, size_t paletteSize) {
+    if (bits <= 8) return 1u << bits;
+    return uint32_t((paletteSize + 255) / 256 * 256);
+}
+
+
+// Materials of a chunk in order of first appearance, and each voxel's index in them
+// when `indices` isn't null. Runs of the same material are the common case.
+static void build_chunk_palette(const Voxel* chunkVoxels, std::vector<uint32_t>& palette, uint16_t* indices) {
+    palette.assign(1, chunkVoxels[0].material);
+    uint32_t lastMaterial = chunkVoxels[0].material;
+    uint16_t lastIndex = 0;
+
+    for (size_t i = 0; i < CHUNK_VOXELS; ++i) {
+        uint32_t material = chunkVoxels[i].material;
+        if (material != lastMaterial) {
+            auto it = std::find(palette.begin(), palette.end(), material);
+            if (it == palette.end()) {
+                if (palette.size() == 65536) throw std::runtime_error("More than 65536 materials in one chunk");
+                it = palette.insert(palette.end(), material);
+            }
+            lastMaterial = material;
+            lastIndex = uint16_t(it - palette.begin());
+        }
+        if (indices) indices[i] = lastIndex;
+    }
+}
+
+
+static void write_words(const uint16_t* indices, uint32_t bits, uint32_t* out) {
+    if (bits == 0) return;
+    const uint32_t perWord = 32 / bits;
+    for (uint32_t w = 0; w < word_count(bits); ++w) {
+        const uint16_t* in = indices + (size_t)w * perWord;
+        uint32_t word = 0;
+        for (uint32_t k = 0; k < perWord; ++k) word |= uint32_t(in[k]) << (k * bits);
+        out[w] = word;
+    }
+}
+
+
+// Chunk c into its current slot, which must be big enough
+static void write_chunk(PackedVoxels& packed, int c, const std::vector<uint32_t>& palette, const uint16_t* indices) {
+    uint32_t* info = &packed.chunkInfo[(size_t)c * PACKED_INFO_STRIDE];
+    uint32_t bits = packed_width(palette.size());
+    info[2] = bits;
+    info[3] = (uint32_t)palette.size();
+    std::copy(palette.begin(), palette.end(), packed.palettes.begin() + info[1]);
+    write_words(indices, bits, &packed.words[info[0]]);
+}
+
+
+void pack_world(const VoxelWorld& world, PackedVoxels& packed, int threads) {
+    const int chunkCount = (int)world.chunkCount();
+    packed = PackedVoxels(world.dim);
+
+    // Palettes first, for the slot sizes
+    std::vector<std::vector<uint32_t>> palettes(chunkCount);
+    parallel_for(chunkCount, threads, [&](int c) {
+        build_chunk_palette(world.voxels.data() + (size_t)c * CHUNK_VOXELS, palettes[c], nullptr);
+    });
+
+    size_t paletteOffset = 0, wordOffset = 0;
+    for (int c = 0; c < chunkCount; ++c) {
+        uint32_t bits = packed_width(palettes[c].size());
+        uint32_t* info = &packed.chunkInfo[(size_t)c * PACKED_INFO_STRIDE];
+        info[0] = (uint32_t)wordOffset;
+        info[1] = (uint32_t)paletteOffset;
+        packed.wordCapacity[c] = word_count(bits);
+        packed.paletteCapacity[c] = palette_capacity(bits, palettes[c].size());
+        wordOffset += packed.wordCapacity[c];
+        paletteOffset += packed.paletteCapacity[c];
+    }
+    packed.words.assign(wordOffset, 0u);
+    packed.palettes.assign(paletteOffset, 0u);
+
+    parallel_for(chunkCount, threads, [&](int c) {
+        std::vector<uint16_t> indices(CHUNK_VOXELS);
+        build_chunk_palette(world.voxels.data() + (size_t)c * CHUNK_VOXELS, palettes[c], indices.data());
+        write_chunk(packed, c, palettes[c], indices.data());
+    });
+}
+
+
+bool repack_chunks(const VoxelWorld& world, PackedVoxels& packed, const std::vector<int>& chunks) {
+    std::vector<uint32_t> palette;
+    std::vector<uint16_t> indices(CHUNK_VOXELS);
+    bool moved = false;
+
+    for (int c : chunks) {
+        build_chunk_palette(world.voxels.data() + (size_t)c * CHUNK_VOXELS, palette, indices.data());
+        uint32_t bits = packed_width(palette.size());
+
+        if (word_count(bits) > packed.wordCapacity[c] || palette.size() > packed.paletteCapacity[c]) {
+            // Promoted past its slot : new one at the end, the old one is dead space
+            uint32_t* info = &packed.chunkInfo[(size_t)c * PACKED_INFO_STRIDE];
+            info[0] = (uint32_t)packed.words.size();
+            info[1] = (uint32_t)packed.palettes.size();
+            packed.wordCapacity[c] = word_count(bits);
+            packed.paletteCapacity[c] = palette_capacity(bits, palette.size());
+            packed.words.resize(packed.words.size() + packed.wordCapacity[c], 0u);
+            packed.palettes.resize(packed.palettes.size() + packed.paletteCapacity[c], 0u);
+            moved = true;
+        }
+        write_chunk(packed, c, palette, indices.data());
+    }
+
+    // Too many dead slots, start over from the voxels
+    size_t liveWords = std::accumulate(packed.wordCapacity.begin(), packed.wordCapacity.end(), size_t(0));
+    if (moved && packed.words.size() > 2 * liveWords + CHUNK_VOXELS) pack_world(world, packed);
+    return moved;
+}
+
+
+void unpack_world(const PackedVoxels& packed, VoxelWorld& world, int threads) {
+    if (world.dim != packed.dim) world = VoxelWorld(packed.dim);
+    parallel_for((int)packed.chunkCount(), threads, [&](int c) {
+        int first = c * (int)CHUNK_VOXELS;
+        for (int i = first; i < first + (int)CHUNK_VOXELS; ++i)
+            world.voxels[i].material = packed.material(i);
+    });
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Palette compressed voxels, what shader.glsl reads with voxelFormat = 1 instead of the
+// 4 byte per voxel buffer. The vectors below are the GPU buffers as is :
+//
+//   chunkInfo (binding 7)   4 uints per chunk : word offset, palette offset, bits, palette size
+//   palettes  (binding 8)   materials, a chunk's voxels are indices into its slot
+//   words     (binding 9)   indices packed `bits` wide, in the raw chunk's VOXEL_LAYOUT order
+//
+// bits is 0 (single material, no words at all), 1, 2, 4, 8 or 16 : always a divisor
+// of 32, so an index never straddles two words. Index i of a chunk is
+//     (words[wordOffset + i * bits / 32] >> (i * bits % 32)) & ((1 << bits) - 1)
+//
+// Each chunk owns a slot in palettes / words. An edit repacks the chunk in place when it
+// still fits (same width or narrower), otherwise the chunk moves to a new slot at the end.
+
+const int PACKED_INFO_STRIDE = 4;
+
+struct PackedVoxels {
+    glm::ivec3 dim;                         // in chunks
+    std::vector<uint32_t> chunkInfo;
+    std::vector<uint32_t> palettes;
+    std::vector<uint32_t> words;
+
+    // Host only : slot sizes, in uints
+    std::vector<uint32_t> paletteCapacity;
+    std::vector<uint32_t> wordCapacity;
+
+    explicit PackedVoxels(glm::ivec3 dim = WORLD_DIM);
+
+    size_t chunkCount() const { return (size_t)dim.x * dim.y * dim.z; }
+    size_t byteSize() const { return (chunkInfo.size() + palettes.size() + words.size()) * sizeof(uint32_t); }
+
+    // Same decode as voxelMaterial() in voxel_world.glsl, voxelIndex as in VoxelWorld::worldToIndex3D
+    uint32_t material(int voxelIndex) const {
+        const uint32_t* info = &chunkInfo[(size_t)(voxelIndex / CHUNK_VOXELS) * PACKED_INFO_STRIDE];
+        uint32_t bits = info[2];
+        if (bits == 0u) return palettes[info[1]];
+
+        uint32_t bit = uint32_t(voxelIndex % CHUNK_VOXELS) * bits;
+        uint32_t index = (words[info[0] + (bit >> 5)] >> (bit & 31u)) & ((1u << bits) - 1u);
+        return palettes[info[1] + index];
+    }
+};
+
+// Narrowest supported width for a palette of that many materials, throws past 65536
+uint32_t packed_width(size_t paletteSize);
+
+// Whole world, chunks spread over `threads` workers (0 = all cores), slots tightly packed
+void pack_world(const VoxelWorld& world, PackedVoxels& packed, int threads = 0);
+
+// Repacks `chunks` from the world's voxels after edits, their width follows the new
+// material count. Returns true when the layout changed (a chunk outgrew its slot and
+// moved, or everything got repacked to drop the slots left behind) : the whole buffers
+// need uploading then, otherwise only the slots of `chunks`.
+bool repack_chunks(const VoxelWorld& world, PackedVoxels& packed, const std::vector<int>& chunks);
+
+// Back to 4 bytes per voxel
+void unpack_world(const PackedVoxels& packed, VoxelWorld& world, int threads = 0);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Runs fn(i) for i in [0, count) over `threads` workers (0 = all cores), the
+// calling thread being one of them. Items are handed out one at a time, so keep
+// them coarse (a tile, a chunk, ...).
+template <typename Fn>
+void parallel_for(int count, int threads, Fn fn) {
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, count));
+
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++) fn(i);
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+}
@@ -0,0 +1,235 @@
+#include "profiler.hpp"
+
+#ifdef SHADERDEMO_PROFILE
+
+#include "glad/gl.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+// Sample name of the frame times, one pointer for frame() and frameSummary()
+static const char* const FRAME_SCOPE = "frame";
+
+// Track of the calling thread, -1 until it first records something
+static thread_local int profileThread = -1;
+
+
+Profiler& Profiler::get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+
+Profiler::Profiler() : epoch(ProfileClock::now()), lastFrame(epoch) {}
+
+
+int64_t Profiler::micros(ProfileClock::time_point t) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - epoch).count();
+}
+
+
+int Profiler::threadId() {
+    if (profileThread < 0) {
+        profileThread = (int)threadNames.size();
+        threadNames.push_back("thread " + std::to_string(profileThread));
+    }
+    return profileThread;
+}
+
+
+void Profiler::nameThread(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    threadNames[threadId()] = name;
+}
+
+
+void Profiler::addSample(const char* name, bool gpu, double ms) {
+    auto& map = gpu ? gpuSeries : cpuSeries;
+    auto it = map.find(name);
+    if (it == map.end()) {
+        it = map.emplace(name, Series{name, gpu, 0, {}}).first;
+        it->second.ms.reserve(PROFILE_SAMPLES);
+    }
+    Series& s = it->second;
+    if (s.ms.size() < PROFILE_SAMPLES) s.ms.push_back((float)ms);
+    else s.ms[s.count % PROFILE_SAMPLES] = (float)ms;
+    s.count++;
+}
+
+
+void Profiler::addCpu(const char* name, ProfileClock::time_point start, ProfileClock::time_point end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    addSample(name, false, std::chrono::duration<double, std::milli>(end - start).count());
+    if (!tracing) return;
+    if (trace.size() < PROFILE_TRACE_EVENTS) trace.push_back(TraceEvent{name, micros(start), micros(end) - micros(start), threadId()});
+    else traceDropped++;
+}
+
+
+unsigned Profiler::beginGpu(const char* name) {
+    GLuint query;
+    if (!freeQueries.empty()) {
+        query = freeQueries.back();
+        freeQueries.pop_back();
+    } else {
+        glGenQueries(1, &query);
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    // Placed in the trace at the time it was submitted, the GPU runs it a bit later
+    pendingGpu.push_back(PendingGpu{name, query, micros(ProfileClock::now())});
+    return query;
+}
+
+
+void Profiler::endGpu(unsigned) {
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+
+// Reads the queries that are done, in order, stops at the first one that isn't
+void Profiler::collectGpu(bool wait) {
+    size_t done = 0;
+    for (; done < pendingGpu.size(); ++done) {
+        PendingGpu& p = pendingGpu[done];
+        GLint available = 0;
+        glGetQueryObjectiv(p.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait) break;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(p.query, GL_QUERY_RESULT, &ns);
+        freeQueries.push_back(p.query);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        addSample(p.name, true, double(ns) / 1e6);
+        if (!tracing) continue;
+        if (trace.size() < PROFILE_TRACE_EVENTS) trace.push_back(TraceEvent{p.name, p.startUs, int64_t(ns / 1000), -1});
+        else traceDropped++;
+    }
+    pendingGpu.erase(pendingGpu.begin(), pendingGpu.begin() + done);
+}
+
+
+void Profiler::frame() {
+    ProfileClock::time_point now = ProfileClock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        addSample(FRAME_SCOPE, false, std::chrono::duration<double, std::milli>(now - lastFrame).count());
+        lastFrame = now;
+    }
+    collectGpu(false);
+}
+
+
+void Profiler::setTracing(bool on) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tracing = on;
+}
+
+
+// Chrome trace event format : complete ("X") events in us, plus thread name metadata
+void Profiler::writeTrace(const std::string& path) {
+    collectGpu(true);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Can't write the trace to " + path);
+
+    auto escaped = [](const std::string& s) {
+        std::string r;
+        for (char c : s) {
+            if (c == '"' || c == '\\') r += '\\';
+            r += c;
+        }
+        return r;
+    };
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << -1 << ",\"args\":{\"name\":\"GPU\"}}";
+    for (size_t t = 0; t < threadNames.size(); ++t)
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t << ",\"args\":{\"name\":\"" << escaped(threadNames[t]) << "\"}}";
+    for (const TraceEvent& e : trace) {
+        out << ",\n{\"name\":\"" << escaped(e.name) << "\",\"cat\":\"" << (e.tid < 0 ? "gpu" : "cpu")
+            << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.tid << ",\"ts\":" << e.startUs << ",\"dur\":" << e.durUs << "}";
+    }
+    out << "\n]}\n";
+    if (!out) throw std::runtime_error("Can't write the trace to " + path);
+
+    std::cout << "Profiler trace : " << trace.size() << " events => " << path;
+    if (traceDropped) std::cout << " (" << traceDropped << " dropped past PROFILE_TRACE_EVENTS)";
+    std::cout << std::endl;
+}
+
+
+std::vector<ProfileStats> Profiler::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // The same literal can have a different address in another file, merged by name
+    std::map<std::pair<bool, std::string>, std::pair<const char*, std::pair<size_t, std::vector<float>>>> merged;
+    for (const auto* map : {&cpuSeries, &gpuSeries}) {
+        for (const auto& entry : *map) {
+            const Series& s = entry.second;
+            auto& m = merged[{s.gpu, s.name}];
+            m.first = s.name;
+            m.second.first += s.count;
+            m.second.second.insert(m.second.second.end(), s.ms.begin(), s.ms.end());
+        }
+    }
+
+    std::vector<ProfileStats> result;
+    for (auto& entry : merged) {
+        std::vector<float>& ms = entry.second.second.second;
+        if (ms.empty()) continue;
+        std::sort(ms.begin(), ms.end());
+        double sum = 0.0;
+        for (float v : ms) sum += v;
+        auto percentile = [&](double p) { return (double)ms[std::min(ms.size() - 1, size_t(ms.size() * p))]; };
+        result.push_back(ProfileStats{entry.second.first, entry.first.first, entry.second.second.first,
+                                      ms.front(), sum / ms.size(), percentile(0.95), percentile(0.99), ms.back()});
+    }
+    return result;
+}
+
+
+void Profiler::report(std::ostream& out) {
+    collectGpu(false);
+    std::vector<ProfileStats> all = stats();
+
+    std::ostringstream table;
+    table << std::fixed << std::setprecision(3);
+    table << "  " << std::left << std::setw(24) << "scope" << std::right << std::setw(10) << "calls"
+          << std::setw(10) << "min" << std::setw(10) << "avg" << std::setw(10) << "p95"
+          << std::setw(10) << "p99" << std::setw(10) << "max" << "  (ms, last " << PROFILE_SAMPLES << " calls)\n";
+    for (const ProfileStats& s : all) {
+        table << "  " << std::left << std::setw(24) << (std::string(s.gpu ? "gpu " : "cpu ") + s.name) << std::right
+              << std::setw(10) << s.count << std::setw(10) << s.minMs << std::setw(10) << s.avgMs << std::setw(10) << s.p95Ms
+              << std::setw(10) << s.p99Ms << std::setw(10) << s.maxMs << "\n";
+    }
+    out << table.str();
+}
+
+
+std::string Profiler::frameSummary() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cpuSeries.find(FRAME_SCOPE);
+    if (it == cpuSeries.end() || it->second.ms.empty()) return "";
+
+    std::vector<float> ms = it->second.ms;
+    std::sort(ms.begin(), ms.end());
+    double sum = 0.0;
+    for (float v : ms) sum += v;
+    double avg = sum / ms.size();
+
+    char line[128];
+    std::snprintf(line, sizeof(line), "frame %.2f ms avg, %.2f ms p99, %.2f ms max (%.0f fps, last %zu)",
+                  avg, (double)ms[std::min(ms.size() - 1, ms.size() * 99 / 100)], (double)ms.back(), 1000.0 / avg, ms.size());
+    return line;
+}
+
+#endif
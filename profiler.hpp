@@ -0,0 +1,147 @@
+#pragma once
+
+// Frame profiler : named CPU scopes (steady_clock, from any thread) and GPU scopes
+// (GL_TIME_ELAPSED queries, on the GL thread). Every scope is a sample of its name,
+// report() gives min / avg / p95 / p99 / max over the last PROFILE_SAMPLES of each,
+// and with tracing on every scope also goes to a Chrome trace (chrome://tracing or
+// ui.perfetto.dev), one track per thread plus one for the GPU.
+//
+//   PROFILE_SCOPE("name")        CPU time until the end of the enclosing block
+//   PROFILE_GPU_SCOPE("name")    GPU time of the GL commands submitted until the end of the
+//                                block. GL_TIME_ELAPSED queries can't nest, so neither can
+//                                these, nor can they run inside gpu_time_ms()
+//   PROFILE_FRAME()              end of a frame : the "frame" sample, and GPU results that came in
+//   PROFILE_THREAD_NAME(name)    the calling thread's track name in the trace
+//
+// Names are kept by pointer, so they must be string literals. GPU results are read a few
+// frames later, when the queries say they're available, so the GPU never stalls on them.
+//
+// Built in with cmake -DPROFILER=ON (the default), which defines SHADERDEMO_PROFILE.
+// Without it the macros are empty and none of this exists.
+
+#ifdef SHADERDEMO_PROFILE
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Samples per name kept for the percentiles
+const size_t PROFILE_SAMPLES = 4096;
+// Trace events kept at most (24 bytes each), the ones after that are counted and dropped
+const size_t PROFILE_TRACE_EVENTS = 1u << 21;
+
+using ProfileClock = std::chrono::steady_clock;
+
+struct ProfileStats {
+    const char* name;
+    bool gpu;
+    size_t count;           // since the start, the percentiles only cover the last PROFILE_SAMPLES
+    double minMs, avgMs, p95Ms, p99Ms, maxMs;
+};
+
+
+class Profiler {
+public:
+    static Profiler& get();
+
+    void addCpu(const char* name, ProfileClock::time_point start, ProfileClock::time_point end);
+    // Returns the query to give back to endGpu()
+    unsigned beginGpu(const char* name);
+    void endGpu(unsigned query);
+    void frame();
+
+    void nameThread(const std::string& name);
+
+    // Starts recording trace events (off by default, they're the only thing that grows)
+    void setTracing(bool on);
+    // Throws std::runtime_error when the file can't be written
+    void writeTrace(const std::string& path);
+
+    std::vector<ProfileStats> stats();
+    // Table of stats(), CPU then GPU, by name
+    void report(std::ostream& out);
+    // One line : frame time avg / p99 and fps over the last PROFILE_SAMPLES frames
+    std::string frameSummary();
+
+private:
+    Profiler();
+
+    struct Series {
+        const char* name;
+        bool gpu;
+        size_t count = 0;
+        std::vector<float> ms;      // ring of the last PROFILE_SAMPLES
+    };
+    struct TraceEvent {
+        const char* name;
+        int64_t startUs, durUs;
+        int tid;                    // -1 : GPU
+    };
+    struct PendingGpu {
+        const char* name;
+        unsigned query;
+        int64_t startUs;
+    };
+
+    void addSample(const char* name, bool gpu, double ms);      // lock held
+    int threadId();                                             // lock held
+    int64_t micros(ProfileClock::time_point t) const;
+    void collectGpu(bool wait);
+
+    std::mutex mutex;
+    ProfileClock::time_point epoch, lastFrame;
+    std::unordered_map<const char*, Series> cpuSeries, gpuSeries;
+    std::vector<std::string> threadNames;
+
+    bool tracing = false;
+    std::vector<TraceEvent> trace;
+    size_t traceDropped = 0;
+
+    // GL thread only
+    std::vector<PendingGpu> pendingGpu;     // submitted, oldest first
+    std::vector<unsigned> freeQueries;
+};
+
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), start(ProfileClock::now()) {}
+    ~ProfileScope() { Profiler::get().addCpu(name, start, ProfileClock::now()); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    ProfileClock::time_point start;
+};
+
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name) : query(Profiler::get().beginGpu(name)) {}
+    ~GpuProfileScope() { Profiler::get().endGpu(query); }
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    unsigned query;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::get().frame()
+#define PROFILE_THREAD_NAME(name) Profiler::get().nameThread(name)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+
+#endif
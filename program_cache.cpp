@@ -0,0 +1,201 @@
+#include "program_cache.hpp"
+
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+
+// FNV-1a 64, chained
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) h = (h ^ p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+
+static const char* stage_name(GLenum type) {
+    switch (type) {
+        case GL_VERTEX_SHADER: return "Vertex";
+        case GL_FRAGMENT_SHADER: return "Fragment";
+        case GL_COMPUTE_SHADER: return "Compute";
+        default: return "Shader";
+    }
+}
+
+
+GLuint compile_program(const std::string& name, const ShaderStages& stages, bool retrievable) {
+    GLuint program = glCreateProgram();
+    std::vector<GLuint> shaders;
+    for (const auto& stage : stages) {
+        GLuint shader = glCreateShader(stage.first);
+        const char* source = stage.second.c_str();
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+
+        GLint success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            GLint logLength;
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+            std::vector<char> infoLog(std::max(logLength, 1));
+            glGetShaderInfoLog(shader, logLength, nullptr, infoLog.data());
+            glDeleteShader(shader);
+            for (GLuint s : shaders) glDeleteShader(s);
+            glDeleteProgram(program);
+            throw std::runtime_error(std::string(stage_name(stage.first)) + " shader compilation failed (" + name + ") :\n" + infoLog.data());
+        }
+        glAttachShader(program, shader);
+        shaders.push_back(shader);
+    }
+
+    if (retrievable) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    for (GLuint s : shaders) glDeleteShader(s);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        GLint logLength;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+        std::vector<char> infoLog(std::max(logLength, 1));
+        glGetProgramInfoLog(program, logLength, nullptr, infoLog.data());
+        glDeleteProgram(program);
+        throw std::runtime_error("Program linking failed (" + name + ") :\n" + std::string(infoLog.data()));
+    }
+    return program;
+}
+
+
+uint64_t ProgramCache::key(const ShaderStages& stages) {
+    uint64_t h = hash_bytes(0xcbf29ce484222325ull, driver.data(), driver.size());
+    for (const auto& stage : stages) {
+        uint32_t type = stage.first;
+        uint64_t size = stage.second.size();
+        h = hash_bytes(h, &type, sizeof(type));
+        h = hash_bytes(h, &size, sizeof(size));
+        h = hash_bytes(h, stage.second.data(), stage.second.size());
+    }
+    return h;
+}
+
+
+std::string ProgramCache::path(const std::string& name) const {
+    // shaders/voxel.glsl -> <directory>/shaders_voxel.glsl.bin
+    std::string file = name;
+    for (char& c : file)
+        if (c == '/' || c == '\\' || c == ':') c = '_';
+    return directory + "/" + file + ".bin";
+}
+
+
+GLuint ProgramCache::load(const std::string& name, uint64_t k, bool& rejected) {
+    std::ifstream in(path(name), std::ios::binary);
+    if (!in) return 0;
+
+    ProgramCacheHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return 0;
+    if (header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION || header.key != k) return 0;
+    std::vector<char> binary(header.size);
+    if (!in.read(binary.data(), binary.size())) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Same key but the driver wants none of it (it can refuse any binary it likes)
+        glDeleteProgram(program);
+        rejected = true;
+        return 0;
+    }
+    return program;
+}
+
+
+void ProgramCache::store(const std::string& name, uint64_t k, GLuint program) {
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) return;
+
+    std::vector<char> binary(size);
+    GLenum format = 0;
+    glGetProgramBinary(program, size, nullptr, &format, binary.data());
+
+    ProgramCacheHeader header{};
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = k;
+    header.format = format;
+    header.size = (uint32_t)size;
+
+    // Written next to it then renamed, so a crash never leaves half a binary under the real name
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string target = path(name), temporary = target + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), binary.size());
+        if (!out) {
+            std::cerr << "Couldn't write the program cache " << temporary << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, target, error);
+    if (error) std::cerr << "Couldn't write the program cache " << target << " : " << error.message() << std::endl;
+}
+
+
+GLuint ProgramCache::get(const std::string& name, const ShaderStages& stages) {
+    auto start = std::chrono::steady_clock::now();
+
+    if (driver.empty()) {
+        for (GLenum e : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) {
+            const GLubyte* s = glGetString(e);
+            driver += s ? reinterpret_cast<const char*>(s) : "?";
+            driver += "\n";
+        }
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binariesSupported = formats > 0;
+    }
+    bool cached = !directory.empty() && binariesSupported;
+
+    GLuint program = 0;
+    uint64_t k = cached ? key(stages) : 0;
+    bool rejected = false;
+    if (cached) program = load(name, k, rejected);
+
+    if (program) {
+        counters.loaded++;
+    } else {
+        program = compile_program(name, stages, cached);
+        if (cached) store(name, k, program);
+        counters.compiled++;
+        counters.rejected += rejected;
+    }
+
+    counters.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return program;
+}
+
+
+bool ProgramCache::reload(LiveProgram& live, ShaderStages stages) {
+    if (stages == live.stages) return false;
+    live.stages = std::move(stages);
+
+    GLuint program;
+    try {
+        program = get(live.name, live.stages);
+    } catch (const std::exception& e) {
+        std::cerr << "\n" << e.what() << "\nStill drawing with the previous " << live.name << std::endl;
+        return false;
+    }
+    glDeleteProgram(live.program);
+    live.program = program;
+    std::cout << "\nReloaded " << live.name << std::endl;
+    return true;
+}
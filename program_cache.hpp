@@ -0,0 +1,87 @@
+#pragma once
+
+#include "glad/gl.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Linked GL programs kept on disk with glGetProgramBinary, so a start doesn't compile
+// every shader again. A program's key is a hash of its stages (type and final source,
+// includes expanded and defines in) and of the driver (GL_VENDOR, GL_RENDERER,
+// GL_VERSION, GL_SHADING_LANGUAGE_VERSION). One file per program name :
+//
+//   ProgramCacheHeader      32 bytes
+//   binary                  header.size bytes, in header.format
+//
+// A file with another key (sources or driver changed), or a binary the driver refuses
+// (glProgramBinary not linking), is compiled again and overwritten.
+
+const uint32_t PROGRAM_CACHE_MAGIC = 0x47504453u;     // "SDPG"
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;        // binaryFormat of glGetProgramBinary
+    uint32_t size;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(ProgramCacheHeader) == 32, "program cache header layout");
+
+using ShaderStages = std::vector<std::pair<GLenum, std::string>>;     // type, source
+
+// A program the window keeps using while its shaders get edited : the stages it was
+// last built from (or tried to be, when they didn't compile)
+struct LiveProgram {
+    std::string name;
+    ShaderStages stages;
+    GLuint program = 0;
+};
+
+struct ProgramCacheStats {
+    int loaded = 0;         // from the cache
+    int compiled = 0;       // not in the cache, sources changed, or refused by the driver
+    int rejected = 0;       // of compiled : a binary with the right key the driver wouldn't take
+    double ms = 0.0;        // spent in get()
+};
+
+
+class ProgramCache {
+public:
+    // directory empty : no cache, get() always compiles. Needs a GL context from the
+    // first get() on (the driver string is read then).
+    explicit ProgramCache(std::string directory = "") : directory(std::move(directory)) {}
+
+    void setDirectory(std::string dir) { directory = std::move(dir); }
+    const std::string& getDirectory() const { return directory; }
+
+    // Linked program of these stages. `name` is the cache file name (and what errors
+    // mention). Throws std::runtime_error with the GL log when a stage doesn't compile
+    // or the program doesn't link.
+    GLuint get(const std::string& name, const ShaderStages& stages);
+
+    // Builds `stages` into live.program when they differ from live.stages, deleting the old
+    // program once the new one links. On an error it prints the log and the old program
+    // stays. True when live.program changed (uniform locations must be looked up again).
+    bool reload(LiveProgram& live, ShaderStages stages);
+
+    const ProgramCacheStats& stats() const { return counters; }
+
+private:
+    uint64_t key(const ShaderStages& stages);
+    std::string path(const std::string& name) const;
+    GLuint load(const std::string& name, uint64_t k, bool& rejected);
+    void store(const std::string& name, uint64_t k, GLuint program);
+
+    std::string directory;
+    std::string driver;     // read on the first get()
+    bool binariesSupported = false;
+    ProgramCacheStats counters;
+};
+
+// Compiles and links without any cache, same errors as ProgramCache::get()
+GLuint compile_program(const std::string& name, const ShaderStages& stages, bool retrievable = false);
@@ -0,0 +1,298 @@
+// Everything a primary ray needs, shared by shader.glsl (fragment path) and
+// raymarch_compute.glsl (--compute) : the uniforms, the world lookups, raymarch() and
+// shadePixel(), which does what main() used to for one pixel.
+
+uniform vec2 resolution;
+uniform vec3 camPos;
+uniform vec3 camRot;
+uniform float FOV;
+uniform vec2 jitter;            // sub-pixel offset of this frame, --temporal upscaling only
+uniform int reproject;          // 1 : rays start reprojectBackoff before the last frame's hits splatted in tStartTex
+uniform usampler2D tStartTex;   // reproject.glsl, float bits, 0xffffffff = nothing there
+uniform float reprojectBackoff;
+uniform int cone;               // 1 : rays start where cone.glsl's cone of their 8x8 tile stopped
+uniform sampler2D coneTex;
+
+uniform int RENDER_DEBUG;
+
+const ivec3 CHUNK_SIZE = ivec3(32, 32, 32);
+const float MAX_DIST = 10000.0;
+const int MAX_STEPS = 1024;
+
+
+
+
+struct Material {
+    vec3 color;
+    float opacity;
+};
+
+
+
+const int NUM_MATERIALS = 4;
+
+const Material voxelMaterials[NUM_MATERIALS] = Material[NUM_MATERIALS](
+    Material(vec3(0.5, 0.5, 0.5), 1.0),   // stone
+    Material(vec3(0.4, 0.25, 0.1), 1.0),  // dirt
+    Material(vec3(0.055,0.639,0.231), 1.0),    // grass
+    Material(vec3(0.2, 0.4, 1.0), 0.15)    // water
+);
+
+
+
+// For now AIR is defined here, ie the empty cell
+const Material AIR = Material(vec3(1.0, 1.0, 1.0), 0.0);
+Material getVoxelMaterial(uint materialId) {
+    if (materialId == 0u) {
+        return AIR;
+    }
+    if (materialId > uint(NUM_MATERIALS)) {
+        return Material(vec3(0.2, 0.2, 0.2), 1.0); // default gray
+    }
+    return voxelMaterials[int(materialId) - 1];
+}
+
+
+
+
+#include "voxel_world.glsl"
+
+
+// Moves the DDA to the first voxel past the empty box [boxMin, boxMin + size)
+// and returns the t where the ray leaves it. Same as leapBox() in cpu_raymarch.cpp
+float leapBox(vec3 ro, vec3 rd, ivec3 boxMin, int size, vec3 step, vec3 deltaDist, inout vec3 pos, inout vec3 sideDist) {
+    vec3 bMin = vec3(boxMin);
+    vec3 bMax = vec3(boxMin + size);
+
+    vec3 exitDist = vec3(
+        rd.x > 0.0 ? (bMax.x - ro.x) * deltaDist.x : (ro.x - bMin.x) * deltaDist.x,
+        rd.y > 0.0 ? (bMax.y - ro.y) * deltaDist.y : (ro.y - bMin.y) * deltaDist.y,
+        rd.z > 0.0 ? (bMax.z - ro.z) * deltaDist.z : (ro.z - bMin.z) * deltaDist.z
+    );
+
+    // Same tie breaking as a DDA step
+    int axis = (exitDist.x < exitDist.y && exitDist.x < exitDist.z) ? 0 : (exitDist.y < exitDist.z ? 1 : 2);
+    float t = exitDist[axis];
+
+    // Voxel of the box the ray leaves from, then one step across the exit face
+    vec3 p = clamp(floor(ro + rd * t), bMin, bMax - 1.0);
+    for (int a = 0; a < 3; ++a) {
+        sideDist[a] = rd[a] > 0.0
+            ? (p[a] + 1.0 - ro[a]) * deltaDist[a]
+            : (ro[a] - p[a]) * deltaDist[a];
+    }
+    p[axis] = step[axis] > 0.0 ? bMax[axis] : bMin[axis] - 1.0;
+    sideDist[axis] = exitDist[axis] + deltaDist[axis];
+
+    pos = p;
+    return t;
+}
+
+
+
+
+#include "camera.glsl"
+
+
+
+
+
+
+
+
+bool intersectAABB(vec3 ro, vec3 rd, vec3 boxMin, vec3 boxMax, out float tNear, out float tFar) {
+    // Used to check if ray will collide with world currently described
+    vec3 invDir = 1.0 / rd;
+
+    vec3 t0s = (boxMin - ro) * invDir;
+    vec3 t1s = (boxMax - ro) * invDir;
+
+    vec3 tsmaller = min(t0s, t1s);
+    vec3 tbigger  = max(t0s, t1s);
+
+    tNear = max(max(tsmaller.x, tsmaller.y), tsmaller.z);
+    tFar  = min(min(tbigger.x, tbigger.y), tbigger.z);
+
+    bool result =  tFar >= max(tNear, 0.0);
+    tFar = tFar + 0.001; // SOOOOO I need to add epsilon or there's a conflict in the outbound check that gives me a visual glitch
+    return result;
+}
+
+
+
+// === Beer-Lambert absorption + background composition ===
+// tMin skips the start of the ray (air up to there), firstHit / firstVoxel : where it entered the first non-air voxel
+bool raymarch(vec3 ro, vec3 rd, float tMin, out vec3 accumulatedColor, out float transparency, out uint steps, out vec3 impactPosition,
+              out float firstHit, out ivec3 firstVoxel) {
+    vec3 pos = floor(ro);
+    firstHit = 0.0;
+    firstVoxel = ivec3(0);
+    float tNear, tFar;
+    vec3 boxMin = vec3(worldOrigin * chunkSize);
+    vec3 boxMax = vec3((worldOrigin + worldDim) * chunkSize);
+
+    if (!intersectAABB(ro, rd, boxMin, boxMax, tNear, tFar)) {
+        accumulatedColor = vec3(0.0);
+        transparency = 1.0;
+        steps = 0;
+        impactPosition = pos;
+        return false;
+    }
+
+    float tStart = max(tNear, tMin);
+    vec3 roStart = ro + rd * tStart;
+    pos = floor(roStart);
+    vec3 step = sign(rd);
+    vec3 deltaDist = abs(1.0 / rd);
+
+    vec3 sideDist;
+    sideDist.x = (rd.x > 0.0)
+        ? (pos.x + 1.0 - ro.x) * deltaDist.x
+        : (ro.x - pos.x) * deltaDist.x;
+    sideDist.y = (rd.y > 0.0)
+        ? (pos.y + 1.0 - ro.y) * deltaDist.y
+        : (ro.y - pos.y) * deltaDist.y;
+    sideDist.z = (rd.z > 0.0)
+        ? (pos.z + 1.0 - ro.z) * deltaDist.z
+        : (ro.z - pos.z) * deltaDist.z;
+
+    accumulatedColor = vec3(0.0);
+    transparency = 1.0;
+
+    float last_t = tStart;
+
+    for (int i = 0; i < MAX_STEPS; ++i) {
+        ivec3 ipos = ivec3(pos);
+
+        float t = min(min(sideDist.x, sideDist.y), sideDist.z);
+
+        int emptySize;
+        ivec3 emptyMin;
+        uint material = voxelLookup(ipos, emptyMin, emptySize);
+
+        if (material != 0u) {
+            if (firstHit == 0.0) {
+                firstHit = max(last_t, 1e-6);
+                firstVoxel = ipos;
+            }
+            Material m = getVoxelMaterial(material);
+
+
+
+
+            // ======================= OPACITY HANDLING ==================================
+            float opacity = m.opacity; // absorption coefficient
+            vec3 col = m.color;
+
+            // Fast branch when reaching opaque block
+            if (opacity >= 0.99) {
+                accumulatedColor += transparency * col;
+                transparency = 0.0;
+                steps = i;
+                impactPosition = pos;
+                return true;
+            }
+
+
+            float travel = t - last_t;
+            float absorb = exp(-opacity * travel);
+
+            // classic alpha blend => DOES NOT WORK,  DO NOT USE
+            // accumulatedColor += transparency * col * opacity;
+            // transparency *= (1.0 - opacity);
+
+            // Opacity exponential remap => walmart Beer-Lambert
+            float localOpacity = 1.0 - pow(1.0 - opacity, travel);
+            accumulatedColor += transparency * col * localOpacity;
+            transparency *= (1.0 - localOpacity);
+
+            // Beer-Lambert physically accurate method (costly)
+            // accumulatedColor += transparency * col * (1.0 - absorb);
+            // transparency *= absorb;
+
+            if (transparency < 0.01) {
+                steps = i;
+                impactPosition = pos;
+                return true;
+            }
+        } else if (emptySize > 1) {
+            // The whole octree node / chunk / cube is air, jump straight past it
+            last_t = leapBox(ro, rd, emptyMin, emptySize, step, deltaDist, pos, sideDist);
+
+            if (last_t > tFar) {
+                steps = i;
+                impactPosition = pos;
+                return true;
+            }
+            continue;
+        }
+        // ======================= !OPACITY HANDLING ==================================
+
+
+        if (sideDist.x < sideDist.y && sideDist.x < sideDist.z) {
+            pos.x += step.x;
+            sideDist.x += deltaDist.x;
+        } else if (sideDist.y < sideDist.z) {
+            pos.y += step.y;
+            sideDist.y += deltaDist.y;
+        } else {
+            pos.z += step.z;
+            sideDist.z += deltaDist.z;
+        }
+
+        last_t = t;
+
+        if (t > tFar) {
+            steps = i;
+            impactPosition = pos;
+            return true;    
+        }
+    }
+
+    return false;
+}
+
+
+
+
+
+
+
+// hashing function
+float hash(float n) {
+    return fract(sin(n) * 43758.5453123);
+}
+
+
+
+
+// Shaded color of the pixel at fragCoord (gl_FragCoord convention), and where its ray
+// first entered a non-air voxel for the G-buffer
+vec4 shadePixel(vec2 fragCoord, out float firstHit, out ivec3 firstVoxel) {
+    vec3 rd = cameraRayDir(fragCoord + jitter, resolution, camRot, FOV);
+    vec3 ro = camPos;
+
+    float tMin = 0.0;
+    if (reproject != 0) {
+        uint splat = texelFetch(tStartTex, ivec2(fragCoord), 0).r;
+        if (splat != 0xffffffffu) tMin = max(uintBitsToFloat(splat) - reprojectBackoff, 0.0);
+    }
+    if (cone != 0) tMin = max(tMin, texelFetch(coneTex, ivec2(fragCoord) / 8, 0).r);
+
+    vec3 color;
+    vec3 impactPosition;
+    float transparency;
+    uint steps;
+    raymarch(ro, rd, tMin, color, transparency, steps, impactPosition, firstHit, firstVoxel);
+
+    // This displays the number of steps/max steps
+    if (RENDER_DEBUG == 1) {
+        return vec4(float(steps)/MAX_STEPS, float(steps)/MAX_STEPS, float(steps)/MAX_STEPS, 1.0);
+    }
+
+    vec3 skyColor = rd.y < 0.0 ? vec3(135, 121, 100) / 255.0 : vec3(103, 159, 201) / 255.0;
+
+    // add a bit of darkening for variation in the same voxel type
+    color -= color * hash( impactPosition.x + impactPosition.x*impactPosition.y + impactPosition.x*impactPosition.y*impactPosition.z )*0.07;
+    return vec4(color + transparency * skyColor, 1.0);
+}
@@ -0,0 +1,65 @@
+#version 430 core
+
+// Compute path of the primary rays (--compute, C in the window), same pixels as
+// shader.glsl. Persistent threads : main.cpp dispatches a fixed number of 8x8 groups,
+// each one takes the next 8x8 tile of the frame from tileQueue until there are none
+// left, so the groups that got cheap tiles (sky) keep going instead of the whole grid
+// waiting on the expensive ones. With traversalMode = 2 each group keeps the chunk
+// occupancy table in shared memory when it fits.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(rgba8, binding = 2) uniform writeonly image2D colorImage;
+layout(r32f, binding = 3) uniform writeonly image2D distanceImage;     // hitDistance
+layout(rgba32i, binding = 4) uniform writeonly iimage2D voxelImage;    // hitVoxel, when writeVoxels = 1
+uniform int writeVoxels;
+
+// Next tile to hand out, main.cpp zeroes it before the dispatch
+layout(std430, binding = 10) buffer TileQueue {
+    uint nextTile;
+};
+
+const int OCCUPANCY_CACHE = 4096;   // chunks, 16 KB
+shared uint occupancyCache[OCCUPANCY_CACHE];
+shared uint groupTile;
+bool occupancyCached = false;
+
+uint cachedOccupancy(int chunk);
+#define CHUNK_OCCUPANCY(chunk) cachedOccupancy(chunk)
+
+#include "raymarch.glsl"
+
+uint cachedOccupancy(int chunk) {
+    return occupancyCached ? occupancyCache[chunk] : chunkOccupancy[chunk];
+}
+
+void main() {
+    int chunks = worldDim.x * worldDim.y * worldDim.z;
+    occupancyCached = traversalMode == 2 && chunks <= OCCUPANCY_CACHE;
+    if (occupancyCached) {
+        for (int i = int(gl_LocalInvocationIndex); i < chunks; i += 64) occupancyCache[i] = chunkOccupancy[i];
+    }
+
+    ivec2 tiles = (ivec2(resolution) + 7) / 8;
+    uint tileCount = uint(tiles.x * tiles.y);
+    while (true) {
+        // Everyone is done with the last tile (and the cache is filled)
+        memoryBarrierShared();
+        barrier();
+        if (gl_LocalInvocationIndex == 0u) groupTile = atomicAdd(nextTile, 1u);
+        memoryBarrierShared();
+        barrier();
+
+        uint tile = groupTile;
+        if (tile >= tileCount) break;
+
+        ivec2 pixel = ivec2(int(tile) % tiles.x, int(tile) / tiles.x) * 8 + ivec2(gl_LocalInvocationID.xy);
+        if (all(lessThan(pixel, ivec2(resolution)))) {
+            float firstHit;
+            ivec3 firstVoxel;
+            imageStore(colorImage, pixel, shadePixel(vec2(pixel) + 0.5, firstHit, firstVoxel));
+            imageStore(distanceImage, pixel, vec4(firstHit));
+            if (writeVoxels != 0) imageStore(voxelImage, pixel, ivec4(firstVoxel, 0));
+        }
+    }
+}
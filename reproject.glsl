@@ -0,0 +1,50 @@
+#version 430 core
+
+// --reproject (main.cpp, reproject_gpu) : splats last frame's hits onto this frame's
+// pixels, same as reproject_hits() in reprojection.cpp. One invocation per pixel of the
+// previous G-buffer, tStartImage keeps the closest distance around each pixel as float
+// bits (positive floats order like their bits), 0xffffffff where nothing lands.
+// shader.glsl then starts its ray reprojectBackoff before that.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D prevDistance;    // hitDistance, 0 = nothing hit
+layout(binding = 1) uniform isampler2D prevVoxel;      // hitVoxel
+layout(r32ui, binding = 0) uniform uimage2D tStartImage;
+
+uniform ivec2 prevSize;
+uniform vec2 resolution;
+uniform vec3 camPos;
+uniform vec3 camRot;
+uniform float FOV;
+uniform int maxRadius;
+
+#include "camera.glsl"
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, prevSize))) return;
+    if (texelFetch(prevDistance, texel, 0).r <= 0.0) return;
+
+    vec3 voxelMin = vec3(texelFetch(prevVoxel, texel, 0).xyz);
+    vec3 local = transpose(getRotationMatrix(camRot)) * (voxelMin + 0.5 - camPos);
+    // Behind the camera (or around it) : nothing in front to bound
+    if (local.z > -0.5) return;
+
+    vec2 frag;
+    cameraProject(voxelMin + 0.5, camPos, camRot, FOV, resolution, frag);
+
+    // Pixels the voxel covers (bounding sphere), one more each way
+    float fovScale = tan(radians(FOV) * 0.5);
+    float pixels = 0.866 / (-local.z * fovScale) * (resolution.y * 0.5);
+    int radius = min(maxRadius, int(ceil(pixels)) + 1);
+    ivec2 c = ivec2(floor(frag));
+    ivec2 lo = max(c - radius, ivec2(0));
+    ivec2 hi = min(c + radius, ivec2(resolution) - 1);
+
+    // Closest point of the cube, no ray from here gets into it earlier
+    uint distance = floatBitsToUint(length(clamp(camPos, voxelMin, voxelMin + 1.0) - camPos));
+    for (int y = lo.y; y <= hi.y; ++y)
+        for (int x = lo.x; x <= hi.x; ++x)
+            imageAtomicMin(tStartImage, ivec2(x, y), distance);
+}
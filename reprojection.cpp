@@ -0,0 +1,46 @@
+#include "reprojection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+void reproject_hits(const HitBuffer& previous, const Camera& cam, int width, int height, std::vector<float>& tStart) {
+    const float NONE = std::numeric_limits<float>::infinity();
+    tStart.assign((size_t)width * height, NONE);
+
+    // Inverse of primaryRay()
+    glm::mat3 toCamera = glm::transpose(getRotationMatrix(glm::vec3(cam.rot.x, cam.rot.y, 0.0f)));
+    float fovScale = std::tan(glm::radians(cam.fov) * 0.5f);
+    float aspect = float(width) / float(height);
+
+    for (const RayHit& hit : previous.hits) {
+        if (hit.distance <= 0.0f) continue;
+        glm::vec3 voxelMin(hit.voxel);
+        glm::vec3 local = toCamera * (voxelMin + 0.5f - cam.pos);
+        // Behind the camera (or around it) : nothing in front to bound
+        if (local.z > -0.5f) continue;
+
+        glm::vec2 uv = glm::vec2(local.x, local.y) / (-local.z * fovScale);
+        uv.x /= aspect;
+        glm::vec2 frag = (uv * 0.5f + 0.5f) * glm::vec2(width, height);
+
+        // Pixels the voxel covers (bounding sphere), one more each way
+        float pixels = 0.866f / (-local.z * fovScale) * (height * 0.5f);
+        int radius = std::min(REPROJECT_MAX_RADIUS, (int)std::ceil(pixels) + 1);
+        int cx = (int)std::floor(frag.x), cy = (int)std::floor(frag.y);
+        int x0 = std::max(cx - radius, 0), x1 = std::min(cx + radius, width - 1);
+        int y0 = std::max(cy - radius, 0), y1 = std::min(cy + radius, height - 1);
+        if (x0 > x1 || y0 > y1) continue;
+
+        // Closest point of the cube, no ray from here gets into it earlier
+        float distance = glm::length(glm::clamp(cam.pos, voxelMin, voxelMin + 1.0f) - cam.pos);
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x) {
+                float& t = tStart[(size_t)y * width + x];
+                t = std::min(t, distance);
+            }
+    }
+
+    for (float& t : tStart) t = t == NONE ? 0.0f : std::max(t - REPROJECT_BACKOFF, 0.0f);
+}
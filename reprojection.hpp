@@ -0,0 +1,24 @@
+#pragma once
+
+#include "cpu_raymarch.hpp"
+
+#include <vector>
+
+// Temporal reprojection of the primary hits : every frame keeps, per pixel, where its ray
+// first entered a non-air voxel (HitBuffer). The next frame splats those voxels onto its
+// own pixels, and each ray starts REPROJECT_BACKOFF before the closest one around it
+// instead of at the world box : a few steps instead of the whole way through the air.
+// reproject.glsl is the same splat on the GPU, shader.glsl reads it as its tMin.
+//
+// It's a guess, not a proof : the air up to there was only seen from the previous
+// camera. The splat takes the closest point of each voxel cube and spreads it over every
+// pixel the voxel covers plus one, so a surface the new ray reaches earlier would have
+// to be one no ray of the previous frame hit, close to a pixel that did. Edits break
+// that, drop the previous hits after one (no hits, no reprojection).
+
+const float REPROJECT_BACKOFF = 2.0f;   // voxels
+const int REPROJECT_MAX_RADIUS = 8;     // pixels a splat spreads over, each way
+
+// Per pixel tMin (gl_FragCoord rows) for `cam` at width x height, 0 where no hit of
+// `previous` lands
+void reproject_hits(const HitBuffer& previous, const Camera& cam, int width, int height, std::vector<float>& tStart);
@@ -0,0 +1,86 @@
+#include "shader_watch.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+static bool is_shader_file(const std::string& name) {
+    return name.size() > 5 && name.compare(name.size() - 5, 5, ".glsl") == 0;
+}
+
+
+// Modification time of every .glsl file in the directory
+static std::map<std::string, std::filesystem::file_time_type> shader_times(const std::string& directory) {
+    std::map<std::string, std::filesystem::file_time_type> times;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string name = entry.path().filename().string();
+        if (is_shader_file(name)) times[name] = entry.last_write_time(error);
+    }
+    return times;
+}
+
+
+ShaderWatcher::ShaderWatcher(const std::string& directory) : directory(directory.empty() ? "." : directory) {
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // IN_MOVED_TO / IN_CREATE : editors that write a copy and rename it over the original
+    if (fd >= 0 && inotify_add_watch(fd, this->directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(fd);
+        fd = -1;
+    }
+#endif
+    if (fd < 0) times = shader_times(this->directory);
+}
+
+
+ShaderWatcher::~ShaderWatcher() {
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+}
+
+
+bool ShaderWatcher::watching() const {
+    return fd >= 0 || std::filesystem::is_directory(directory);
+}
+
+
+bool ShaderWatcher::poll() {
+    bool any = false;
+#ifdef __linux__
+    if (fd >= 0) {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t size;
+        while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + size;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                if (event->len && is_shader_file(event->name)) any = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        return any;
+    }
+#endif
+
+    Clock::time_point now = Clock::now();
+    if (now - lastCheck < std::chrono::duration<double>(CHECK_SECONDS)) return false;
+    lastCheck = now;
+    auto current = shader_times(directory);
+    any = current != times;
+    times = std::move(current);
+    return any;
+}
+
+
+bool ShaderWatcher::changed() {
+    if (poll()) {
+        pending = true;
+        lastChange = Clock::now();
+    }
+    if (!pending || Clock::now() - lastChange < std::chrono::duration<double>(SETTLE_SECONDS)) return false;
+    pending = false;
+    return true;
+}
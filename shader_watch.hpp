@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+
+// Tells the windowed mode when a .glsl file of a directory was written, so it can rebuild
+// its programs without a restart (program_cache.hpp, ProgramCache::reload). inotify on
+// Linux, modification times every CHECK_SECONDS elsewhere. Never blocks.
+class ShaderWatcher {
+public:
+    explicit ShaderWatcher(const std::string& directory);
+    ~ShaderWatcher();
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // True once per burst of changes, when the directory has been quiet for SETTLE_SECONDS :
+    // editors save in several steps (truncate then write, or write a copy and rename it)
+    // and a half written file would just fail to compile
+    bool changed();
+
+    bool watching() const;
+
+    static constexpr double SETTLE_SECONDS = 0.15;
+    static constexpr double CHECK_SECONDS = 0.5;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool poll();    // any new change since the last call
+
+    std::string directory;
+    int fd = -1;    // inotify
+    std::map<std::string, std::filesystem::file_time_type> times;     // without inotify
+    Clock::time_point lastCheck{};
+    Clock::time_point lastChange{};
+    bool pending = false;
+};
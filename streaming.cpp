@@ -0,0 +1,468 @@
+#include "streaming.hpp"
+#include "worldgen.hpp"
+#include "chunk_codec.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+
+ColumnSource terrain_column_source() {
+    return [](glm::ivec2 chunkXZ, int chunkY, int count, Voxel* out) {
+        float heights[CHUNK_SIZE * CHUNK_SIZE];
+        generate_column_heights(chunkXZ, heights);
+        for (int y = 0; y < count; ++y)
+            fill_chunk(glm::ivec3(chunkXZ.x, chunkY + y, chunkXZ.y), heights, out + (size_t)y * CHUNK_VOXELS);
+    };
+}
+
+
+glm::ivec3 centred_window_origin(glm::ivec3 dim, glm::vec3 camPos) {
+    glm::ivec3 camChunk = glm::ivec3(glm::floor(camPos / float(CHUNK_SIZE)));
+    return glm::ivec3(camChunk.x - dim.x / 2, 0, camChunk.z - dim.z / 2);
+}
+
+
+ChunkStreamer::ChunkStreamer(VoxelWorld& world, OctreeWorld& octree, JobSystem& jobs, ColumnSource source)
+    : world(world), octree(octree), jobs(jobs), source(std::move(source)),
+      slotFilled(world.chunkCount(), 1), windowOrigin(world.origin) {
+    latencySamples.reserve(STREAM_SAMPLES);
+    workSamples.reserve(STREAM_SAMPLES);
+}
+
+
+ChunkStreamer::~ChunkStreamer() {
+    std::unique_lock<std::mutex> lock(mutex);
+    closing = true;
+    changed.wait(lock, [&]() { return outstanding == 0; });
+}
+
+
+bool ChunkStreamer::wanted(glm::ivec2 column) const {
+    glm::ivec2 rel = column - glm::ivec2(windowOrigin.x, windowOrigin.z);
+    return !closing && rel.x >= 0 && rel.y >= 0 && rel.x < world.dim.x && rel.y < world.dim.z;
+}
+
+
+ChunkStreamer::BufferPtr ChunkStreamer::takeBuffers() {
+    if (freeBuffers.empty()) return std::make_shared<ColumnBuffers>();
+    BufferPtr buffers = std::move(freeBuffers.back());
+    freeBuffers.pop_back();
+    return buffers;
+}
+
+
+void ChunkStreamer::recycle(BufferPtr& buffers) {
+    // Still read by a compression job otherwise, it frees it when done
+    if (buffers && buffers.use_count() == 1) freeBuffers.push_back(std::move(buffers));
+    buffers.reset();
+}
+
+
+void ChunkStreamer::submit(JobPriority priority, std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        outstanding++;
+    }
+    jobs.submit(priority, [this, fn = std::move(fn)]() {
+        fn();
+        std::lock_guard<std::mutex> lock(mutex);
+        outstanding--;
+        changed.notify_all();
+    });
+}
+
+
+void ChunkStreamer::dropColumn(BufferPtr buffers) {
+    std::lock_guard<std::mutex> lock(mutex);
+    recycle(buffers);
+    inFlight--;
+    totals.dropped++;
+    changed.notify_all();
+}
+
+
+// Generates (source) or decodes (cache) a column, then chains its octree build
+void ChunkStreamer::loadColumn(glm::ivec2 column, Clock::time_point requested, std::shared_ptr<const Compressed> cached) {
+    PROFILE_SCOPE("stream load column");
+    BufferPtr buffers;
+    int chunkY;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!wanted(column)) {
+            inFlight--;
+            totals.dropped++;
+            changed.notify_all();
+            return;
+        }
+        buffers = takeBuffers();
+        chunkY = windowOrigin.y;
+    }
+
+    // The source can throw (a bad archive...), it surfaces from poll()
+    Clock::time_point start = Clock::now();
+    try {
+        buffers->voxels.resize((size_t)world.dim.y * CHUNK_VOXELS);
+        if (cached) {
+            for (int y = 0; y < world.dim.y; ++y) {
+                const std::vector<uint8_t>& payload = (*cached)[y];
+                decode_chunk(payload.data(), payload.size(), CHUNK_RLE, &buffers->voxels[(size_t)y * CHUNK_VOXELS]);
+            }
+        } else {
+            source(column, chunkY, world.dim.y, buffers->voxels.data());
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = std::current_exception();
+        recycle(buffers);
+        inFlight--;
+        changed.notify_all();
+        return;
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    submit(JOB_HIGH, [this, column, requested, buffers, ms]() { buildColumn(column, requested, buffers, ms); });
+}
+
+
+void ChunkStreamer::buildColumn(glm::ivec2 column, Clock::time_point requested, BufferPtr buffers, double workMs) {
+    PROFILE_SCOPE("stream build octrees");
+    bool stillWanted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stillWanted = wanted(column);
+    }
+    if (!stillWanted) {
+        dropColumn(std::move(buffers));
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+    buffers->pyramid.resize((size_t)world.dim.y * OCTREE_NODES_PER_CHUNK);
+    buffers->nodes.resize((size_t)world.dim.y * OCTREE_NODES_PER_CHUNK);
+    buffers->nodeCounts.resize(world.dim.y);
+    for (int y = 0; y < world.dim.y; ++y) {
+        uint32_t* pyramid = &buffers->pyramid[(size_t)y * OCTREE_NODES_PER_CHUNK];
+        build_chunk_pyramid(&buffers->voxels[(size_t)y * CHUNK_VOXELS], pyramid);
+        buffers->nodeCounts[y] = emit_sparse_chunk(pyramid, &buffers->nodes[(size_t)y * OCTREE_NODES_PER_CHUNK]);
+    }
+    workMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    done.push_back(Done{column, requested, std::move(buffers), workMs});
+    changed.notify_all();
+}
+
+
+// RLE encodes the raw copy of a column that left into the cache, evicting the least
+// recently used columns past STREAM_CACHE_BYTES
+void ChunkStreamer::compressColumn(ColumnKey k) {
+    PROFILE_SCOPE("stream compress column");
+    BufferPtr raw;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = leaving.find(k);
+        if (closing || it == leaving.end()) return;
+        raw = it->second;
+    }
+
+    auto chunks = std::make_shared<Compressed>(world.dim.y);
+    size_t bytes = 0;
+    for (int y = 0; y < world.dim.y; ++y) {
+        encode_chunk(&raw->voxels[(size_t)y * CHUNK_VOXELS], CHUNK_RLE, (*chunks)[y]);
+        bytes += (*chunks)[y].size();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = leaving.find(k);
+    // Came back into the window meanwhile, it gets copied again when it leaves
+    if (it == leaving.end() || it->second != raw) return;
+    leaving.erase(it);
+    recycle(raw);
+
+    auto old = cache.find(k);
+    if (old != cache.end()) {
+        cacheBytes -= old->second.bytes;
+        lru.erase(old->second.lru);
+        cache.erase(old);
+    }
+    lru.push_front(k);
+    cache.emplace(k, CacheEntry{chunks, bytes, lru.begin()});
+    cacheBytes += bytes;
+
+    while (cacheBytes > STREAM_CACHE_BYTES && !lru.empty()) {
+        auto victim = cache.find(lru.back());
+        cacheBytes -= victim->second.bytes;
+        cache.erase(victim);
+        lru.pop_back();
+    }
+}
+
+
+void ChunkStreamer::queueColumns(std::vector<glm::ivec2> columns) {
+    // Nearest to the window centre (the camera) first, jobs from here are started in order
+    glm::ivec2 centre = glm::ivec2(world.origin.x, world.origin.z) + glm::ivec2(world.dim.x, world.dim.z) / 2;
+    auto distance = [&](glm::ivec2 c) { glm::ivec2 d = glm::abs(c - centre); return std::max(d.x, d.y); };
+    std::stable_sort(columns.begin(), columns.end(), [&](glm::ivec2 a, glm::ivec2 b) { return distance(a) < distance(b); });
+
+    Clock::time_point now = Clock::now();
+    std::vector<std::pair<JobPriority, std::function<void()>>> toSubmit;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        windowOrigin = world.origin;
+
+        for (glm::ivec2 column : columns) {
+            inFlight++;
+            ColumnKey k = key(column);
+
+            // Left so recently it isn't even compressed yet : straight to the octree build
+            auto raw = leaving.find(k);
+            if (raw != leaving.end()) {
+                BufferPtr buffers = std::move(raw->second);
+                leaving.erase(raw);
+                totals.cacheHits++;
+                toSubmit.emplace_back(JOB_HIGH, [this, column, now, buffers]() { buildColumn(column, now, buffers, 0.0); });
+                continue;
+            }
+
+            std::shared_ptr<const Compressed> cached;
+            auto entry = cache.find(k);
+            if (entry != cache.end()) {
+                cached = entry->second.chunks;
+                lru.splice(lru.begin(), lru, entry->second.lru);
+                totals.cacheHits++;
+            }
+            toSubmit.emplace_back(JOB_NORMAL, [this, column, now, cached]() { loadColumn(column, now, cached); });
+        }
+    }
+    for (auto& job : toSubmit) submit(job.first, std::move(job.second));
+}
+
+
+// Air in the slots of a column of the window (current origin), voxels and octree
+static void clear_column(VoxelWorld& world, OctreeWorld& octree, std::vector<uint8_t>& slotFilled,
+                         glm::ivec2 column, std::vector<int>& slots) {
+    for (int y = 0; y < world.dim.y; ++y) {
+        int slot = world.chunkIndex(glm::ivec3(column.x, world.origin.y + y, column.y));
+        std::memset(&world.voxels[(size_t)slot * CHUNK_VOXELS], 0, CHUNK_VOXELS * sizeof(Voxel));
+        size_t nodes = (size_t)slot * OCTREE_NODES_PER_CHUNK;
+        std::fill(&octree.pyramid[nodes], &octree.pyramid[nodes] + OCTREE_NODES_PER_CHUNK, 0u);
+        octree.nodeCounts[slot] = emit_sparse_chunk(&octree.pyramid[nodes], &octree.nodes[nodes]);
+        slotFilled[slot] = 0;
+        slots.push_back(slot);
+    }
+}
+
+
+std::vector<int> ChunkStreamer::recentre(glm::vec3 camPos) {
+    glm::ivec3 oldOrigin = world.origin;
+    glm::ivec3 newOrigin = centred_window_origin(world.dim, camPos);
+    newOrigin.y = oldOrigin.y;
+    if (newOrigin == oldOrigin) return {};
+
+    auto inside = [&](glm::ivec2 column, glm::ivec3 origin) {
+        glm::ivec2 rel = column - glm::ivec2(origin.x, origin.z);
+        return rel.x >= 0 && rel.y >= 0 && rel.x < world.dim.x && rel.y < world.dim.z;
+    };
+
+    // Columns leaving : a raw copy of the ones that made it into the world, compressed later
+    std::vector<ColumnKey> toCompress;
+    for (int z = 0; z < world.dim.z; ++z)
+    for (int x = 0; x < world.dim.x; ++x) {
+        glm::ivec2 column(oldOrigin.x + x, oldOrigin.z + z);
+        if (inside(column, newOrigin)) continue;
+
+        bool filled = true;
+        for (int y = 0; y < world.dim.y; ++y)
+            filled = filled && slotFilled[world.chunkIndex(glm::ivec3(column.x, oldOrigin.y + y, column.y))];
+        if (!filled) continue;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        BufferPtr raw = takeBuffers();
+        raw->voxels.resize((size_t)world.dim.y * CHUNK_VOXELS);
+        for (int y = 0; y < world.dim.y; ++y) {
+            int slot = world.chunkIndex(glm::ivec3(column.x, oldOrigin.y + y, column.y));
+            std::memcpy(&raw->voxels[(size_t)y * CHUNK_VOXELS], &world.voxels[(size_t)slot * CHUNK_VOXELS], CHUNK_VOXELS * sizeof(Voxel));
+        }
+        BufferPtr& entry = leaving[key(column)];
+        recycle(entry);
+        entry = std::move(raw);
+        toCompress.push_back(key(column));
+    }
+
+    world.setOrigin(newOrigin);
+
+    // Columns entering, their slots held the ones that left
+    std::vector<glm::ivec2> columns;
+    std::vector<int> slots;
+    for (int z = 0; z < world.dim.z; ++z)
+    for (int x = 0; x < world.dim.x; ++x) {
+        glm::ivec2 column(newOrigin.x + x, newOrigin.z + z);
+        if (inside(column, oldOrigin)) continue;
+        columns.push_back(column);
+        clear_column(world, octree, slotFilled, column, slots);
+    }
+
+    queueColumns(columns);
+    for (ColumnKey k : toCompress) submit(JOB_LOW, [this, k]() { compressColumn(k); });
+
+    std::sort(slots.begin(), slots.end());
+    return slots;
+}
+
+
+std::vector<int> ChunkStreamer::requestAll() {
+    std::vector<glm::ivec2> columns;
+    std::vector<int> slots;
+    for (int z = 0; z < world.dim.z; ++z)
+    for (int x = 0; x < world.dim.x; ++x) {
+        glm::ivec2 column(world.origin.x + x, world.origin.z + z);
+        columns.push_back(column);
+        clear_column(world, octree, slotFilled, column, slots);
+    }
+
+    queueColumns(columns);
+    std::sort(slots.begin(), slots.end());
+    return slots;
+}
+
+
+void ChunkStreamer::addSample(double latencyMs, double workMs) {
+    if (latencySamples.size() < STREAM_SAMPLES) {
+        latencySamples.push_back(latencyMs);
+        workSamples.push_back(workMs);
+    } else {
+        latencySamples[nextSample] = latencyMs;
+        workSamples[nextSample] = workMs;
+    }
+    nextSample = (nextSample + 1) % STREAM_SAMPLES;
+}
+
+
+std::vector<int> ChunkStreamer::collect(int maxChunks, bool wait) {
+    std::vector<Done> ready;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait) changed.wait(lock, [&]() { return error || !done.empty() || inFlight == 0; });
+        if (error) {
+            std::exception_ptr failure = error;
+            error = nullptr;
+            std::rethrow_exception(failure);
+        }
+
+        // Whole columns, as long as they fit in maxChunks (always at least one)
+        size_t take = done.size();
+        if (maxChunks >= 0) take = std::min(take, std::max<size_t>(1, maxChunks / world.dim.y));
+        ready.assign(std::make_move_iterator(done.begin()), std::make_move_iterator(done.begin() + take));
+        done.erase(done.begin(), done.begin() + take);
+    }
+
+    std::vector<int> slots;
+    size_t chunks = 0, dropped = 0;
+    Clock::time_point now = Clock::now();
+    for (Done& d : ready) {
+        // Left the window after its build started
+        if (!world.containsChunk(glm::ivec3(d.column.x, world.origin.y, d.column.y))) {
+            dropped++;
+            continue;
+        }
+
+        double latencyMs = std::chrono::duration<double, std::milli>(now - d.requested).count();
+        const ColumnBuffers& b = *d.buffers;
+        for (int y = 0; y < world.dim.y; ++y) {
+            int slot = world.chunkIndex(glm::ivec3(d.column.x, world.origin.y + y, d.column.y));
+            size_t nodes = (size_t)slot * OCTREE_NODES_PER_CHUNK;
+            std::memcpy(&world.voxels[(size_t)slot * CHUNK_VOXELS], &b.voxels[(size_t)y * CHUNK_VOXELS], CHUNK_VOXELS * sizeof(Voxel));
+            std::memcpy(&octree.pyramid[nodes], &b.pyramid[(size_t)y * OCTREE_NODES_PER_CHUNK], OCTREE_NODES_PER_CHUNK * sizeof(uint32_t));
+            std::memcpy(&octree.nodes[nodes], &b.nodes[(size_t)y * OCTREE_NODES_PER_CHUNK], b.nodeCounts[y] * sizeof(uint32_t));
+            octree.nodeCounts[slot] = b.nodeCounts[y];
+            slotFilled[slot] = 1;
+            slots.push_back(slot);
+            addSample(latencyMs, d.workMs / world.dim.y);
+        }
+        chunks += world.dim.y;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Done& d : ready) recycle(d.buffers);
+        inFlight -= (int)ready.size();
+        totals.chunks += chunks;
+        totals.dropped += dropped;
+    }
+
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    return slots;
+}
+
+
+std::vector<std::vector<int>> group_columns(const VoxelWorld& world, const std::vector<int>& slots) {
+    std::vector<std::vector<int>> columns;
+    std::map<std::pair<int, int>, size_t> index;
+    for (int slot : slots) {
+        glm::ivec3 c = world.slotChunk(slot);
+        auto it = index.emplace(std::make_pair(c.x, c.z), columns.size()).first;
+        if (it->second == columns.size()) columns.emplace_back();
+        columns[it->second].push_back(slot);
+    }
+    return columns;
+}
+
+
+std::vector<int> ChunkStreamer::poll(int maxChunks) {
+    return collect(maxChunks, false);
+}
+
+
+std::vector<int> ChunkStreamer::finish() {
+    std::vector<int> slots;
+    while (pending() > 0) {
+        std::vector<int> more = collect(-1, true);
+        slots.insert(slots.end(), more.begin(), more.end());
+    }
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    return slots;
+}
+
+
+size_t ChunkStreamer::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (size_t)inFlight * world.dim.y;
+}
+
+
+StreamStats ChunkStreamer::stats() const {
+    StreamStats s;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        s = totals;
+        s.cacheBytes = cacheBytes;
+    }
+    auto summarize = [](std::vector<double> samples, double& avg, double& p99) {
+        if (samples.empty()) return;
+        std::sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for (double v : samples) sum += v;
+        avg = sum / samples.size();
+        p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    };
+    summarize(latencySamples, s.avgLatencyMs, s.p99LatencyMs);
+    summarize(workSamples, s.avgGenerateMs, s.p99GenerateMs);
+    return s;
+}
+
+
+void reset_streamed_distances(DistanceField& distance, const std::vector<int>& slots) {
+    for (int slot : slots) std::memset(&distance.dist[(size_t)slot * CHUNK_VOXELS], 1, CHUNK_VOXELS);
+}
+
+
+std::vector<int> update_streamed_distances(const VoxelWorld& world, DistanceField& distance,
+                                           const std::vector<int>& slots, int threads) {
+    if (slots.empty()) return {};
+    return update_distance_field_chunks(world, distance, slots, threads);
+}
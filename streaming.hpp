@@ -0,0 +1,171 @@
+#pragma once
+
+#include "world.hpp"
+#include "octree.hpp"
+#include "distance_field.hpp"
+#include "job_system.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Infinite world : the VoxelWorld becomes a fixed window of chunks that follows the
+// camera in x and z (y stays at chunk 0). The window is a toroidal ring (see
+// VoxelWorld::origin), so when the camera crosses a chunk border only the column(s)
+// that left the window get replaced, and memory never grows however far it flies.
+//
+// recentre() moves the window, clears the slots that changed hands to air and queues
+// their chunk columns on the JobSystem, nearest to the camera first :
+//   JOB_NORMAL  generate (or load) the column, or decompress it from the cache
+//   JOB_HIGH    build its octrees (pyramid and sparse nodes), chained on the same worker
+//   JOB_LOW     RLE compress the columns that left into the column cache, so coming back
+//               is a decode instead of a generation, and edits survive leaving the window
+// poll() copies the finished columns (voxels and octrees) into their slots on the
+// calling thread. Columns that left the window again before being done are dropped.
+//
+// The distance field and the GPU side of the slots are up to the caller, see
+// reset_streamed_distances() and update_streamed_distances().
+
+// Fills `count` chunks of the column chunkXZ, starting at chunk y `chunkY`, one after
+// the other into out. Called from the worker threads.
+using ColumnSource = std::function<void(glm::ivec2 chunkXZ, int chunkY, int count, Voxel* out)>;
+
+// worldgen.hpp terrain
+ColumnSource terrain_column_source();
+
+// Origin of a dim window centred on camPos in x and z, at chunk y 0
+glm::ivec3 centred_window_origin(glm::ivec3 dim, glm::vec3 camPos);
+
+
+// Per chunk timings, over the last STREAM_SAMPLES chunks so they don't grow either
+struct StreamStats {
+    size_t chunks = 0;              // copied into the world since the start
+    size_t dropped = 0;             // columns that left the window before being used
+    size_t cacheHits = 0;           // columns decoded from the cache instead of generated
+    size_t cacheBytes = 0;          // compressed columns held, at most STREAM_CACHE_BYTES
+    double avgLatencyMs = 0.0;      // recentre() asking for it -> poll() copying it in
+    double p99LatencyMs = 0.0;
+    double avgGenerateMs = 0.0;     // worker time (generate or decode, octree), a column's split over its chunks
+    double p99GenerateMs = 0.0;
+};
+
+const size_t STREAM_SAMPLES = 4096;
+const size_t STREAM_CACHE_BYTES = 64u << 20;
+
+// Chunks poll() brings into the world per frame at most
+const int STREAM_CHUNKS_PER_FRAME = 8;
+
+
+class ChunkStreamer {
+public:
+    // The jobs run on `jobs`, which has to outlive the streamer
+    ChunkStreamer(VoxelWorld& world, OctreeWorld& octree, JobSystem& jobs, ColumnSource source);
+    // Waits for its jobs still running, drops the queued ones
+    ~ChunkStreamer();
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    // Moves the window over camPos. Returns the slots that were cleared (voxels and
+    // octree, the distance field is the caller's), empty when the camera is still over
+    // the same chunk.
+    std::vector<int> recentre(glm::vec3 camPos);
+
+    // Clears the whole window and queues every column of it, for the first fill
+    std::vector<int> requestAll();
+
+    // Copies up to maxChunks finished chunks (< 0 : all of them) into the world and the
+    // octree, returns their slots
+    std::vector<int> poll(int maxChunks = -1);
+
+    // Blocks until everything queued is in the world, returns the slots
+    std::vector<int> finish();
+
+    size_t pending() const;         // chunks queued or being worked on, not in the world yet
+    StreamStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using ColumnKey = uint64_t;
+
+    // Everything a column needs on its way to the world, recycled
+    struct ColumnBuffers {
+        std::vector<Voxel> voxels;          // world.dim.y chunks
+        std::vector<uint32_t> pyramid;      // OCTREE_NODES_PER_CHUNK per chunk
+        std::vector<uint32_t> nodes;        // OCTREE_NODES_PER_CHUNK per chunk
+        std::vector<uint32_t> nodeCounts;
+    };
+    // Shared : a column's raw copy can be read by its compression job and taken back by a re-entry at once
+    using BufferPtr = std::shared_ptr<ColumnBuffers>;
+    struct Done {
+        glm::ivec2 column;
+        Clock::time_point requested;
+        BufferPtr buffers;
+        double workMs;
+    };
+    // RLE payloads of one column's chunks, in VOXEL_LAYOUT order like the world
+    using Compressed = std::vector<std::vector<uint8_t>>;
+    struct CacheEntry {
+        std::shared_ptr<const Compressed> chunks;
+        size_t bytes;
+        std::list<ColumnKey>::iterator lru;
+    };
+
+    static ColumnKey key(glm::ivec2 column) { return (uint64_t(uint32_t(column.x)) << 32) | uint32_t(column.y); }
+
+    void queueColumns(std::vector<glm::ivec2> columns);
+    void submit(JobPriority priority, std::function<void()> fn);
+    bool wanted(glm::ivec2 column) const;           // still in the window, lock held
+    BufferPtr takeBuffers();                        // lock held
+    void recycle(BufferPtr& buffers);               // lock held
+    void dropColumn(BufferPtr buffers);             // a job gives up on its column
+    void loadColumn(glm::ivec2 column, Clock::time_point requested, std::shared_ptr<const Compressed> cached);
+    void buildColumn(glm::ivec2 column, Clock::time_point requested, BufferPtr buffers, double workMs);
+    void compressColumn(ColumnKey k);
+    std::vector<int> collect(int maxChunks, bool wait);
+    void addSample(double latencyMs, double workMs);
+
+    VoxelWorld& world;
+    OctreeWorld& octree;
+    JobSystem& jobs;
+    ColumnSource source;
+    std::vector<uint8_t> slotFilled;    // calling thread only : the slot holds its chunk (not cleared air)
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    glm::ivec3 windowOrigin;                                    // world.origin, for the jobs
+    int inFlight = 0;                                           // columns asked for, not done nor dropped
+    int outstanding = 0;                                        // jobs submitted and not finished
+    bool closing = false;
+    std::exception_ptr error;                                   // from the source, rethrown by poll()
+    std::vector<Done> done;
+    std::vector<BufferPtr> freeBuffers;
+    std::unordered_map<ColumnKey, BufferPtr> leaving;           // raw copies waiting for compression
+    std::unordered_map<ColumnKey, CacheEntry> cache;
+    std::list<ColumnKey> lru;                                   // most recently used first
+    size_t cacheBytes = 0;
+
+    StreamStats totals;
+    std::vector<double> latencySamples, workSamples;
+    size_t nextSample = 0;
+};
+
+
+// Distances of the slots recentre() cleared : 1 (always a safe step) until the chunk
+// arrives. Neighbours keep distances that counted the departed chunks, which are only
+// ever too small.
+void reset_streamed_distances(DistanceField& distance, const std::vector<int>& slots);
+
+// Splits slots (poll()'s output, sorted by slot, so by level and not by column) into
+// one list per chunk column, for handling a column as a whole
+std::vector<std::vector<int>> group_columns(const VoxelWorld& world, const std::vector<int>& slots);
+
+// Distance field around the slots poll() filled. Returns the chunks whose distances
+// changed, sorted.
+std::vector<int> update_streamed_distances(const VoxelWorld& world, DistanceField& distance,
+                                           const std::vector<int>& slots, int threads = 0);
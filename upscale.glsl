@@ -0,0 +1,58 @@
+#version 430 core
+
+// Dynamic resolution (main.cpp, SceneTargets) : shader.glsl drew renderSize pixels in
+// the bottom-left corner of colorTex, stretched here over the whole output. Bilinear,
+// same as upscale_image() in dynamic_resolution.cpp.
+// With temporal = 1 the previous output is reprojected onto this frame (hit distance
+// and previous camera) and blended in, clamped to the colors around the pixel so that
+// disocclusions don't ghost. The raymarch jitters its pixels every frame, so the
+// history gathers more than renderSize samples.
+
+in vec2 uv;
+out vec4 finalColor;
+
+uniform sampler2D colorTex;
+uniform sampler2D depthTex;     // hitDistance of shader.glsl, 0 = nothing hit
+uniform sampler2D historyTex;   // previous output, outputSize
+uniform vec2 renderSize;
+uniform vec2 outputSize;
+uniform vec2 jitter;            // what shader.glsl added to gl_FragCoord this frame
+uniform int temporal;
+uniform float historyWeight;    // 0 on the first frame
+uniform vec3 camPos;
+uniform vec3 camRot;
+uniform vec3 prevCamPos;
+uniform vec3 prevCamRot;
+uniform float FOV;
+
+#include "camera.glsl"
+
+void main() {
+    // This pixel in raymarched pixels, and the texel that covers it
+    vec2 p = gl_FragCoord.xy * renderSize / outputSize - jitter;
+    vec2 texSize = vec2(textureSize(colorTex, 0));
+    vec4 current = texture(colorTex, clamp(p, vec2(0.5), renderSize - 0.5) / texSize);
+    finalColor = current;
+    if (temporal == 0 || historyWeight <= 0.0) return;
+
+    ivec2 texel = clamp(ivec2(floor(p)), ivec2(0), ivec2(renderSize) - 1);
+    float dist = texelFetch(depthTex, texel, 0).r;
+    vec3 rd = cameraRayDir(gl_FragCoord.xy, outputSize, camRot, FOV);
+    // Sky : far enough that only the rotation matters
+    vec3 worldPos = camPos + rd * (dist > 0.0 ? dist : 1e5);
+
+    vec2 prevCoord;
+    if (!cameraProject(worldPos, prevCamPos, prevCamRot, FOV, outputSize, prevCoord)) return;
+    if (any(lessThan(prevCoord, vec2(0.0))) || any(greaterThanEqual(prevCoord, outputSize))) return;
+    vec4 history = texture(historyTex, prevCoord / outputSize);
+
+    vec4 lo = current, hi = current;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec4 c = texelFetch(colorTex, clamp(texel + ivec2(x, y), ivec2(0), ivec2(renderSize) - 1), 0);
+            lo = min(lo, c);
+            hi = max(hi, c);
+        }
+    }
+    finalColor = mix(current, clamp(history, lo, hi), historyWeight);
+}
@@ -0,0 +1,59 @@
+// Order of the voxels inside a chunk, shader copy of voxel_layout.hpp. Shaders pull
+// it in with #include "voxel_layout.glsl" : main.cpp expands the include and defines
+// VOXEL_LAYOUT, VOXEL_CHUNK_SHIFT and VOXEL_BRICK_SHIFT from the C++ constants.
+//   0 : linear, x fastest
+//   1 : Morton, x y z bits interleaved
+//   2 : 2^VOXEL_BRICK_SHIFT bricks, linear inside a brick
+
+#ifndef VOXEL_LAYOUT
+#define VOXEL_LAYOUT 0
+#define VOXEL_CHUNK_SHIFT 5
+#define VOXEL_BRICK_SHIFT 2
+#endif
+
+// Low 10 bits of v to every third bit
+int layoutSpreadBits(int v) {
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+int layoutCompactBits(int v) {
+    v &= 0x09249249;
+    v = (v | (v >> 2)) & 0x030C30C3;
+    v = (v | (v >> 4)) & 0x0300F00F;
+    v = (v | (v >> 8)) & 0x030000FF;
+    v = (v | (v >> 16)) & 0x000003FF;
+    return v;
+}
+
+// Index of a voxel inside its chunk, local in [0, chunkSize)
+int chunkLocalIndex(ivec3 local) {
+#if VOXEL_LAYOUT == 1
+    return layoutSpreadBits(local.x) | (layoutSpreadBits(local.y) << 1) | (layoutSpreadBits(local.z) << 2);
+#elif VOXEL_LAYOUT == 2
+    const int b = VOXEL_BRICK_SHIFT, m = (1 << b) - 1, s = VOXEL_CHUNK_SHIFT - b;
+    int brick = ((local.z >> b) << (2 * s)) | ((local.y >> b) << s) | (local.x >> b);
+    return (brick << (3 * b)) | ((local.z & m) << (2 * b)) | ((local.y & m) << b) | (local.x & m);
+#else
+    return (local.z << (2 * VOXEL_CHUNK_SHIFT)) | (local.y << VOXEL_CHUNK_SHIFT) | local.x;
+#endif
+}
+
+// Inverse of chunkLocalIndex
+ivec3 chunkLocalCoord(int index) {
+#if VOXEL_LAYOUT == 1
+    return ivec3(layoutCompactBits(index), layoutCompactBits(index >> 1), layoutCompactBits(index >> 2));
+#elif VOXEL_LAYOUT == 2
+    const int b = VOXEL_BRICK_SHIFT, m = (1 << b) - 1, s = VOXEL_CHUNK_SHIFT - b, bm = (1 << s) - 1;
+    int brick = index >> (3 * b);
+    return ivec3(((brick & bm) << b) | (index & m),
+                 (((brick >> s) & bm) << b) | ((index >> b) & m),
+                 ((brick >> (2 * s)) << b) | ((index >> (2 * b)) & m));
+#else
+    const int mask = (1 << VOXEL_CHUNK_SHIFT) - 1;
+    return ivec3(index & mask, (index >> VOXEL_CHUNK_SHIFT) & mask, index >> (2 * VOXEL_CHUNK_SHIFT));
+#endif
+}
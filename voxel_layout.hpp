@@ -0,0 +1,100 @@
+#pragma once
+
+// Order of the voxels inside a chunk, picked at build time (cmake -DVOXEL_LAYOUT=...).
+// Chunks themselves stay in z, y, x order, only the index of a voxel inside its chunk
+// changes. voxel_layout.glsl is the shader copy of this file, main.cpp defines
+// VOXEL_LAYOUT / VOXEL_CHUNK_SHIFT / VOXEL_BRICK_SHIFT for it when loading shaders.
+//
+//   LAYOUT_LINEAR : x fastest, then y, then z. A step along y is 128 B, along z 4 KiB.
+//   LAYOUT_MORTON : bits of x, y and z interleaved (x lowest), every aligned 2^n cube
+//                   is contiguous. Same order as the octree pyramid leaves.
+//   LAYOUT_BRICK  : 4^3 bricks in x, y, z order, linear inside a brick, so a brick
+//                   is 256 B (4 cache lines) and any unit step inside it stays there.
+//
+// Chunk files and archive payloads are always linear (that's what data/utils.py
+// writes), loaders convert with chunk_from_linear() / chunk_to_linear() in world.hpp.
+//
+// The index functions are templates over the integer type so the SIMD packet kernels
+// (GCC vectors) share them with the scalar code.
+
+enum VoxelLayout {
+    LAYOUT_LINEAR = 0,
+    LAYOUT_MORTON = 1,
+    LAYOUT_BRICK = 2,
+};
+
+#ifndef SHADERDEMO_VOXEL_LAYOUT
+#define SHADERDEMO_VOXEL_LAYOUT 0
+#endif
+
+const VoxelLayout VOXEL_LAYOUT = VoxelLayout(SHADERDEMO_VOXEL_LAYOUT);
+const int VOXEL_BRICK_SHIFT = 2;    // 4^3 bricks
+
+static_assert(VOXEL_LAYOUT >= LAYOUT_LINEAR && VOXEL_LAYOUT <= LAYOUT_BRICK, "unknown SHADERDEMO_VOXEL_LAYOUT");
+
+inline const char* voxel_layout_name(VoxelLayout layout) {
+    switch (layout) {
+    case LAYOUT_LINEAR: return "linear";
+    case LAYOUT_MORTON: return "morton";
+    case LAYOUT_BRICK: return "brick";
+    }
+    return "?";
+}
+
+
+// Low 10 bits of v to every third bit
+template <typename T>
+inline T layout_spread_bits(T v) {
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// Inverse of layout_spread_bits
+template <typename T>
+inline T layout_compact_bits(T v) {
+    v &= 0x09249249;
+    v = (v | (v >> 2)) & 0x030C30C3;
+    v = (v | (v >> 4)) & 0x0300F00F;
+    v = (v | (v >> 8)) & 0x030000FF;
+    v = (v | (v >> 16)) & 0x000003FF;
+    return v;
+}
+
+
+// Index inside a chunk of 2^Shift voxels per side, x y z in [0, 2^Shift)
+template <VoxelLayout Layout, int Shift, typename T>
+inline T layout_local_index(T x, T y, T z) {
+    if (Layout == LAYOUT_MORTON) {
+        return layout_spread_bits(x) | (layout_spread_bits(y) << 1) | (layout_spread_bits(z) << 2);
+    } else if (Layout == LAYOUT_BRICK) {
+        const int b = VOXEL_BRICK_SHIFT, m = (1 << b) - 1, s = Shift - b;
+        T brick = ((z >> b) << (2 * s)) | ((y >> b) << s) | (x >> b);
+        return (brick << (3 * b)) | ((z & m) << (2 * b)) | ((y & m) << b) | (x & m);
+    } else {
+        return (z << (2 * Shift)) | (y << Shift) | x;
+    }
+}
+
+// Inverse of layout_local_index, scalar only
+template <VoxelLayout Layout, int Shift>
+inline void layout_local_coord(int index, int& x, int& y, int& z) {
+    const int mask = (1 << Shift) - 1;
+    if (Layout == LAYOUT_MORTON) {
+        x = layout_compact_bits(index);
+        y = layout_compact_bits(index >> 1);
+        z = layout_compact_bits(index >> 2);
+    } else if (Layout == LAYOUT_BRICK) {
+        const int b = VOXEL_BRICK_SHIFT, m = (1 << b) - 1, s = Shift - b, bm = (1 << s) - 1;
+        int brick = index >> (3 * b);
+        x = ((brick & bm) << b) | (index & m);
+        y = (((brick >> s) & bm) << b) | ((index >> b) & m);
+        z = ((brick >> (2 * s)) << b) | ((index >> (2 * b)) & m);
+    } else {
+        x = index & mask;
+        y = (index >> Shift) & mask;
+        z = index >> (2 * Shift);
+    }
+}
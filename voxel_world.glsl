@@ -0,0 +1,197 @@
+// The voxel buffers of the world window and the lookups through them, shared by
+// shader.glsl and cone.glsl. Same as the lookups at the top of cpu_raymarch.cpp.
+
+uniform int chunkSize;
+uniform ivec3 worldDim;
+uniform ivec3 worldOrigin;      // first chunk of the buffer window, moved by --stream
+uniform ivec3 worldOriginSlot;  // worldOrigin mod worldDim, its slot in the chunk ring
+
+uniform int traversalMode;     // 0 = voxel DDA, 1 = DDA leaping over empty octree nodes, 2 = over empty chunks,
+                               // 3 = over the empty cube from the distance field
+uniform int voxelFormat;       // 0 = voxels[] (binding 0), 1 = palette packed (bindings 7 to 9)
+
+struct Voxel {
+    uint material;
+};
+
+layout(std430, binding = 0) buffer VoxelData {
+    Voxel voxels[];
+};
+
+// Sparse octree per chunk, see octree.hpp for the encoding. The chunks are packed,
+// chunk c's nodes start at octreeOffsets[c] (OctreeSlots).
+layout(std430, binding = 1) buffer OctreeData {
+    uint octreeNodes[];
+};
+layout(std430, binding = 11) buffer OctreeOffsets {
+    uint octreeOffsets[];
+};
+
+// Per chunk : 0 = empty, a material = whole chunk of it, CHUNK_MIXED
+layout(std430, binding = 4) buffer ChunkOccupancy {
+    uint chunkOccupancy[];
+};
+
+const uint CHUNK_MIXED = 0xFFFFFFFFu;
+
+// How chunkLookup() reads it, raymarch_compute.glsl goes through its shared memory copy
+#ifndef CHUNK_OCCUPANCY
+#define CHUNK_OCCUPANCY(chunk) chunkOccupancy[chunk]
+#endif
+
+// Chebyshev distance per voxel, bytes packed 4 per uint (see distance_field.glsl)
+layout(std430, binding = 5) buffer DistanceField {
+    uint distField[];
+};
+
+// Palette packed voxels, see packed_world.hpp : per chunk word offset, palette offset,
+// bits (0, 1, 2, 4, 8 or 16) and palette size
+layout(std430, binding = 7) buffer PackedChunks {
+    uvec4 packedChunks[];
+};
+layout(std430, binding = 8) buffer PackedPalettes {
+    uint palettes[];
+};
+layout(std430, binding = 9) buffer PackedWords {
+    uint packedWords[];
+};
+
+const uint OCTREE_LEAF = 0x80000000u;
+
+
+int floor_div(int a, int b) {
+    return (a >= 0 ? a / b : ((a - b + 1) / b));
+}
+
+#include "voxel_layout.glsl"
+
+// Slot of a chunk in the toroidal chunk ring (VoxelWorld::chunkIndex), -1 outside of the window
+int chunkSlot(ivec3 chunkCoord) {
+    ivec3 rel = chunkCoord - worldOrigin;
+    if (any(lessThan(rel, ivec3(0))) || any(greaterThanEqual(rel, worldDim))) {
+        return -1;
+    }
+    ivec3 s = rel + worldOriginSlot;
+    s -= ivec3(greaterThanEqual(s, worldDim)) * worldDim;
+    return s.z * worldDim.y * worldDim.x + s.y * worldDim.x + s.x;
+}
+
+int worldToIndex3D(ivec3 pos) {
+
+    ivec3 chunkCoord = ivec3(
+        floor_div(pos.x, chunkSize),
+        floor_div(pos.y, chunkSize),
+        floor_div(pos.z, chunkSize)
+    );
+
+    int chunkIndex = chunkSlot(chunkCoord);
+    if (chunkIndex < 0) {
+        return -1;
+    }
+
+    ivec3 local = pos - chunkCoord * chunkSize;
+    return chunkIndex * chunkSize * chunkSize * chunkSize + chunkLocalIndex(local);
+}
+
+
+
+// Material of the voxel at buffer index idx (from worldToIndex3D), raw or packed
+uint voxelMaterial(int idx) {
+    if (voxelFormat == 0) return voxels[idx].material;
+
+    int chunkVoxels = chunkSize * chunkSize * chunkSize;
+    uvec4 info = packedChunks[idx / chunkVoxels];
+    if (info.z == 0u) return palettes[info.y];
+
+    uint bit = uint(idx % chunkVoxels) * info.z;
+    uint index = (packedWords[info.x + (bit >> 5)] >> (bit & 31u)) & ((1u << info.z) - 1u);
+    return palettes[info.y + index];
+}
+
+
+
+// Material at pos, and size of the biggest uniform octree node containing it
+uint octreeLookup(ivec3 pos, out int nodeSize) {
+    ivec3 chunkCoord = ivec3(
+        floor_div(pos.x, chunkSize),
+        floor_div(pos.y, chunkSize),
+        floor_div(pos.z, chunkSize)
+    );
+
+    nodeSize = 1;
+    int chunkIndex = chunkSlot(chunkCoord);
+    if (chunkIndex < 0) {
+        return 0u;
+    }
+
+    ivec3 local = pos - chunkCoord * chunkSize;
+    int base = int(octreeOffsets[chunkIndex]);
+
+    uint node = octreeNodes[base];
+    nodeSize = chunkSize;
+    while ((node & OCTREE_LEAF) == 0u) {
+        nodeSize >>= 1;
+        uint octant = ((local.x & nodeSize) != 0 ? 1u : 0u) | ((local.y & nodeSize) != 0 ? 2u : 0u) | ((local.z & nodeSize) != 0 ? 4u : 0u);
+        uint childMask = node & 0xFFu;
+        if ((childMask & (1u << octant)) == 0u) return 0u;
+
+        uint first = (node >> 8) & 0x7FFFFFu;
+        node = octreeNodes[base + int(first) + bitCount(childMask & ((1u << octant) - 1u))];
+    }
+    return node & ~OCTREE_LEAF;
+}
+
+
+// Material at pos, and chunkSize as nodeSize when the whole chunk is air
+uint chunkLookup(ivec3 pos, out int nodeSize) {
+    nodeSize = 1;
+    int idx = worldToIndex3D(pos);
+    if (idx < 0) return 0u;
+
+    uint occ = CHUNK_OCCUPANCY(idx / (chunkSize * chunkSize * chunkSize));
+    if (occ == 0u) {
+        nodeSize = chunkSize;
+        return 0u;
+    }
+    if (occ != CHUNK_MIXED) return occ;
+    return voxelMaterial(idx);
+}
+
+
+// Material at pos, and the empty cube around it from the distance field when it's air
+uint distanceLookup(ivec3 pos, out ivec3 emptyMin, out int nodeSize) {
+    emptyMin = pos;
+    nodeSize = 1;
+    int idx = worldToIndex3D(pos);
+    if (idx < 0) return 0u;
+
+    uint material = voxelMaterial(idx);
+    int d = int((distField[idx >> 2] >> (8 * (idx & 3))) & 0xFFu);
+    if (material == 0u && d > 1) {
+        emptyMin = pos - (d - 1);
+        nodeSize = 2 * d - 1;
+    }
+    return material;
+}
+
+
+// Material at pos, and the empty box [emptyMin, emptyMin + emptySize) around it that
+// traversalMode knows of when it's air (size 1 : just this voxel)
+uint voxelLookup(ivec3 pos, out ivec3 emptyMin, out int emptySize) {
+    uint material = 0u;
+    emptySize = 1;
+    emptyMin = pos;
+    if (traversalMode == 1) {
+        material = octreeLookup(pos, emptySize);
+        emptyMin = pos & ~(emptySize - 1);
+    } else if (traversalMode == 2) {
+        material = chunkLookup(pos, emptySize);
+        emptyMin = pos & ~(emptySize - 1);
+    } else if (traversalMode == 3) {
+        material = distanceLookup(pos, emptyMin, emptySize);
+    } else {
+        int idx = worldToIndex3D(pos);
+        if (idx >= 0) material = voxelMaterial(idx);
+    }
+    return material;
+}
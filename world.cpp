@@ -0,0 +1,116 @@
+#include "world.hpp"
+#include "parallel.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+
+VoxelWorld::VoxelWorld(glm::ivec3 dim)
+    : dim(dim), voxels((size_t)dim.x * dim.y * dim.z * CHUNK_VOXELS, Voxel{0u}) {}
+
+
+void VoxelWorld::setOrigin(glm::ivec3 chunkOrigin) {
+    origin = chunkOrigin;
+    originSlot = glm::ivec3(
+        (origin.x % dim.x + dim.x) % dim.x,
+        (origin.y % dim.y + dim.y) % dim.y,
+        (origin.z % dim.z + dim.z) % dim.z
+    );
+}
+
+
+bool VoxelWorld::setVoxel(glm::ivec3 pos, uint32_t material) {
+    int idx = worldToIndex3D(pos);
+    if (idx < 0 || voxels[idx].material == material) return false;
+
+    voxels[idx].material = material;
+    dirtyVoxels.push_back((uint32_t)idx);
+    return true;
+}
+
+
+size_t VoxelWorld::fillBox(glm::ivec3 boxMin, glm::ivec3 boxMax, uint32_t material) {
+    glm::ivec3 lo = glm::max(boxMin, voxelOrigin());
+    glm::ivec3 hi = glm::min(boxMax, voxelOrigin() + voxelDim() - 1);
+
+    size_t changed = 0;
+    for (int z = lo.z; z <= hi.z; ++z)
+    for (int y = lo.y; y <= hi.y; ++y)
+    for (int x = lo.x; x <= hi.x; ++x) {
+        if (setVoxel(glm::ivec3(x, y, z), material)) changed++;
+    }
+    return changed;
+}
+
+
+uint32_t chunk_occupancy(const Voxel* chunkVoxels) {
+    uint32_t first = chunkVoxels[0].material;
+    for (size_t i = 1; i < CHUNK_VOXELS; ++i)
+        if (chunkVoxels[i].material != first) return CHUNK_MIXED;
+    return first;
+}
+
+
+void build_occupancy(const VoxelWorld& world, std::vector<uint32_t>& occupancy, int threads) {
+    occupancy.resize(world.chunkCount());
+    parallel_for((int)world.chunkCount(), threads, [&](int c) {
+        occupancy[c] = chunk_occupancy(world.voxels.data() + (size_t)c * CHUNK_VOXELS);
+    });
+}
+
+
+void chunk_from_linear(const Voxel* linear, Voxel* out) {
+    if (VOXEL_LAYOUT == LAYOUT_LINEAR) {
+        if (out != linear) std::memcpy(out, linear, CHUNK_VOXELS * sizeof(Voxel));
+        return;
+    }
+    int i = 0;
+    for (int z = 0; z < CHUNK_SIZE; ++z)
+    for (int y = 0; y < CHUNK_SIZE; ++y)
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+        out[chunk_local_index(glm::ivec3(x, y, z))] = linear[i++];
+}
+
+
+void chunk_to_linear(const Voxel* chunkVoxels, Voxel* linear) {
+    if (VOXEL_LAYOUT == LAYOUT_LINEAR) {
+        std::memcpy(linear, chunkVoxels, CHUNK_VOXELS * sizeof(Voxel));
+        return;
+    }
+    int i = 0;
+    for (int z = 0; z < CHUNK_SIZE; ++z)
+    for (int y = 0; y < CHUNK_SIZE; ++y)
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+        linear[i++] = chunkVoxels[chunk_local_index(glm::ivec3(x, y, z))];
+}
+
+
+void chunk_from_linear(Voxel* chunkVoxels) {
+    if (VOXEL_LAYOUT == LAYOUT_LINEAR) return;
+    thread_local std::vector<Voxel> scratch(CHUNK_VOXELS);
+    std::memcpy(scratch.data(), chunkVoxels, CHUNK_VOXELS * sizeof(Voxel));
+    chunk_from_linear(scratch.data(), chunkVoxels);
+}
+
+
+void loadChunkFile(VoxelWorld& world, const std::string& filepath, glm::ivec3 chunkCoord) {
+    std::ifstream in(filepath, std::ios::binary);
+    if (!in) throw std::runtime_error("Failed to open chunk file : " + filepath);
+
+    size_t offset = (size_t)world.chunkIndex(chunkCoord) * CHUNK_VOXELS;
+    in.read(reinterpret_cast<char*>(world.voxels.data() + offset), CHUNK_VOXELS * sizeof(Voxel));
+    if (in.gcount() != (std::streamsize)(CHUNK_VOXELS * sizeof(Voxel)))
+        throw std::runtime_error("Chunk file is truncated : " + filepath);
+    chunk_from_linear(world.voxels.data() + offset);
+}
+
+
+void loadChunkDirectory(VoxelWorld& world, const std::string& directory) {
+    for (int z = 0; z < world.dim.z; ++z)
+    for (int y = 0; y < world.dim.y; ++y)
+    for (int x = 0; x < world.dim.x; ++x) {
+        std::string filename = directory + "/chunk-" + std::to_string(x) + "-" + std::to_string(y) + "-" + std::to_string(z) + ".bin";
+        loadChunkFile(world, filename, glm::ivec3(x, y, z));
+    }
+}
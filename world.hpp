@@ -0,0 +1,160 @@
+#pragma once
+
+#include "voxel_layout.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Shared world constants, used by main.cpp and the CPU side of things.
+// The shaders get the same values through the chunkSize / worldDim uniforms.
+const int CHUNK_SIZE = 32;
+const int CHUNK_SHIFT = 5;      // log2(CHUNK_SIZE)
+const glm::ivec3 WORLD_DIM = glm::ivec3(16, 2, 16);  // Wx, Wy, Wz
+
+const size_t CHUNK_VOXELS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+const size_t TOTAL_CHUNKS = WORLD_DIM.x * WORLD_DIM.y * WORLD_DIM.z;
+const size_t TOTAL_VOXELS = TOTAL_CHUNKS * CHUNK_VOXELS;
+
+static_assert((1 << CHUNK_SHIFT) == CHUNK_SIZE, "chunks are indexed with shifts");
+static_assert(CHUNK_SHIFT <= 10 && CHUNK_SHIFT >= VOXEL_BRICK_SHIFT, "CHUNK_SIZE out of range for the voxel layouts");
+
+// ================== Voxel struct and values ============
+struct Voxel {
+    uint32_t material;
+};
+
+
+inline int floor_div(int a, int b) {
+    return (a >= 0 ? a / b : ((a - b + 1) / b));
+}
+
+
+// Index of a voxel inside its chunk in the VOXEL_LAYOUT order, local in [0, CHUNK_SIZE)
+inline int chunk_local_index(glm::ivec3 local) {
+    return layout_local_index<VOXEL_LAYOUT, CHUNK_SHIFT>(local.x, local.y, local.z);
+}
+
+inline glm::ivec3 chunk_local_coord(int localIndex) {
+    glm::ivec3 local;
+    layout_local_coord<VOXEL_LAYOUT, CHUNK_SHIFT>(localIndex, local.x, local.y, local.z);
+    return local;
+}
+
+
+// Host-side copy of what lives in voxelSSBO. Same layout as the GPU buffer :
+// chunks in z, y, x order, and VOXEL_LAYOUT order inside each chunk.
+//
+// The buffer is a window of dim chunks starting at chunk `origin`, which stays 0 unless
+// streaming (streaming.hpp) moves it. Chunk slots form a toroidal ring : chunk c lives
+// in slot c mod dim, so moving the window only replaces the chunks that left it.
+struct VoxelWorld {
+    glm::ivec3 dim;             // in chunks
+    std::vector<Voxel> voxels;
+
+    glm::ivec3 origin = glm::ivec3(0);      // first chunk of the window
+    glm::ivec3 originSlot = glm::ivec3(0);  // origin mod dim, its slot in the ring
+
+    // Buffer indices of the voxels changed by setVoxel / fillBox since the last
+    // clearDirty(), duplicates included. update_octree() consumes them.
+    std::vector<uint32_t> dirtyVoxels;
+
+    explicit VoxelWorld(glm::ivec3 dim = WORLD_DIM);
+
+    size_t chunkCount() const { return (size_t)dim.x * dim.y * dim.z; }
+    size_t byteSize() const { return voxels.size() * sizeof(Voxel); }
+    glm::ivec3 voxelDim() const { return dim * CHUNK_SIZE; }
+    glm::ivec3 voxelOrigin() const { return origin * CHUNK_SIZE; }
+
+    void setOrigin(glm::ivec3 chunkOrigin);
+
+    bool containsChunk(glm::ivec3 chunkCoord) const {
+        glm::ivec3 rel = chunkCoord - origin;
+        return rel.x >= 0 && rel.y >= 0 && rel.z >= 0 && rel.x < dim.x && rel.y < dim.y && rel.z < dim.z;
+    }
+
+    // Slot of a chunk of the window (containsChunk() must be true)
+    int chunkIndex(glm::ivec3 chunkCoord) const {
+        glm::ivec3 s = chunkCoord - origin + originSlot;
+        if (s.x >= dim.x) s.x -= dim.x;
+        if (s.y >= dim.y) s.y -= dim.y;
+        if (s.z >= dim.z) s.z -= dim.z;
+        return s.z * dim.y * dim.x + s.y * dim.x + s.x;
+    }
+
+    // Chunk held by a slot, inverse of chunkIndex
+    glm::ivec3 slotChunk(int slot) const {
+        glm::ivec3 s(slot % dim.x, (slot / dim.x) % dim.y, slot / (dim.x * dim.y));
+        glm::ivec3 rel = s - originSlot;
+        if (rel.x < 0) rel.x += dim.x;
+        if (rel.y < 0) rel.y += dim.y;
+        if (rel.z < 0) rel.z += dim.z;
+        return origin + rel;
+    }
+
+    // Same as worldToIndex3D() in voxel_world.glsl, -1 when outside of the world
+    int worldToIndex3D(glm::ivec3 pos) const {
+        glm::ivec3 chunkCoord(
+            floor_div(pos.x, CHUNK_SIZE),
+            floor_div(pos.y, CHUNK_SIZE),
+            floor_div(pos.z, CHUNK_SIZE)
+        );
+
+        if (!containsChunk(chunkCoord)) return -1;
+
+        glm::ivec3 local(pos.x & (CHUNK_SIZE - 1), pos.y & (CHUNK_SIZE - 1), pos.z & (CHUNK_SIZE - 1));
+
+        return chunkIndex(chunkCoord) * (int)CHUNK_VOXELS + chunk_local_index(local);
+    }
+
+    // Inverse of worldToIndex3D
+    glm::ivec3 indexToWorld(int idx) const {
+        int local = idx % (int)CHUNK_VOXELS;
+        return slotChunk(idx / (int)CHUNK_VOXELS) * CHUNK_SIZE + chunk_local_coord(local);
+    }
+
+    uint32_t materialAt(glm::ivec3 pos) const {
+        int idx = worldToIndex3D(pos);
+        return idx >= 0 ? voxels[idx].material : 0u;
+    }
+
+    // ===== Edits =====
+    // false when pos is outside of the world or already holds that material
+    bool setVoxel(glm::ivec3 pos, uint32_t material);
+
+    // Every voxel of [boxMin, boxMax] (inclusive, clipped to the world), returns how many changed
+    size_t fillBox(glm::ivec3 boxMin, glm::ivec3 boxMax, uint32_t material);
+
+    void clearDirty() { dirtyVoxels.clear(); }
+};
+
+
+// ===== Per chunk occupancy =====
+// One uint per chunk, same order as the chunks : 0 = empty, a material = the whole
+// chunk is that material, CHUNK_MIXED otherwise. Bound as chunkOccupancy (binding 4)
+// on the GPU, where build_octree.glsl writes it from the pyramid roots.
+const uint32_t CHUNK_MIXED = 0xFFFFFFFFu;
+
+uint32_t chunk_occupancy(const Voxel* chunkVoxels);
+
+// Whole table, chunks spread over `threads` workers (0 = all cores)
+void build_occupancy(const VoxelWorld& world, std::vector<uint32_t>& occupancy, int threads = 0);
+
+
+// ===== File order =====
+// Chunk files and archive payloads are x fastest whatever VOXEL_LAYOUT is. Both are
+// plain copies with LAYOUT_LINEAR. (The streaming cache's RLE payloads stay in
+// VOXEL_LAYOUT order, they're only ever decoded back by the same build.)
+void chunk_from_linear(const Voxel* linear, Voxel* out);
+void chunk_to_linear(const Voxel* chunkVoxels, Voxel* linear);
+
+// In place, through a per thread scratch chunk
+void chunk_from_linear(Voxel* chunkVoxels);
+
+
+// Reads one raw chunk-x-y-z.bin (as written by data/utils.py) into the world
+void loadChunkFile(VoxelWorld& world, const std::string& filepath, glm::ivec3 chunkCoord);
+
+// Loads every chunk-x-y-z.bin of the world from a directory
+void loadChunkDirectory(VoxelWorld& world, const std::string& directory);
@@ -0,0 +1,152 @@
+#include "world_archive.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+
+static size_t align_up(size_t v, size_t alignment) {
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+
+WorldArchive::WorldArchive(const std::string& path) : file(path, false) {
+    if (file.size < sizeof(ArchiveHeader)) throw std::runtime_error("Not a world archive : " + path);
+
+    header = reinterpret_cast<const ArchiveHeader*>(file.data);
+    if (header->magic != ARCHIVE_MAGIC) throw std::runtime_error("Not a world archive : " + path);
+    if (header->version != ARCHIVE_VERSION)
+        throw std::runtime_error("Unsupported world archive version " + std::to_string(header->version) + " : " + path);
+    if (header->chunkSize != (uint32_t)CHUNK_SIZE)
+        throw std::runtime_error("World archive chunk size is " + std::to_string(header->chunkSize) + " : " + path);
+    if (header->dim[0] <= 0 || header->dim[1] <= 0 || header->dim[2] <= 0 ||
+        (size_t)header->dim[0] * header->dim[1] * header->dim[2] != header->chunkCount)
+        throw std::runtime_error("World archive has an invalid size : " + path);
+
+    size_t indexEnd = sizeof(ArchiveHeader) + (size_t)header->chunkCount * sizeof(ArchiveEntry);
+    if (file.size < indexEnd) throw std::runtime_error("World archive is truncated : " + path);
+    entries = reinterpret_cast<const ArchiveEntry*>(file.data + sizeof(ArchiveHeader));
+
+    for (size_t c = 0; c < header->chunkCount; ++c) {
+        if (!(entries[c].flags & ARCHIVE_UNIFORM) && entries[c].offset + entries[c].size > file.size)
+            throw std::runtime_error("World archive is truncated : " + path);
+    }
+}
+
+
+size_t WorldArchive::readChunk(int chunkIndex, Voxel* out) const {
+    const ArchiveEntry& entry = entries[chunkIndex];
+    if (entry.flags & ARCHIVE_UNIFORM) {
+        std::fill(out, out + CHUNK_VOXELS, Voxel{entry.material});
+        return 0;
+    }
+
+    try {
+        decode_chunk(file.data + entry.offset, entry.size, ChunkCompression(entry.compression), out);
+        chunk_from_linear(out);
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error("Archive chunk " + std::to_string(chunkIndex) + " : " + e.what());
+    }
+    return entry.size;
+}
+
+
+size_t WorldArchive::readRange(int begin, int end, Voxel* out, int threads) const {
+    std::vector<size_t> bytes(end - begin, 0);
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    parallel_for(end - begin, threads, [&](int i) {
+        try {
+            bytes[i] = readChunk(begin + i, out + (size_t)i * CHUNK_VOXELS);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+    });
+
+    if (error) std::rethrow_exception(error);
+    size_t total = 0;
+    for (size_t b : bytes) total += b;
+    return total;
+}
+
+
+void write_world_archive(const VoxelWorld& world, const std::string& path, ChunkCompression compression, int threads) {
+    const size_t chunkCount = world.chunkCount();
+    const size_t chunkBytes = CHUNK_VOXELS * sizeof(Voxel);
+
+    // Encoded up front so the offsets are known, empty for uniform chunks
+    std::vector<std::vector<uint8_t>> payloads(chunkCount);
+    std::vector<ChunkCompression> compressions(chunkCount, CHUNK_RAW);
+    parallel_for((int)chunkCount, threads, [&](int c) {
+        const Voxel* chunkVoxels = world.voxels.data() + (size_t)c * CHUNK_VOXELS;
+        if (chunk_occupancy(chunkVoxels) != CHUNK_MIXED) return;
+        thread_local std::vector<Voxel> linear(CHUNK_VOXELS);
+        chunk_to_linear(chunkVoxels, linear.data());
+        encode_chunk(linear.data(), compression, payloads[c]);
+        compressions[c] = compression;
+        if (payloads[c].size() >= chunkBytes) {
+            encode_chunk(linear.data(), CHUNK_RAW, payloads[c]);
+            compressions[c] = CHUNK_RAW;
+        }
+    });
+
+    ArchiveHeader header = {};
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.chunkSize = CHUNK_SIZE;
+    header.dim[0] = world.dim.x;
+    header.dim[1] = world.dim.y;
+    header.dim[2] = world.dim.z;
+    header.chunkCount = (uint32_t)chunkCount;
+
+    std::vector<ArchiveEntry> entries(chunkCount);
+    size_t offset = align_up(sizeof(ArchiveHeader) + chunkCount * sizeof(ArchiveEntry), ARCHIVE_ALIGN);
+    for (size_t c = 0; c < chunkCount; ++c) {
+        ArchiveEntry& entry = entries[c];
+        entry = {};
+        uint32_t occupancy = chunk_occupancy(world.voxels.data() + c * CHUNK_VOXELS);
+        if (occupancy != CHUNK_MIXED) {
+            entry.flags = ARCHIVE_UNIFORM;
+            entry.material = occupancy;
+            continue;
+        }
+        entry.compression = compressions[c];
+        entry.size = (uint32_t)payloads[c].size();
+        entry.offset = align_up(offset, entry.compression == CHUNK_RAW ? ARCHIVE_ALIGN : ARCHIVE_PACKED_ALIGN);
+        offset = entry.offset + entry.size;
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Failed to create world archive : " + path);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), chunkCount * sizeof(ArchiveEntry));
+
+    for (size_t c = 0; c < chunkCount; ++c) {
+        if (entries[c].flags & ARCHIVE_UNIFORM) continue;
+        out.seekp(entries[c].offset);
+        out.write(reinterpret_cast<const char*>(payloads[c].data()), entries[c].size);
+    }
+    if (!out) throw std::runtime_error("Failed to write world archive : " + path);
+}
+
+
+LoadStats load_world_archive(VoxelWorld& world, const std::string& path, int threads) {
+    auto start = std::chrono::steady_clock::now();
+    WorldArchive archive(path);
+    if (archive.dim() != world.dim) world = VoxelWorld(archive.dim());
+
+    LoadStats stats;
+    stats.chunks = archive.chunkCount();
+    stats.fileBytes = archive.readRange(0, (int)archive.chunkCount(), world.voxels.data(), threads);
+    stats.bytes = world.byteSize();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
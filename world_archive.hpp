@@ -0,0 +1,76 @@
+#pragma once
+
+#include "world.hpp"
+#include "chunk_loader.hpp"
+#include "chunk_codec.hpp"
+
+#include <string>
+
+// Single file world archive (.vxa), instead of one chunk-x-y-z.bin per chunk.
+// Everything little endian, as written by write_world_archive() / data/utils.py :
+//
+//   ArchiveHeader                       32 bytes
+//   ArchiveEntry[chunkCount]            24 bytes each, chunks in world buffer order (z, y, x)
+//   payloads                            raw ones on an ARCHIVE_ALIGN boundary, compressed
+//                                       ones on ARCHIVE_PACKED_ALIGN (padding them to a
+//                                       page would eat most of the gain)
+//
+// A chunk that is a single material (all air, all stone, ...) has ARCHIVE_UNIFORM set
+// and no payload at all, the material is in the entry. Payloads are encoded with the
+// entry's ChunkCompression (chunk_codec.hpp). The file is mapped once, so any chunk can
+// be read on its own.
+
+const uint32_t ARCHIVE_MAGIC = 0x52415856u;     // "VXAR"
+const uint32_t ARCHIVE_VERSION = 1;
+const size_t ARCHIVE_ALIGN = 4096;
+const size_t ARCHIVE_PACKED_ALIGN = 16;
+
+const uint16_t ARCHIVE_UNIFORM = 1u << 0;
+
+struct ArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunkSize;
+    int32_t dim[3];         // in chunks
+    uint32_t chunkCount;
+    uint32_t reserved;
+};
+
+struct ArchiveEntry {
+    uint64_t offset;        // payload position in the file, 0 when there's none
+    uint32_t size;          // payload bytes
+    uint16_t compression;   // ChunkCompression
+    uint16_t flags;
+    uint32_t material;      // the chunk's material when ARCHIVE_UNIFORM
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ArchiveHeader) == 32, "archive header layout");
+static_assert(sizeof(ArchiveEntry) == 24, "archive entry layout");
+
+
+// Read side, throws on a file that isn't a valid archive for this CHUNK_SIZE
+struct WorldArchive {
+    MappedFile file;
+    const ArchiveHeader* header = nullptr;
+    const ArchiveEntry* entries = nullptr;
+
+    explicit WorldArchive(const std::string& path);
+
+    glm::ivec3 dim() const { return glm::ivec3(header->dim[0], header->dim[1], header->dim[2]); }
+    size_t chunkCount() const { return header->chunkCount; }
+
+    // One chunk (CHUNK_VOXELS voxels) into out, returns the payload bytes read
+    size_t readChunk(int chunkIndex, Voxel* out) const;
+
+    // Chunks [begin, end) one after the other into out, over `threads` workers (0 = all cores)
+    size_t readRange(int begin, int end, Voxel* out, int threads = 0) const;
+};
+
+// The world as an archive, uniform chunks without payload. Chunks are encoded with
+// `compression`, or stored raw when that doesn't make them smaller.
+void write_world_archive(const VoxelWorld& world, const std::string& path,
+                         ChunkCompression compression = CHUNK_RAW, int threads = 0);
+
+// Whole archive into a world of the archive's size
+LoadStats load_world_archive(VoxelWorld& world, const std::string& path, int threads = 0);
@@ -0,0 +1,144 @@
+#include "worldgen.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+// ====== CONSTANTS, keep in sync with noise.glsl ======
+const float oceanLevel = 32.0f;
+const float scale = 80.0f;
+const int octaves = 4;
+const float persistence = 0.5f;
+const float lacunarity = 2.0f;
+
+const float terrainHeightScale = 50.0f;
+const float terrainBaseHeight = oceanLevel - 20.0f;
+
+
+// ====== Hash-based noise, GLSL semantics ======
+static inline float fract(float x) {
+    return x - std::floor(x);
+}
+
+static inline float mix(float x, float y, float a) {
+    return x * (1.0f - a) + y * a;
+}
+
+static inline float hash(float px, float py) {
+    return fract(std::sin(px * 127.1f + py * 311.7f) * 43758.5453f);
+}
+
+static float noise(float px, float py) {
+    float ix = std::floor(px), iy = std::floor(py);
+    float fx = fract(px), fy = fract(py);
+
+    float a = hash(ix, iy);
+    float b = hash(ix + 1.0f, iy);
+    float c = hash(ix, iy + 1.0f);
+    float d = hash(ix + 1.0f, iy + 1.0f);
+
+    float ux = fx * fx * (3.0f - 2.0f * fx);
+    float uy = fy * fy * (3.0f - 2.0f * fy);
+    return mix(a, b, ux) +
+           (c - a) * uy * (1.0f - ux) +
+           (d - b) * ux * uy;
+}
+
+static float fbm(float px, float py) {
+    float total = 0.0f;
+    float amplitude = 1.0f;
+    float frequency = 1.0f;
+    float maxValue = 0.0f;
+
+    for (int i = 0; i < octaves; i++) {
+        total += noise(px * frequency, py * frequency) * amplitude;
+        maxValue += amplitude;
+        amplitude *= persistence;
+        frequency *= lacunarity;
+    }
+
+    return total / maxValue;
+}
+
+
+float terrain_height(int x, int z) {
+    float nx = float(x) / scale;
+    float nz = float(z) / scale;
+
+    float elevation = fbm(nx, nz);
+    return elevation * terrainHeightScale + terrainBaseHeight;
+}
+
+
+void generate_column_heights(glm::ivec2 chunkXZ, float* heights) {
+    for (int z = 0; z < CHUNK_SIZE; ++z)
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        heights[z * CHUNK_SIZE + x] = terrain_height(chunkXZ.x * CHUNK_SIZE + x, chunkXZ.y * CHUNK_SIZE + z);
+    }
+}
+
+
+void fill_chunk(glm::ivec3 chunkCoord, const float* heights, Voxel* out) {
+    float minHeight = heights[0], maxHeight = heights[0];
+    for (int i = 1; i < CHUNK_SIZE * CHUNK_SIZE; ++i) {
+        minHeight = std::min(minHeight, heights[i]);
+        maxHeight = std::max(maxHeight, heights[i]);
+    }
+
+    float yMin = float(chunkCoord.y * CHUNK_SIZE);
+    float yMax = float(chunkCoord.y * CHUNK_SIZE + CHUNK_SIZE - 1);
+
+    // Whole chunk above the terrain and the ocean => air
+    if (yMin >= maxHeight && yMin >= oceanLevel) {
+        std::memset(out, 0, CHUNK_VOXELS * sizeof(Voxel));
+        return;
+    }
+    // Whole chunk deep underground => stone
+    if (yMax < minHeight - 5.0f) {
+        std::fill(out, out + CHUNK_VOXELS, Voxel{1u});
+        return;
+    }
+
+    // Rows are generated x fastest, and scattered when the layout isn't linear
+    Voxel linearRow[CHUNK_SIZE];
+    for (int z = 0; z < CHUNK_SIZE; ++z)
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        float fy = float(chunkCoord.y * CHUNK_SIZE + y);
+        const float* h = heights + z * CHUNK_SIZE;
+        Voxel* row = VOXEL_LAYOUT == LAYOUT_LINEAR ? out + (z * CHUNK_SIZE + y) * CHUNK_SIZE : linearRow;
+
+        // Branchless so the row compiles down to vector compares / blends
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            float height = h[x];
+            uint32_t material = fy < height - 5.0f ? 1u   // stone
+                              : fy < height - 1.0f ? 2u   // dirt
+                              : fy < height        ? 3u   // grass
+                              : fy < oceanLevel    ? 4u   // water
+                              : 0u;                       // air
+            row[x].material = material;
+        }
+        if (VOXEL_LAYOUT != LAYOUT_LINEAR) {
+            for (int x = 0; x < CHUNK_SIZE; ++x)
+                out[chunk_local_index(glm::ivec3(x, y, z))] = linearRow[x];
+        }
+    }
+}
+
+
+void generate_world(VoxelWorld& world, int threads) {
+    int columns = world.dim.x * world.dim.z;
+
+    parallel_for(columns, threads, [&](int column) {
+        glm::ivec2 chunkXZ(world.origin.x + column % world.dim.x, world.origin.z + column / world.dim.x);
+
+        float heights[CHUNK_SIZE * CHUNK_SIZE];
+        generate_column_heights(chunkXZ, heights);
+
+        for (int y = 0; y < world.dim.y; ++y) {
+            glm::ivec3 chunkCoord(chunkXZ.x, world.origin.y + y, chunkXZ.y);
+            fill_chunk(chunkCoord, heights, world.voxels.data() + (size_t)world.chunkIndex(chunkCoord) * CHUNK_VOXELS);
+        }
+    });
+}
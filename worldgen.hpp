@@ -0,0 +1,26 @@
+#pragma once
+
+#include "world.hpp"
+
+// CPU port of voxel.glsl : same hash / noise / fbm heightmap (noise.glsl), same material banding.
+//
+// Tolerance : the math is the same float math as the shader, but GPU sin() is not
+// IEEE (the GLSL spec doesn't ask for it), and hash() feeds it arguments in the
+// thousands. So heights can differ in the last bits from a driver's output, which
+// only shows up as the odd voxel flipping material where a height lands right on
+// an integer band edge. The layout and everything else is identical.
+//
+// Unlike the shader, the fbm height is computed once per (x,z) column and then
+// the 32 voxels of each row are filled by comparing against it.
+
+// Terrain height of the column at world voxel coordinates (x, z)
+float terrain_height(int x, int z);
+
+// Heightmap of one chunk column, CHUNK_SIZE x CHUNK_SIZE floats, x fastest
+void generate_column_heights(glm::ivec2 chunkXZ, float* heights);
+
+// Fills one chunk (CHUNK_VOXELS voxels) from its column heightmap
+void fill_chunk(glm::ivec3 chunkCoord, const float* heights, Voxel* out);
+
+// Whole world, chunk columns spread over `threads` workers (0 = all cores)
+void generate_world(VoxelWorld& world, int threads = 0);